@@ -1,5 +1,6 @@
 #include "pch.h"
 #include <gamelib_actor.hpp>
+#include <gamelib_component_profiler.hpp>
 #include <gamelib_locator.hpp>
 
 namespace GameLib {
@@ -29,25 +30,35 @@ namespace GameLib {
 		dt = deltaTime;
 		t1 += dt;
 		anim.update(deltaTime);
-		if (input_)
+		if (input_) {
+			ComponentProfiler::Zone zone(*input_);
 			input_->update(*this);
-		if (actor_)
+		}
+		if (actor_) {
+			ComponentProfiler::Zone zone(*actor_);
 			actor_->update(*this, world);
+		}
 	}
 
 	void Actor::preupdate() {
-		if (physics_)
+		if (physics_) {
+			ComponentProfiler::Zone zone(*physics_);
 			physics_->preupdate(*this);
+		}
 	}
 
 	void Actor::postupdate() {
-		if (physics_)
+		if (physics_) {
+			ComponentProfiler::Zone zone(*physics_);
 			physics_->postupdate(*this);
+		}
 	}
 
 	void Actor::physics(float deltaTime, World& world) {
 		if (!physics_)
 			return;
+		// the collision tests and the handlers they call are counted as physics time
+		ComponentProfiler::Zone zone(*physics_);
 		lastPosition = position;
 		physics_->update(*this, world);
 		if (actor_) {
@@ -100,8 +111,10 @@ namespace GameLib {
 	}
 
 	void Actor::draw(Graphics& graphics) {
-		if (visible && graphics_)
+		if (visible && graphics_) {
+			ComponentProfiler::Zone zone(*graphics_);
 			graphics_->draw(*this, graphics);
+		}
 	}
 
 	void Actor::switchAnim(int i) {
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include <gamelib_asset_archive.hpp>
+#include <cstring>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace filesystem = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace filesystem = std::experimental::filesystem;
+#endif
+
+namespace GameLib {
+	// Asset archive format (little endian)
+	// PAKHEADER
+	// PAKENTRY[count]  sorted by name
+	// char[]           names, not null terminated
+	// blobs            each starts on a BlobAlignment boundary
+	constexpr char PAK_MAGIC[4] = { 'G', 'L', 'P', 'K' };
+	constexpr uint32_t PAK_VERSION = 1;
+	constexpr uint64_t BlobAlignment = 16;
+
+	struct PAKHEADER {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+		uint32_t reserved;
+		uint64_t entriesOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+	};
+
+	struct PAKENTRY {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+	};
+
+	bool AssetArchive::open(const std::string& path) {
+		close();
+		if (!file_.open(path))
+			return false;
+		const PAKHEADER* header = file_.at<PAKHEADER>(0);
+		if (!header || memcmp(header->magic, PAK_MAGIC, sizeof(PAK_MAGIC)) != 0 || header->version != PAK_VERSION) {
+			HFLOGERROR("'%s' is not an asset archive", path.c_str());
+			file_.close();
+			return false;
+		}
+		const PAKENTRY* entries = file_.at<PAKENTRY>(header->entriesOffset, header->count);
+		const char* names = file_.at<char>(header->namesOffset, header->namesSize);
+		if (!entries || (header->namesSize && !names)) {
+			HFLOGERROR("'%s' is truncated", path.c_str());
+			file_.close();
+			return false;
+		}
+		for (uint32_t i = 0; i < header->count; i++) {
+			const PAKENTRY& e = entries[i];
+			if ((uint64_t)e.nameOffset + e.nameLength > header->namesSize || !file_.at<char>(e.offset, e.size)) {
+				HFLOGERROR("'%s' has a bad entry", path.c_str());
+				file_.close();
+				return false;
+			}
+		}
+		entries_ = entries;
+		names_ = names;
+		count_ = header->count;
+		path_ = path;
+		return true;
+	}
+
+	void AssetArchive::close() {
+		file_.close();
+		path_.clear();
+		count_ = 0;
+		entries_ = nullptr;
+		names_ = nullptr;
+	}
+
+	std::string_view AssetArchive::name(int i) const {
+		if (i < 0 || i >= (int)count_)
+			return {};
+		return { names_ + entries_[i].nameOffset, entries_[i].nameLength };
+	}
+
+	std::string_view AssetArchive::find(std::string_view name) const {
+		int lo = 0;
+		int hi = (int)count_;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			int c = this->name(mid).compare(name);
+			if (c == 0) {
+				const PAKENTRY& e = entries_[mid];
+				return { file_.data() + e.offset, (size_t)e.size };
+			}
+			if (c < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return {};
+	}
+
+	int AssetArchive::pack(const std::string& directory, const std::string& output) {
+		std::error_code ec;
+		filesystem::path root(directory);
+		filesystem::path outputPath = filesystem::absolute(output, ec);
+		std::vector<std::pair<std::string, filesystem::path>> files;
+		for (auto& entry : filesystem::recursive_directory_iterator(root, ec)) {
+			if (!entry.is_regular_file(ec))
+				continue;
+			if (filesystem::absolute(entry.path(), ec) == outputPath)
+				continue;
+			files.push_back({ filesystem::relative(entry.path(), root, ec).generic_string(), entry.path() });
+		}
+		if (ec) {
+			HFLOGERROR("'%s' could not be read: %s", directory.c_str(), ec.message().c_str());
+			return -1;
+		}
+		std::sort(files.begin(), files.end());
+
+		PAKHEADER header{};
+		memcpy(header.magic, PAK_MAGIC, sizeof(PAK_MAGIC));
+		header.version = PAK_VERSION;
+		header.count = (uint32_t)files.size();
+		header.entriesOffset = sizeof(PAKHEADER);
+		header.namesOffset = header.entriesOffset + files.size() * sizeof(PAKENTRY);
+
+		std::vector<PAKENTRY> entries(files.size());
+		std::string names;
+		for (size_t i = 0; i < files.size(); i++) {
+			entries[i].nameOffset = (uint32_t)names.size();
+			entries[i].nameLength = (uint32_t)files[i].first.size();
+			names += files[i].first;
+		}
+		header.namesSize = names.size();
+
+		uint64_t offset = header.namesOffset + names.size();
+		for (size_t i = 0; i < files.size(); i++) {
+			offset = (offset + BlobAlignment - 1) & ~(BlobAlignment - 1);
+			entries[i].offset = offset;
+			entries[i].size = filesystem::file_size(files[i].second, ec);
+			offset += entries[i].size;
+		}
+
+		std::ofstream fout(output, std::ios::binary);
+		if (!fout) {
+			HFLOGERROR("'%s' could not be written", output.c_str());
+			return -1;
+		}
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PAKENTRY));
+		fout.write(names.data(), names.size());
+		std::vector<char> buffer;
+		for (size_t i = 0; i < files.size(); i++) {
+			static const char zeros[BlobAlignment] = { 0 };
+			fout.write(zeros, entries[i].offset - (uint64_t)fout.tellp());
+			std::ifstream fin(files[i].second, std::ios::binary);
+			buffer.resize((size_t)entries[i].size);
+			if (!fin.read(buffer.data(), buffer.size())) {
+				HFLOGERROR("'%s' could not be read", files[i].first.c_str());
+				return -1;
+			}
+			fout.write(buffer.data(), buffer.size());
+		}
+		return fout ? (int)files.size() : -1;
+	}
+} // namespace GameLib
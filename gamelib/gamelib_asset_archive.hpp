@@ -0,0 +1,49 @@
+#ifndef GAMELIB_ASSET_ARCHIVE_HPP
+#define GAMELIB_ASSET_ARCHIVE_HPP
+
+#include <gamelib_mapped_file.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace GameLib {
+	struct PAKENTRY;
+
+	// AssetArchive is a packed file of assets with a sorted name index
+	// The archive is mapped into memory so finding and reading an asset needs no system calls
+	class AssetArchive {
+	public:
+		// maps the archive at path, returns false if it is missing or not an asset archive
+		bool open(const std::string& path);
+
+		// unmaps the archive
+		void close();
+
+		operator bool() const { return (bool)file_; }
+
+		// returns the path the archive was opened from
+		const std::string& path() const { return path_; }
+
+		// returns the number of assets in the archive
+		int count() const { return (int)count_; }
+
+		// returns the contents of the asset called name, or an empty view if it is not in the archive
+		// names are relative to the packed directory and use '/' separators
+		std::string_view find(std::string_view name) const;
+
+		// returns the name of the i'th asset in sorted order
+		std::string_view name(int i) const;
+
+		// packs every file under directory into an archive at output, returns the number of files packed or -1
+		static int pack(const std::string& directory, const std::string& output);
+
+	private:
+		MappedFile file_;
+		std::string path_;
+		uint32_t count_{ 0 };
+		const PAKENTRY* entries_{ nullptr };
+		const char* names_{ nullptr };
+	};
+} // namespace GameLib
+
+#endif
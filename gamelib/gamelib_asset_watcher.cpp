@@ -0,0 +1,256 @@
+#include "pch.h"
+#include <gamelib_asset_watcher.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace filesystem = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace filesystem = std::experimental::filesystem;
+#endif
+
+namespace GameLib {
+	AssetWatcher::AssetWatcher() {}
+
+	AssetWatcher::~AssetWatcher() { stop(); }
+
+	bool AssetWatcher::start(const std::vector<std::string>& directories) {
+		stop();
+		directories_.clear();
+#ifdef __linux__
+		fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd_ < 0) {
+			HFLOGERROR("inotify not available");
+			return false;
+		}
+		for (auto& dir : directories) {
+			_addWatches(dir, false);
+		}
+		if (directories_.empty()) {
+			::close(fd_);
+			fd_ = -1;
+			return false;
+		}
+#elif defined(_WIN32)
+		for (auto& dir : directories) {
+			HANDLE handle = CreateFileW(filesystem::path(dir).wstring().c_str(),
+				FILE_LIST_DIRECTORY,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				nullptr,
+				OPEN_EXISTING,
+				FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+				nullptr);
+			if (handle == INVALID_HANDLE_VALUE) {
+				HFLOGWARN("'%s' can not be watched", dir.c_str());
+				continue;
+			}
+			handles_.push_back(handle);
+			directories_.push_back(dir);
+		}
+		if (directories_.empty())
+			return false;
+#else
+		for (auto& dir : directories) {
+			if (filesystem::is_directory(dir))
+				directories_.push_back(dir);
+		}
+		if (directories_.empty())
+			return false;
+		static bool logged = false;
+		if (!logged) {
+			HFLOGWARN("file change notifications are not available, scanning every %d ms", ScanInterval_ms);
+			logged = true;
+		}
+#endif
+		quit_ = false;
+		thread_ = std::thread(&AssetWatcher::_run, this);
+		return true;
+	}
+
+	void AssetWatcher::stop() {
+		if (thread_.joinable()) {
+			quit_ = true;
+			thread_.join();
+		}
+#ifdef __linux__
+		if (fd_ >= 0)
+			::close(fd_);
+#elif defined(_WIN32)
+		for (void* handle : handles_) {
+			CloseHandle(handle);
+		}
+		handles_.clear();
+#endif
+		fd_ = -1;
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed_.clear();
+	}
+
+	int AssetWatcher::poll(std::vector<std::string>& changed) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		int count = (int)changed_.size();
+		for (auto& path : changed_) {
+			changed.push_back(path);
+		}
+		changed_.clear();
+		return count;
+	}
+
+	void AssetWatcher::_changed(std::string&& path) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed_.insert(std::move(path));
+	}
+
+#ifdef __linux__
+	void AssetWatcher::_addWatches(const std::string& dir, bool created) {
+		// editors often save by writing a new file and renaming it over the old one
+		// IN_CREATE is only used for new directories, which are watched in turn
+		int wd = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+		if (wd < 0) {
+			HFLOGWARN("'%s' can not be watched", dir.c_str());
+			return;
+		}
+		// watch descriptors are allocated from 1 upwards
+		if ((int)directories_.size() < wd)
+			directories_.resize(wd);
+		directories_[wd - 1] = dir;
+
+		// files written to a new directory before its watch was added are reported here
+		std::error_code ec;
+		for (auto& entry : filesystem::directory_iterator(dir, ec)) {
+			std::string path = dir + entry.path().filename().string();
+			if (entry.is_symlink(ec))
+				continue;
+			if (entry.is_directory(ec))
+				_addWatches(path + "/", created);
+			else if (created && entry.is_regular_file(ec))
+				_changed(std::move(path));
+		}
+	}
+
+	void AssetWatcher::_run() {
+		alignas(inotify_event) char buffer[4096];
+		pollfd pfd{ fd_, POLLIN, 0 };
+		while (!quit_) {
+			// wake up regularly to check quit_
+			if (::poll(&pfd, 1, 100) <= 0)
+				continue;
+			ssize_t length;
+			while ((length = ::read(fd_, buffer, sizeof(buffer))) > 0) {
+				for (char* p = buffer; p < buffer + length;) {
+					const inotify_event* e = reinterpret_cast<const inotify_event*>(p);
+					p += sizeof(inotify_event) + e->len;
+					if (!e->len || e->wd < 1 || e->wd > (int)directories_.size())
+						continue;
+					// _addWatches() may grow directories_, so the path is copied first
+					std::string path = directories_[e->wd - 1] + e->name;
+					if (e->mask & IN_ISDIR) {
+						if (e->mask & (IN_CREATE | IN_MOVED_TO))
+							_addWatches(path + "/", true);
+					} else if (e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)) {
+						_changed(std::move(path));
+					}
+				}
+			}
+		}
+	}
+#elif defined(_WIN32)
+	void AssetWatcher::_run() {
+		struct WATCH {
+			OVERLAPPED overlapped{};
+			alignas(DWORD) char buffer[16384];
+		};
+		constexpr DWORD Filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+		DWORD count = (DWORD)handles_.size();
+		std::vector<WATCH> watches(count);
+		std::vector<HANDLE> events(count);
+		auto issue = [&](DWORD i) {
+			// the subtree of each directory is watched, so subdirectories need no handles of their own
+			ReadDirectoryChangesW(handles_[i], watches[i].buffer, sizeof(watches[i].buffer), TRUE, Filter, nullptr, &watches[i].overlapped, nullptr);
+		};
+		for (DWORD i = 0; i < count; i++) {
+			events[i] = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+			watches[i].overlapped.hEvent = events[i];
+			issue(i);
+		}
+
+		while (!quit_) {
+			// wake up regularly to check quit_
+			DWORD result = WaitForMultipleObjects(count, events.data(), FALSE, 100);
+			if (result >= WAIT_OBJECT_0 + count)
+				continue;
+			DWORD i = result - WAIT_OBJECT_0;
+			DWORD length = 0;
+			// a length of 0 means the buffer overflowed, those changes are lost
+			if (GetOverlappedResult(handles_[i], &watches[i].overlapped, &length, FALSE) && length) {
+				for (char* p = watches[i].buffer;;) {
+					const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+					std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+					std::string path = directories_[i] + filesystem::path(name).generic_u8string();
+					std::error_code ec;
+					if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+						if (filesystem::is_regular_file(path, ec))
+							_changed(std::move(path));
+					} else if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+						// what was removed can no longer be checked, so directories are reported too
+						_changed(std::move(path));
+					}
+					if (!info->NextEntryOffset)
+						break;
+					p += info->NextEntryOffset;
+				}
+			}
+			issue(i);
+		}
+
+		for (DWORD i = 0; i < count; i++) {
+			// the cancelled read must complete before its buffer is freed
+			DWORD length = 0;
+			CancelIoEx(handles_[i], &watches[i].overlapped);
+			GetOverlappedResult(handles_[i], &watches[i].overlapped, &length, TRUE);
+			CloseHandle(events[i]);
+		}
+	}
+#else
+	void AssetWatcher::_run() {
+		std::map<std::string, filesystem::file_time_type> times;
+		bool first = true;
+		while (!quit_) {
+			std::map<std::string, filesystem::file_time_type> scanned;
+			for (auto& dir : directories_) {
+				std::error_code ec;
+				for (auto it = filesystem::recursive_directory_iterator(dir, ec); !ec && it != filesystem::recursive_directory_iterator(); it.increment(ec)) {
+					if (!it->is_regular_file(ec))
+						continue;
+					auto time = it->last_write_time(ec);
+					std::string path = it->path().generic_string();
+					auto found = times.find(path);
+					if (found == times.end() ? !first : found->second != time)
+						_changed(std::string(path));
+					scanned.emplace(std::move(path), time);
+				}
+			}
+			// files that were not scanned again have been removed
+			for (auto& [path, time] : times) {
+				if (!scanned.count(path))
+					_changed(std::string(path));
+			}
+			times.swap(scanned);
+			first = false;
+			for (int t = 0; t < ScanInterval_ms && !quit_; t += 50) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+		}
+	}
+#endif
+} // namespace GameLib
@@ -0,0 +1,58 @@
+#ifndef GAMELIB_ASSET_WATCHER_HPP
+#define GAMELIB_ASSET_WATCHER_HPP
+
+#include <gamelib_base.hpp>
+#include <atomic>
+#include <mutex>
+#include <set>
+
+namespace GameLib {
+	// AssetWatcher watches directories and their subdirectories for changed files on a background thread
+	// Linux uses inotify and Windows uses ReadDirectoryChangesW. Other platforms fall back to scanning
+	// the directories every ScanInterval_ms for new modification times, which start() logs once.
+	class AssetWatcher {
+	public:
+		AssetWatcher();
+		~AssetWatcher();
+
+		// starts watching the directories, returns false if none could be watched
+		bool start(const std::vector<std::string>& directories);
+
+		// stops the watcher thread
+		void stop();
+
+		// returns true if the watcher thread is running
+		bool running() const { return thread_.joinable(); }
+
+		// moves the paths of files changed or removed since the last call into changed, returns the number moved
+		// removed files are not told apart, the caller checks whether each path still exists
+		int poll(std::vector<std::string>& changed);
+
+		// milliseconds between scans when neither inotify nor ReadDirectoryChangesW is available
+		static constexpr int ScanInterval_ms = 500;
+
+	private:
+		std::thread thread_;
+		std::atomic<bool> quit_{ false };
+		std::mutex mutex_;
+		// a set so a file written several times between polls is reported once
+		std::set<std::string> changed_;
+		// the watched directories, each ending in a separator
+		// with inotify, directory wd - 1 is the directory of watch descriptor wd, including subdirectories
+		std::vector<std::string> directories_;
+		int fd_{ -1 };
+#ifdef _WIN32
+		// one directory handle per watched directory, they are watched with their subtrees
+		std::vector<void*> handles_;
+#endif
+
+		void _run();
+		void _changed(std::string&& path);
+#ifdef __linux__
+		// watches dir and every directory below it, files found in new directories are reported as changed
+		void _addWatches(const std::string& dir, bool created);
+#endif
+	};
+} // namespace GameLib
+
+#endif
@@ -6,34 +6,214 @@ namespace GameLib {
     void Audio::playAudio(int audioClipId, bool stopPrevious) {
         if (stopPrevious)
             stopAudio(audioClipId);
-        Context* context = Locator::getContext();
-        lastChannel_ = context->playAudioClip(audioClipId);
-        audioClipToChannelMap_[audioClipId] = lastChannel_;
+        auto it = clips_.find(audioClipId);
+        _play(audioClipId, it != clips_.end() ? it->second.priority : 0, 1.0f);
     };
 
+    void Audio::playAudio(int audioClipId, int priority, glm::vec2 position) {
+        float distance = glm::distance(position, listener_);
+        if (distance > maxDistance) {
+            stats_.culled++;
+            return;
+        }
+        _play(audioClipId, priority, 1.0f - distance / maxDistance, &position);
+    }
+
     void Audio::stopAudio(int audioClipId) {
-        Context* context = Locator::getContext();
-        int channel = audioClipToChannelMap_[audioClipId];
-        context->stopAudioChannel(channel);
+        for (bool mixed : { false, true }) {
+            auto& voices = mixed ? mixerVoices_ : voices_;
+            for (int i = 0; i < (int)voices.size(); i++) {
+                if (voices[i].clipId == audioClipId)
+                    _stopVoice(mixed, i);
+            }
+        }
     }
 
     void Audio::setVolume(float volume) {
         Context* context = Locator::getContext();
-        context->setChannelVolume(lastChannel_, volume);
+        volume_ = clamp(volume, 0.0f, 1.0f);
+        for (int i = 0; i < (int)voices_.size(); i++) {
+            if (voices_[i].clipId >= 0)
+                context->setChannelVolume(i, voices_[i].volume * volume_);
+        }
+        if (!mixer_)
+            return;
+        for (auto& voice : mixerVoices_) {
+            if (voice.clipId >= 0)
+                mixer_->move(voice.handle, voice.position, volume_);
+        }
     }
 
-    float Audio::getVolume() const {
-        Context* context = Locator::getContext();
-        return context->getChannelVolume(lastChannel_);
+    float Audio::getVolume() const { return volume_; }
+
+    void Audio::setListener(glm::vec2 position) {
+        listener_ = position;
+        if (mixer_)
+            mixer_->setListener(position);
     }
 
     void Audio::playMusic(int musicClipId, int loops, float fadems) {
+        if (streamer_ && streamer_->running()) {
+            // SDL_mixer loops -1 forever and plays once for 0 or 1
+            streamer_->play(musicClipId, (int)fadems, loops < 0 || loops > 1);
+            return;
+        }
         Context* context = Locator::getContext();
         context->playMusicClip(musicClipId, loops, (int)fadems);
     }
 
     void Audio::stopMusic() {
+        if (streamer_ && streamer_->running()) {
+            streamer_->stopMusic();
+            return;
+        }
         Context* context = Locator::getContext();
         context->stopMusicClip();
     }
+
+    void Audio::setVoiceCount(int count) {
+        Context* context = Locator::getContext();
+        count = std::max(count, 1);
+        for (int i = count; i < (int)voices_.size(); i++) {
+            if (voices_[i].clipId >= 0)
+                context->stopAudioChannel(i);
+        }
+        context->allocateAudioChannels(count);
+        voices_.resize(count);
+        // positional sounds on the mixer use a pool of the same size
+        int mixerCount = std::min(count, Mixer::MaxVoices);
+        for (int i = mixerCount; i < (int)mixerVoices_.size(); i++) {
+            if (mixerVoices_[i].clipId >= 0)
+                _stopVoice(true, i);
+        }
+        mixerVoices_.resize(mixerCount);
+        stats_.voices = count;
+    }
+
+    void Audio::setClipLimit(int audioClipId, int maxInstances) { clips_[audioClipId].limit = maxInstances; }
+
+    void Audio::setClipPriority(int audioClipId, int priority) { clips_[audioClipId].priority = priority; }
+
+    Audio::VOICESTATS Audio::voiceStats() {
+        _updateVoices();
+        stats_.playing = _playingCount();
+        return stats_;
+    }
+
+    void Audio::_updateVoices() {
+        Context* context = Locator::getContext();
+        for (int i = 0; i < (int)voices_.size(); i++) {
+            if (voices_[i].clipId >= 0 && !context->audioChannelPlaying(i))
+                voices_[i].clipId = -1;
+        }
+        for (auto& voice : mixerVoices_) {
+            if (voice.clipId >= 0 && !(mixer_ && mixer_->playing(voice.handle)))
+                voice.clipId = -1;
+        }
+    }
+
+    int Audio::_playingCount() const {
+        int playing = 0;
+        for (bool mixed : { false, true }) {
+            for (auto& voice : mixed ? mixerVoices_ : voices_) {
+                if (voice.clipId >= 0)
+                    playing++;
+            }
+        }
+        return playing;
+    }
+
+    void Audio::_stopVoice(bool mixed, int i) {
+        VOICE& voice = mixed ? mixerVoices_[i] : voices_[i];
+        if (mixed) {
+            if (mixer_)
+                mixer_->stopVoice(voice.handle);
+        } else {
+            Locator::getContext()->stopAudioChannel(i);
+        }
+        voice.clipId = -1;
+    }
+
+    int Audio::_findVoice(const std::vector<VOICE>& voices, int audioClipId, int priority, float volume) const {
+        // a clip at its limit replaces its own oldest voice
+        auto it = clips_.find(audioClipId);
+        int limit = it != clips_.end() ? it->second.limit : DefaultClipLimit;
+        if (limit <= 0)
+            return -1;
+        int instances = 0;
+        int oldest = -1;
+        for (int i = 0; i < (int)voices.size(); i++) {
+            if (voices[i].clipId != audioClipId)
+                continue;
+            instances++;
+            if (oldest < 0 || voices[i].sequence < voices[oldest].sequence)
+                oldest = i;
+        }
+        if (instances >= limit)
+            return voices[oldest].priority <= priority ? oldest : -1;
+
+        // otherwise a free voice, or the lowest priority voice, the quietest and then the oldest
+        int best = -1;
+        for (int i = 0; i < (int)voices.size(); i++) {
+            const VOICE& v = voices[i];
+            if (v.clipId < 0)
+                return i;
+            if (v.priority > priority || (v.priority == priority && v.volume > volume))
+                continue;
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+            const VOICE& b = voices[best];
+            if (v.priority != b.priority) {
+                if (v.priority < b.priority)
+                    best = i;
+            } else if (v.volume != b.volume) {
+                if (v.volume < b.volume)
+                    best = i;
+            } else if (v.sequence < b.sequence) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void Audio::_play(int audioClipId, int priority, float volume, const glm::vec2* position) {
+        if (voices_.empty())
+            setVoiceCount(DefaultVoiceCount);
+
+        // positional sounds go to the mixer when it is running, so they are panned
+        bool mixed = position && mixer_ && mixer_->running();
+        auto& voices = mixed ? mixerVoices_ : voices_;
+        _updateVoices();
+        int i = _findVoice(voices, audioClipId, priority, volume);
+        if (i < 0) {
+            stats_.dropped++;
+            return;
+        }
+
+        VOICE& voice = voices[i];
+        if (voice.clipId >= 0) {
+            _stopVoice(mixed, i);
+            stats_.stolen++;
+        }
+        if (mixed) {
+            voice.handle = mixer_->play(audioClipId, *position, volume_);
+            if (voice.handle < 0)
+                return;
+            voice.position = *position;
+        } else {
+            Context* context = Locator::getContext();
+            context->setChannelVolume(i, volume * volume_);
+            if (context->playAudioClip(audioClipId, i) < 0)
+                return;
+        }
+
+        voice.clipId = audioClipId;
+        voice.priority = priority;
+        voice.volume = volume;
+        voice.sequence = sequence_++;
+        stats_.played++;
+        stats_.peak = std::max(stats_.peak, _playingCount());
+    }
 }
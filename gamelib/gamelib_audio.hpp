@@ -1,7 +1,8 @@
 #ifndef GAMELIB_AUDIO_HPP
 #define GAMELIB_AUDIO_HPP
 
-#include <gamelib_context.hpp>
+#include <gamelib_mixer.hpp>
+#include <gamelib_music_streamer.hpp>
 
 namespace GameLib {
     class IAudio {
@@ -9,24 +10,106 @@ namespace GameLib {
         virtual ~IAudio() {}
 
         virtual void playAudio(int audioClipId, bool stopPrevious) {}
+        // plays a clip heard from position, louder and higher priority sounds win when voices run out
+        virtual void playAudio(int audioClipId, int priority, glm::vec2 position) {}
         virtual void stopAudio(int audioClipId) {}
         virtual void setVolume(float volume) {}
         virtual float getVolume() const { return 0.0f; }
+        virtual void setListener(glm::vec2 position) {}
+        // sets the priority used by playAudio(audioClipId, stopPrevious)
+        virtual void setClipPriority(int audioClipId, int priority) {}
         virtual void playMusic(int musicClipId, int loops, float fadems) {}
         virtual void stopMusic() {}
     };
 
+    // Audio plays clips through a fixed pool of mixer channels (voices). Each clip has an instance
+    // limit and a default priority. Sounds further than maxDistance from the listener are culled
+    // and nearer ones are attenuated. When no voice is free, a voice with lower priority is stolen,
+    // the quietest first and then the oldest. A clip at its instance limit steals its own oldest voice
     class Audio : public IAudio {
     public:
+        // number of voices allocated when the first sound plays
+        static constexpr int DefaultVoiceCount = 16;
+        // number of voices one clip may use at once unless setClipLimit() says otherwise
+        static constexpr int DefaultClipLimit = 4;
+
         void playAudio(int audioClipId, bool stopPrevious) override;
+        void playAudio(int audioClipId, int priority, glm::vec2 position) override;
         void stopAudio(int audioClipId) override;
+        // sets the volume of every voice in the range 0 to 1
         void setVolume(float volume) override;
         float getVolume() const override;
+        // sets the position distances are measured from, usually the camera center
+        void setListener(glm::vec2 position) override;
         void playMusic(int musicClipId, int loops, float fadems) override;
         void stopMusic() override;
+
+        // sets the number of voices, playing voices past the new count are stopped
+        void setVoiceCount(int count);
+        int voiceCount() const { return (int)voices_.size(); }
+
+        // limits how many voices a clip may use at once
+        void setClipLimit(int audioClipId, int maxInstances);
+        void setClipPriority(int audioClipId, int priority) override;
+
+        // when set, positional sounds play on the mixer so they are panned, their clips must be added to it
+        // they get a voice pool of their own with the same limits, priorities and stats
+        void setMixer(Mixer* mixer) { mixer_ = mixer; }
+
+        // when set, music plays through the streamer, the tracks must be added to it
+        void setMusicStreamer(MusicStreamer* streamer) { streamer_ = streamer; }
+
+        // sounds further than this from the listener are not played
+        float maxDistance{ 40.0f };
+
+        struct VOICESTATS {
+            int voices{ 0 };      // voices in the pool
+            int playing{ 0 };     // voices playing now
+            int peak{ 0 };        // most voices playing at once
+            uint64_t played{ 0 }; // sounds started
+            uint64_t stolen{ 0 }; // sounds cut off to start another
+            uint64_t culled{ 0 }; // sounds too far away to play
+            uint64_t dropped{ 0 }; // sounds not played because every voice had higher priority
+        };
+
+        // counts the playing voices and returns the pool counters
+        VOICESTATS voiceStats();
+
     private:
-        int lastChannel_{ -1 };
-        std::map<int, int> audioClipToChannelMap_;
+        struct VOICE {
+            int clipId{ -1 };
+            // the Mixer voice handle and position of a positional sound on the mixer
+            int handle{ -1 };
+            glm::vec2 position{ 0.0f, 0.0f };
+            int priority{ 0 };
+            float volume{ 0.0f };
+            // play order, lower is older
+            uint64_t sequence{ 0 };
+        };
+        struct CLIPINFO {
+            int limit{ DefaultClipLimit };
+            int priority{ 0 };
+        };
+
+        // voices_[i] plays on mixer channel i, mixerVoices_ are sounds on the Mixer
+        std::vector<VOICE> voices_;
+        std::vector<VOICE> mixerVoices_;
+        std::map<int, CLIPINFO> clips_;
+        glm::vec2 listener_{ 0.0f, 0.0f };
+        float volume_{ 1.0f };
+        uint64_t sequence_{ 0 };
+        Mixer* mixer_{ nullptr };
+        MusicStreamer* streamer_{ nullptr };
+        VOICESTATS stats_;
+
+        // marks voices whose clip has finished as free
+        void _updateVoices();
+        int _playingCount() const;
+        void _stopVoice(bool mixed, int i);
+        // returns the voice in voices to play on, or -1 if the sound should be dropped
+        int _findVoice(const std::vector<VOICE>& voices, int audioClipId, int priority, float volume) const;
+        // plays on the Mixer if position is set and the mixer is running, otherwise on a channel
+        void _play(int audioClipId, int priority, float volume, const glm::vec2* position = nullptr);
     };
 }
 
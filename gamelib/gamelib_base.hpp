@@ -46,6 +46,9 @@ namespace GameLib {
 		SDL_Texture* texture{ nullptr };
 		int tileId{ 0 };
 		int tilesetId{ 0 };
+		// where the tile is in its texture, the tiles of a tileset share atlas textures
+		int x{ 0 };
+		int y{ 0 };
 		int w{ 0 };
 		int h{ 0 };
 	};
@@ -53,6 +56,8 @@ namespace GameLib {
 	struct AUDIOINFO {
 		Mix_Chunk* chunk{ nullptr };
 		std::string name;
+		// the path the clip was loaded from, hot reloads read it again
+		std::string filename;
 
 		operator bool() const { return chunk != nullptr; }
 
@@ -25,6 +25,7 @@ namespace GameLib {
 
 
 	void Box2D::update(float timeStep) {
+		HFPROFILE("Box2D::update");
 		constexpr int velocityIterations = 1;
 		constexpr int positionIterations = 1;
 		world_.Step(timeStep, velocityIterations, positionIterations);
@@ -38,6 +39,12 @@ namespace GameLib {
 		switch (type) {
 		case b2_staticBody:
 			sbody.init(world_, position, halfSize, density, friction);
+			if (!freeStaticBodies.empty()) {
+				id = freeStaticBodies.back();
+				freeStaticBodies.pop_back();
+				staticBodies[id] = std::move(sbody);
+				break;
+			}
 			staticBodies.push_back(std::move(sbody));
 			id = static_cast<int>(staticBodies.size() - 1);
 			break;
@@ -50,4 +57,26 @@ namespace GameLib {
 		}
 		return id;
 	}
+
+
+	void Box2D::killBody(int id, b2BodyType type) {
+		PhysicsBody* pb = nullptr;
+		switch (type) {
+		case b2_staticBody:
+			if (id >= 0 && id < (int)staticBodies.size())
+				pb = &staticBodies[id];
+			break;
+		case b2_dynamicBody:
+			if (id >= 0 && id < (int)dynamicBodies.size())
+				pb = &dynamicBodies[id];
+			break;
+		default: break;
+		}
+		if (!pb || !pb->body)
+			return;
+		world_.DestroyBody(pb->body);
+		pb->body = nullptr;
+		if (type == b2_staticBody)
+			freeStaticBodies.push_back(id);
+	}
 } // namespace GameLib
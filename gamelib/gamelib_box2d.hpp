@@ -81,6 +81,12 @@ namespace GameLib {
 		// returns index to body in the list
 		int initBody(b2BodyType type, glm::vec2 position, glm::vec2 halfSize, float density, float friction);
 
+		// destroys the body in the Box2D world, static indices are reused by initBody
+		void killBody(int id, b2BodyType type = b2_dynamicBody);
+
+		// returns the number of live bodies in the Box2D world
+		int bodyCount() const { return world_.GetBodyCount(); }
+
 		PhysicsBody* getBody(int id, b2BodyType type = b2_dynamicBody) {
 			switch (type) {
 			case b2_staticBody: return &staticBodies[id];
@@ -95,6 +101,8 @@ namespace GameLib {
 		b2World world_{ gravity_ };
 
 		std::vector<StaticBody> staticBodies;
+		// indices of killed static bodies
+		std::vector<int> freeStaticBodies;
 		std::vector<DynamicBody> dynamicBodies;
 	};
 } // namespace GameLib
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include <gamelib_component_profiler.hpp>
+#include <unordered_map>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+namespace GameLib {
+	struct ComponentProfiler::TYPEENTRY {
+		std::string name;
+		Hf::Histogram* histogram{ nullptr };
+		uint64_t frameCalls{ 0 };
+		int64_t frameNs{ 0 };
+		int64_t frameMaxNs{ 0 };
+		uint64_t calls{ 0 };
+		int64_t totalNs{ 0 };
+		int64_t maxNs{ 0 };
+	};
+
+	bool ComponentProfiler::enabled_{ false };
+	std::vector<ComponentProfiler::TYPESTATS> ComponentProfiler::lastFrame_;
+
+	namespace {
+		// entries are never erased so zones and the profiler may keep pointers to their names
+		std::unordered_map<std::type_index, ComponentProfiler::TYPEENTRY> types;
+		std::unordered_map<std::type_index, std::string> names;
+
+		std::string typeName(const std::type_info& type) {
+			auto it = names.find(type);
+			if (it != names.end())
+				return it->second;
+			std::string name = type.name();
+#ifdef __GNUG__
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+			if (status == 0 && demangled)
+				name = demangled;
+			free(demangled);
+#else
+			// MSVC names are already readable but start with "class " or "struct "
+			for (const char* prefix : { "class ", "struct " }) {
+				if (name.rfind(prefix, 0) == 0)
+					name.erase(0, strlen(prefix));
+			}
+#endif
+			return name;
+		}
+
+		ComponentProfiler::TYPESTATS makeStats(const ComponentProfiler::TYPEENTRY& entry, uint64_t calls, int64_t ns, int64_t maxNs) {
+			ComponentProfiler::TYPESTATS stats;
+			stats.name = entry.name.c_str();
+			stats.calls = calls;
+			stats.totalMs = ns * 1e-6;
+			stats.maxMs = maxNs * 1e-6;
+			return stats;
+		}
+
+		bool byTotal(const ComponentProfiler::TYPESTATS& a, const ComponentProfiler::TYPESTATS& b) { return a.totalMs > b.totalMs; }
+	}
+
+	void ComponentProfiler::setName(const std::type_info& type, const std::string& name) {
+		names[type] = name;
+		auto it = types.find(type);
+		if (it != types.end())
+			HFLOGWARN("component type '%s' was timed before it was named '%s'", it->second.name.c_str(), name.c_str());
+	}
+
+	void ComponentProfiler::frame() {
+		lastFrame_.clear();
+		for (auto& [type, entry] : types) {
+			if (!entry.frameCalls)
+				continue;
+			lastFrame_.push_back(makeStats(entry, entry.frameCalls, entry.frameNs, entry.frameMaxNs));
+			entry.frameCalls = 0;
+			entry.frameNs = 0;
+			entry.frameMaxNs = 0;
+		}
+		std::sort(lastFrame_.begin(), lastFrame_.end(), byTotal);
+	}
+
+	std::vector<ComponentProfiler::TYPESTATS> ComponentProfiler::totals() {
+		std::vector<TYPESTATS> stats;
+		for (auto& [type, entry] : types) {
+			if (entry.calls)
+				stats.push_back(makeStats(entry, entry.calls, entry.totalNs, entry.maxNs));
+		}
+		std::sort(stats.begin(), stats.end(), byTotal);
+		return stats;
+	}
+
+	bool ComponentProfiler::save(const std::string& path) {
+		std::ofstream fout(path);
+		if (!fout) {
+			HFLOGERROR("could not write component stats to '%s'", path.c_str());
+			return false;
+		}
+		fout << "component,calls,total ms,mean us,max us" << std::endl;
+		for (auto& stats : totals()) {
+			fout << stats.name << "," << stats.calls << "," << stats.totalMs << "," << stats.totalMs * 1000.0 / stats.calls << "," << stats.maxMs * 1000.0
+				 << std::endl;
+		}
+		return (bool)fout;
+	}
+
+	void ComponentProfiler::reset() {
+		for (auto& [type, entry] : types) {
+			entry.frameCalls = 0;
+			entry.frameNs = 0;
+			entry.frameMaxNs = 0;
+			entry.calls = 0;
+			entry.totalNs = 0;
+			entry.maxNs = 0;
+			entry.histogram->reset();
+		}
+		lastFrame_.clear();
+	}
+
+	void ComponentProfiler::Zone::_begin(const std::type_info& type) {
+		auto it = types.find(type);
+		if (it == types.end()) {
+			TYPEENTRY entry;
+			entry.name = typeName(type);
+			entry.histogram = &Hf::Log.getHistogram("component " + entry.name + " ms");
+			it = types.emplace(type, std::move(entry)).first;
+		}
+		type_ = &it->second;
+		if (Hf::Profiler.isEnabled()) {
+			Hf::Profiler.beginZone(type_->name.c_str());
+			zone_ = true;
+		}
+		begin_ = Hf::FrameProfiler::now();
+	}
+
+	void ComponentProfiler::Zone::_end() {
+		int64_t ns = Hf::FrameProfiler::now() - begin_;
+		if (zone_)
+			Hf::Profiler.endZone();
+		type_->frameCalls++;
+		type_->frameNs += ns;
+		type_->frameMaxNs = std::max(type_->frameMaxNs, ns);
+		type_->calls++;
+		type_->totalNs += ns;
+		type_->maxNs = std::max(type_->maxNs, ns);
+		type_->histogram->record(ns * 1e-6);
+	}
+}
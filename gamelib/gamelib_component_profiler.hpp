@@ -0,0 +1,74 @@
+#ifndef GAMELIB_COMPONENT_PROFILER_HPP
+#define GAMELIB_COMPONENT_PROFILER_HPP
+
+#include <gamelib_base.hpp>
+#include <typeindex>
+#include <typeinfo>
+
+namespace GameLib {
+	// ComponentProfiler times the calls Actor makes into its components and adds them up per concrete
+	// component type, named by RTTI unless setName() gives a name. Each timed call also opens a
+	// Hf::Profiler zone with the type name when the profiler is enabled, and is recorded in the
+	// Hf::Log histogram "component <name> ms". It is off by default and only used from the game thread
+	class ComponentProfiler {
+	public:
+		struct TYPESTATS {
+			const char* name{ nullptr };
+			uint64_t calls{ 0 };
+			double totalMs{ 0.0 };
+			double maxMs{ 0.0 };
+		};
+
+		static void enable() { enabled_ = true; }
+		static void disable() { enabled_ = false; }
+		static bool isEnabled() { return enabled_; }
+
+		// names a component type in place of its RTTI name, call before it is first timed
+		static void setName(const std::type_info& type, const std::string& name);
+		template <typename T>
+		static void setName(const std::string& name) {
+			setName(typeid(T), name);
+		}
+
+		// ends the frame, collecting the calls timed since the last call
+		static void frame();
+		// returns the types called in the last frame, largest total time first
+		static const std::vector<TYPESTATS>& lastFrame() { return lastFrame_; }
+		// returns every type timed since reset(), largest total time first
+		static std::vector<TYPESTATS> totals();
+		// writes totals() as CSV
+		static bool save(const std::string& path);
+		static void reset();
+
+		struct TYPEENTRY;
+
+		// times one call into component while it is in scope
+		class Zone {
+		public:
+			template <typename T>
+			Zone(const T& component) {
+				if (!enabled_)
+					return;
+				_begin(typeid(component));
+			}
+			~Zone() {
+				if (type_)
+					_end();
+			}
+
+		private:
+			TYPEENTRY* type_{ nullptr };
+			int64_t begin_{ 0 };
+			bool zone_{ false };
+
+			void _begin(const std::type_info& type);
+			void _end();
+		};
+
+	private:
+		static bool enabled_;
+		static std::vector<TYPESTATS> lastFrame_;
+	};
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <cstring>
 
 #ifdef __unix__
 #if __cplusplus >= 201703L && __has_include(<filesystem>)
@@ -14,6 +15,10 @@ namespace filesystem = std::filesystem;
 #endif
 
 #include <gamelib.hpp>
+#include <gamelib_asset_archive.hpp>
+#include <gamelib_asset_watcher.hpp>
+#include <gamelib_texture_cache.hpp>
+#include <gamelib_thread_pool.hpp>
 
 namespace GameLib {
     float Context::deltaTime = 0;
@@ -25,11 +30,17 @@ namespace GameLib {
     //////////////////////////////////////////////////////////////////
 
     Context::Context(int width, int height, int windowFlags) {
+        headless_ = (windowFlags & WindowHeadless) != 0;
         if (!_init())
             return;
         if (!_initScreen(width, height, windowFlags))
             return;
         initialized_ = true;
+        if (headless_) {
+            // there is no audio device, so sounds go to the null service
+            Locator::provide(this);
+            Locator::provide((IAudio*)nullptr);
+        }
     }
 
     Context::~Context() { _kill(); }
@@ -55,7 +66,8 @@ namespace GameLib {
     //////////////////////////////////////////////////////////////////
 
     bool Context::_init() {
-        if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+        Uint32 subsystems = headless_ ? SDL_INIT_TIMER | SDL_INIT_EVENTS : SDL_INIT_EVERYTHING;
+        if (SDL_Init(subsystems) < 0) {
             HFLOGERROR("SDL not initialized");
             return false;
         }
@@ -66,7 +78,8 @@ namespace GameLib {
 
         keyboard.scancodes.resize(SDL_NUM_SCANCODES);
 
-        _openGameControllers();
+        if (!headless_)
+            _openGameControllers();
 
         return true;
     }
@@ -88,6 +101,9 @@ namespace GameLib {
             result = false;
         }
 
+        if (headless_)
+            return result;
+
         flags = MIX_INIT_MP3 | MIX_INIT_OGG;
         initFlags = Mix_Init(flags);
         if (initFlags != flags) {
@@ -113,19 +129,46 @@ namespace GameLib {
     bool Context::_initScreen(int width, int height, int windowFlags) {
         screenWidth = width;
         screenHeight = height;
-        bool result = SDL_CreateWindowAndRenderer(width, height, windowFlags, &window_, &renderer_) == 0;
-        windowSurface_ = SDL_GetWindowSurface(window_);
+        bool result;
+        if (headless_) {
+            windowSurface_ = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+            renderer_ = windowSurface_ ? SDL_CreateSoftwareRenderer(windowSurface_) : nullptr;
+            result = renderer_ != nullptr;
+            if (!result)
+                HFLOGERROR("headless renderer not created: %s", SDL_GetError());
+        } else {
+            result = SDL_CreateWindowAndRenderer(width, height, windowFlags, &window_, &renderer_) == 0;
+            windowSurface_ = SDL_GetWindowSurface(window_);
+        }
+        SDL_RendererInfo info;
+        if (result && SDL_GetRendererInfo(renderer_, &info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0)
+            maxTextureSize_ = std::min(info.max_texture_width, info.max_texture_height);
         return result;
     }
 
     void Context::_kill() {
+        disableHotReload();
+        waitForLoads();
+        loaderPool_.reset();
         _closeGameControllers();
         freeImages();
         freeTilesets();
+        for (auto& [size, texture] : placeholders_) {
+            SDL_DestroyTexture(texture);
+        }
+        placeholders_.clear();
         freeAudioClips();
         freeMusicClips();
         Mix_CloseAudio();
         audioInitialized_ = false;
+        if (headless_) {
+            // SDL_Quit() only frees renderers that belong to a window
+            if (renderer_)
+                SDL_DestroyRenderer(renderer_);
+            SDL_FreeSurface(windowSurface_);
+            renderer_ = nullptr;
+            windowSurface_ = nullptr;
+        }
         SDL_Quit();
         initialized_ = false;
     }
@@ -200,6 +243,23 @@ namespace GameLib {
     int Context::getEvents() {
         static int checkForGameControllers = 100;
 
+        // the start of event handling is the frame boundary where loaded assets are swapped in
+        // and the profiler zones are collected, so every loop that handles events ends its frames
+        Hf::Profiler.frame();
+        if (watcher_) {
+            std::vector<std::string> changed;
+            watcher_->poll(changed);
+            for (auto& path : changed) {
+                // removed files only leave the index
+                if (_updateSearchIndex(path))
+                    _queueReloads(path);
+            }
+        }
+        finishLoads();
+        // frame_ is still the frame that just ended, so its textures are kept
+        _evictTextures();
+        frame_++;
+
         if (--checkForGameControllers <= 0) {
             checkForGameControllers = 100;
             _openGameControllers();
@@ -240,6 +300,7 @@ namespace GameLib {
         if (!texture)
             return -1;
         SDL_Rect dstrect{ (int)position.x, (int)position.y, (int)size.x, (int)size.y };
+        countDraw(texture);
         return SDL_RenderCopy(renderer_, texture, nullptr, &dstrect);
     }
 
@@ -251,8 +312,10 @@ namespace GameLib {
 #endif
         if (!t)
             return -1;
+        SDL_Rect srcrect{ t->x, t->y, t->w, t->h };
         SDL_Rect dstrect{ (int)position.x, (int)position.y, t->w, t->h };
-        return SDL_RenderCopy(renderer_, t->texture, nullptr, &dstrect);
+        countDraw(t->texture);
+        return SDL_RenderCopy(renderer_, t->texture, &srcrect, &dstrect);
     }
 
     int Context::drawTexture(int tilesetId, int tileId, SPRITEINFO& spriteInfo) {
@@ -263,10 +326,12 @@ namespace GameLib {
 #endif
         if (!t)
             return -1;
+        SDL_Rect srcrect{ t->x, t->y, t->w, t->h };
         SDL_Rect dstrect{ (int)spriteInfo.position.x, (int)spriteInfo.position.y, t->w, t->h };
         SDL_Point center{ (int)spriteInfo.center.x, (int)spriteInfo.center.y };
         SDL_RendererFlip flip = (spriteInfo.flipFlags & 1) ? SDL_FLIP_HORIZONTAL : (spriteInfo.flipFlags & 2) ? SDL_FLIP_VERTICAL : SDL_FLIP_NONE;
-        return SDL_RenderCopyEx(renderer_, t->texture, nullptr, &dstrect, spriteInfo.angle, &center, flip);
+        countDraw(t->texture);
+        return SDL_RenderCopyEx(renderer_, t->texture, &srcrect, &dstrect, spriteInfo.angle, &center, flip);
     }
 
     void Context::clearScreen(SDL_Color color) {
@@ -274,7 +339,13 @@ namespace GameLib {
         SDL_RenderClear(renderer_);
     }
 
-    void Context::swapBuffers() { SDL_RenderPresent(renderer_); }
+    void Context::swapBuffers() {
+        HFPROFILE("Context::swapBuffers");
+        SDL_RenderPresent(renderer_);
+        lastRenderStats_ = renderStats_;
+        renderStats_ = RENDERSTATS();
+        lastDrawnTexture_ = nullptr;
+    }
 
     //////////////////////////////////////////////////////////////////
     // SEARCH PATHS //////////////////////////////////////////////////
@@ -283,6 +354,7 @@ namespace GameLib {
     void Context::addSearchPath(const std::string& path) {
         if (path.empty()) {
             searchPaths_.push_back("./");
+            _indexSearchPath(searchPaths_.back());
             return;
         }
 
@@ -297,26 +369,460 @@ namespace GameLib {
         // add path if it exists and is a folder?
         if (filesystem::is_directory(search_path)) {
             searchPaths_.push_back(search_path);
+            _indexSearchPath(search_path);
         } else {
             HFLOGWARN("'%s' is not a directory", search_path.c_str());
         }
     }
 
-    void Context::clearSearchPaths() { searchPaths_.clear(); }
+    void Context::clearSearchPaths() {
+        searchPaths_.clear();
+        std::lock_guard<std::mutex> lock(searchMutex_);
+        searchIndex_.clear();
+        searchCache_.clear();
+    }
+
+    void Context::refreshSearchPaths() {
+        // the new index is built aside so loader threads keep finding files while the disk is walked
+        SearchIndex index;
+        for (auto& dir : searchPaths_) {
+            _scanSearchPath(dir, index);
+        }
+        std::lock_guard<std::mutex> lock(searchMutex_);
+        searchIndex_.swap(index);
+        searchCache_.clear();
+    }
 
     std::string Context::findSearchPath(const std::string& filename) const {
+        {
+            std::lock_guard<std::mutex> lock(searchMutex_);
+            auto cached = searchCache_.find(filename);
+            if (cached != searchCache_.end())
+                return cached->second;
+        }
+
+        // a path with a directory that names a file directly wins over the search paths,
+        // this costs one stat per new name and is done unlocked so other lookups are not held up
         std::string path;
-        if (filesystem::is_regular_file(filename)) {
+        std::error_code ec;
+        if (filename.find_first_of("/\\") != std::string::npos && filesystem::is_regular_file(filename, ec))
             path = filename;
-        } else
-            for (auto& dir : searchPaths_) {
-                std::string p{ dir + filename };
-                if (filesystem::is_regular_file(p)) {
-                    path = p;
-                    break;
+
+        std::lock_guard<std::mutex> lock(searchMutex_);
+        if (path.empty()) {
+            auto it = searchIndex_.find(filename);
+            if (it != searchIndex_.end())
+                path = it->second;
+        }
+        searchCache_.emplace(filename, path);
+        return path;
+    }
+
+    void Context::_indexSearchPath(const std::string& dir) {
+        SearchIndex index;
+        _scanSearchPath(dir, index);
+        std::lock_guard<std::mutex> lock(searchMutex_);
+        // earlier search paths win, so existing names are kept
+        for (auto& [name, path] : index) {
+            searchIndex_.emplace(name, std::move(path));
+        }
+        // misses may now be found
+        searchCache_.clear();
+    }
+
+    void Context::_scanSearchPath(const std::string& dir, SearchIndex& index) {
+        std::error_code ec;
+        for (auto it = filesystem::recursive_directory_iterator(dir, ec); !ec && it != filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (!it->is_regular_file(ec))
+                continue;
+            std::string path = it->path().generic_string();
+            // earlier search paths win, so existing names are kept
+            index.emplace(path.substr(dir.size()), path);
+        }
+    }
+
+    bool Context::_updateSearchIndex(const std::string& path) {
+        std::error_code ec;
+        bool exists = filesystem::is_regular_file(path, ec);
+        for (size_t i = 0; i < searchPaths_.size(); i++) {
+            if (path.compare(0, searchPaths_[i].size(), searchPaths_[i]) != 0)
+                continue;
+            std::string name = path.substr(searchPaths_[i].size());
+            std::string found;
+            if (exists) {
+                found = path;
+            } else {
+                // a removed file uncovers the same name in a later search path
+                for (size_t j = i + 1; j < searchPaths_.size() && found.empty(); j++) {
+                    if (filesystem::is_regular_file(searchPaths_[j] + name, ec))
+                        found = searchPaths_[j] + name;
                 }
             }
-        return path;
+
+            std::lock_guard<std::mutex> lock(searchMutex_);
+            auto it = searchIndex_.find(name);
+            if (it != searchIndex_.end()) {
+                // a file shadowed by an earlier search path leaves the index as it is
+                bool shadowed = false;
+                for (size_t j = 0; j < i && !shadowed; j++) {
+                    shadowed = it->second.compare(0, searchPaths_[j].size(), searchPaths_[j]) == 0;
+                }
+                if (shadowed || (exists && it->second == path))
+                    continue;
+            }
+            if (found.empty())
+                searchIndex_.erase(name);
+            else
+                searchIndex_[name] = found;
+            // cached results, including misses and direct paths, may be out of date
+            searchCache_.clear();
+        }
+        return exists;
+    }
+
+    bool Context::mountArchive(const std::string& path) {
+        auto archive = std::make_unique<AssetArchive>();
+        if (!archive->open(path))
+            return false;
+        HFLOGINFO("mounted '%s' (%d assets)", path.c_str(), archive->count());
+        archives_.push_back(std::move(archive));
+        return true;
+    }
+
+    void Context::unmountArchives() { archives_.clear(); }
+
+    std::string_view Context::findArchived(const std::string& filename) const {
+        for (auto& archive : archives_) {
+            std::string_view data = archive->find(filename);
+            if (data.data())
+                return data;
+        }
+        return {};
+    }
+
+    SDL_RWops* Context::openAsset(const std::string& filename) const {
+        std::string_view data = findArchived(filename);
+        if (data.data())
+            return SDL_RWFromConstMem(data.data(), (int)data.size());
+        std::string path = findSearchPath(filename);
+        if (path.empty())
+            return nullptr;
+        return SDL_RWFromFile(path.c_str(), "rb");
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // TEXTURE CACHE /////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////
+
+    bool Context::enableTextureCache(const std::string& directory) {
+        // loader threads read textureCache_ without a lock
+        waitForLoads();
+        auto cache = std::make_unique<TextureCache>();
+        if (!cache->open(directory))
+            return false;
+        textureCache_ = std::move(cache);
+        HFLOGINFO("caching decoded images in '%s'", textureCache_->directory().c_str());
+        return true;
+    }
+
+    void Context::disableTextureCache() {
+        waitForLoads();
+        textureCache_.reset();
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // ASYNC LOADING /////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////
+
+    void Context::LOADJOB::free() {
+        if (surface)
+            SDL_FreeSurface(surface);
+        for (SDL_Surface* p : pages)
+            SDL_FreeSurface(p);
+        if (chunk)
+            Mix_FreeChunk(chunk);
+        if (music)
+            Mix_FreeMusic(music);
+        surface = nullptr;
+        pages.clear();
+        chunk = nullptr;
+        music = nullptr;
+    }
+
+    std::shared_future<bool> Context::loadImageAsync(const std::string& filename) {
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::IMAGE;
+        job->filename = filename;
+        return _queueLoad(job);
+    }
+
+    std::shared_future<bool> Context::loadTilesetAsync(int tilesetId, int w, int h, const std::string& filename) {
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::TILESET;
+        job->id = tilesetId;
+        job->w = w;
+        job->h = h;
+        job->filename = filename;
+        return _queueLoad(job);
+    }
+
+    std::shared_future<bool> Context::loadAudioClipAsync(int clipId, const std::string& filename) {
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::AUDIO;
+        job->id = clipId;
+        job->filename = filename;
+        return _queueLoad(job);
+    }
+
+    std::shared_future<bool> Context::loadMusicClipAsync(int musicId, const std::string& filename) {
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::MUSIC;
+        job->id = musicId;
+        job->filename = filename;
+        return _queueLoad(job);
+    }
+
+    Context::LOADPROGRESS Context::loadProgress() const {
+        LOADPROGRESS progress;
+        progress.queued = loadsQueued_;
+        progress.finished = loadsFinished_;
+        progress.failed = loadsFailed_;
+        return progress;
+    }
+
+    std::shared_future<bool> Context::_queueLoad(LoadJobPtr job) {
+        std::shared_future<bool> future = job->done.get_future().share();
+        job->queued = std::chrono::steady_clock::now();
+        loadsQueued_++;
+        _loaderPool().submit([this, job]() {
+            Hf::Profiler.setThreadName("Loader");
+            _decode(*job);
+            {
+                std::lock_guard<std::mutex> lock(loadMutex_);
+                loadResults_.push_back(job);
+            }
+            loadCv_.notify_all();
+        });
+        return future;
+    }
+
+    ThreadPool& Context::_loaderPool() const {
+        // tileset packing may ask for the pool from a loader thread
+        std::lock_guard<std::mutex> lock(loaderPoolMutex_);
+        if (!loaderPool_)
+            loaderPool_ = std::make_unique<ThreadPool>(loaderThreadCount);
+        return *loaderPool_;
+    }
+
+    void Context::_decode(LOADJOB& job) const {
+        HFPROFILE("Context::decode");
+        bool audio = job.type == LOADJOB::AUDIO || job.type == LOADJOB::MUSIC;
+        if (audio && !audioInitialized_)
+            return;
+        switch (job.type) {
+        case LOADJOB::IMAGE: {
+            std::vector<SDL_Surface*> surfaces = _decodeImage(job.filename, 0, 0);
+            if (!surfaces.empty())
+                job.surface = surfaces[0];
+            break;
+        }
+        case LOADJOB::TILESET: job.pages = _decodeImage(job.filename, job.w, job.h); break;
+        case LOADJOB::AUDIO:
+            if (SDL_RWops* rw = openAsset(job.filename)) {
+                std::lock_guard<std::mutex> lock(audioDecodeMutex_);
+                job.chunk = Mix_LoadWAV_RW(rw, 1);
+            }
+            break;
+        case LOADJOB::MUSIC:
+            if (SDL_RWops* rw = openAsset(job.filename)) {
+                std::lock_guard<std::mutex> lock(audioDecodeMutex_);
+                job.music = Mix_LoadMUS_RW(rw, 1);
+            }
+            break;
+        }
+    }
+
+    std::vector<SDL_Surface*> Context::_decodeImage(const std::string& filename, int w, int h) const {
+        TextureCache::SOURCE source;
+        if (textureCache_) {
+            source.w = w;
+            source.h = h;
+            std::string_view data = findArchived(filename);
+            if (data.data()) {
+                // archived files have no modification time, hashing the bytes is still far cheaper than decoding
+                source.path = "archive:" + filename;
+                source.size = data.size();
+                source.stamp = TextureCache::hash(data);
+            } else {
+                source.path = findSearchPath(filename);
+                std::error_code ec;
+                source.size = filesystem::file_size(source.path, ec);
+                source.stamp = (uint64_t)filesystem::last_write_time(source.path, ec).time_since_epoch().count();
+            }
+            std::vector<SDL_Surface*> surfaces;
+            if (!source.path.empty())
+                surfaces = textureCache_->load(source);
+            if (!surfaces.empty())
+                return surfaces;
+        }
+
+        SDL_RWops* rw = openAsset(filename);
+        if (!rw)
+            return {};
+        SDL_Surface* surface = IMG_Load_RW(rw, 1);
+        if (!surface)
+            return {};
+        std::vector<SDL_Surface*> surfaces;
+        if (w > 0 && h > 0) {
+            surfaces = _packTileset(surface, w, h);
+        } else {
+            surfaces.push_back(surface);
+        }
+        if (textureCache_ && !source.path.empty())
+            textureCache_->store(source, surfaces);
+        return surfaces;
+    }
+
+    bool Context::_install(LOADJOB& job) {
+        std::string name = filesystem::path(job.filename).filename().string();
+        switch (job.type) {
+        case LOADJOB::IMAGE: {
+            if (!job.surface || (job.reload && !images_.count(name)))
+                return false;
+            if (!_setImage(name, job.filename, job.surface))
+                return false;
+            break;
+        }
+        case LOADJOB::TILESET:
+            if (job.pages.empty() || (job.reload && !tilesetSources_.count(job.id)))
+                return false;
+            if (!_setTileset(job.id, job.w, job.h, job.pages))
+                return false;
+            tilesetSources_[job.id] = { job.w, job.h, job.filename };
+            break;
+        case LOADJOB::AUDIO: {
+            if (!job.chunk || (job.reload && !audioClips_.count(job.id)))
+                return false;
+            // freeing the old chunk halts any channel playing it
+            AUDIOINFO& audio = *initAudioClip(job.id);
+            audio.chunk = job.chunk;
+            audio.name = name;
+            audio.filename = job.filename;
+            job.chunk = nullptr;
+            break;
+        }
+        case LOADJOB::MUSIC: {
+            if (!job.music)
+                return false;
+            MUSICINFO& music = *initMusicClip(job.id);
+            music.chunk = job.music;
+            music.name = name;
+            job.music = nullptr;
+            break;
+        }
+        }
+        HFLOGINFO("%s '%s'", job.reload ? "reloaded" : "loaded", job.filename.c_str());
+        return true;
+    }
+
+    int Context::finishLoads() {
+        HFPROFILE("Context::finishLoads");
+        std::vector<LoadJobPtr> results;
+        {
+            std::lock_guard<std::mutex> lock(loadMutex_);
+            results.swap(loadResults_);
+        }
+        int installed = 0;
+        for (auto& job : results) {
+            bool result = _install(*job);
+            if (result) {
+                installed++;
+            } else {
+                HFLOGWARN("'%s' could not be %s", job->filename.c_str(), job->reload ? "reloaded" : "loaded");
+                loadsFailed_++;
+                _restoreFailed(*job);
+            }
+            job->free();
+            loadsFinished_++;
+            Hf::Log.recordStat("asset load ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->queued).count());
+            job->done.set_value(result);
+        }
+        return installed;
+    }
+
+    void Context::waitForLoads() {
+        while (loadsPending()) {
+            {
+                std::unique_lock<std::mutex> lock(loadMutex_);
+                loadCv_.wait(lock, [this] { return !loadResults_.empty(); });
+            }
+            finishLoads();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // HOT RELOAD ////////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////
+
+    bool Context::enableHotReload() {
+        if (watcher_)
+            return true;
+        auto watcher = std::make_unique<AssetWatcher>();
+        if (!watcher->start(searchPaths_)) {
+            HFLOGWARN("search paths can not be watched");
+            return false;
+        }
+        watcher_ = std::move(watcher);
+        HFLOGINFO("watching %d search paths", (int)searchPaths_.size());
+        return true;
+    }
+
+    void Context::disableHotReload() { watcher_.reset(); }
+
+    void Context::watchFile(const std::string& filename, std::function<void(const std::string&)> onChanged) {
+        fileWatches_.emplace(filesystem::path(filename).filename().string(), std::move(onChanged));
+    }
+
+    void Context::_queueReloads(const std::string& path) {
+        std::string name = filesystem::path(path).filename().string();
+        std::vector<LoadJobPtr> jobs;
+        // assets are read again from the path they were loaded from, which may be a subdirectory
+        auto image = images_.find(name);
+        if (image != images_.end()) {
+            auto job = std::make_shared<LOADJOB>();
+            job->type = LOADJOB::IMAGE;
+            job->filename = image->second.filename;
+            jobs.push_back(job);
+        }
+        for (auto& [id, source] : tilesetSources_) {
+            if (filesystem::path(source.filename).filename().string() != name)
+                continue;
+            auto job = std::make_shared<LOADJOB>();
+            job->type = LOADJOB::TILESET;
+            job->id = id;
+            job->filename = source.filename;
+            job->w = source.w;
+            job->h = source.h;
+            jobs.push_back(job);
+        }
+        for (auto& [id, audio] : audioClips_) {
+            if (!audio || audio.name != name)
+                continue;
+            auto job = std::make_shared<LOADJOB>();
+            job->type = LOADJOB::AUDIO;
+            job->id = id;
+            job->filename = audio.filename;
+            jobs.push_back(job);
+        }
+        for (auto& job : jobs) {
+            job->reload = true;
+            _queueLoad(job);
+        }
+
+        auto range = fileWatches_.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+            it->second(path);
+        }
     }
 
     //////////////////////////////////////////////////////////////////
@@ -324,41 +830,61 @@ namespace GameLib {
     //////////////////////////////////////////////////////////////////
 
     SDL_Texture* Context::loadImage(const std::string& filename) {
-        std::string p = findSearchPath(filename);
-        if (p.empty())
-            return nullptr;
-        filesystem::path path = p;
+        HFPROFILE("Context::loadImage");
+        filesystem::path path = filename;
         std::string resourceName = std::move(path.filename().string());
-        if (images_.count(resourceName)) {
-            SDL_DestroyTexture(images_[resourceName].texture);
-        }
-        SDL_Surface* img = IMG_Load(p.c_str());
-        if (!img) {
+        std::vector<SDL_Surface*> surfaces = _decodeImage(filename, 0, 0);
+        if (surfaces.empty()) {
             HFLOGERROR("'%s' not found", resourceName.c_str());
             return nullptr;
         }
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, img);
-        images_[resourceName].texture = texture;
-        SDL_FreeSurface(img);
+        SDL_Texture* texture = _setImage(resourceName, filename, surfaces[0]);
+        SDL_FreeSurface(surfaces[0]);
         HFLOGINFO("loaded '%s'", filename.c_str());
         return texture;
     }
 
+    SDL_Texture* Context::_setImage(const std::string& name, const std::string& filename, SDL_Surface* surface) {
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
+        if (!texture)
+            return nullptr;
+        IMAGE& image = images_[name];
+        if (image.image.texture)
+            SDL_DestroyTexture(image.image.texture);
+        textureBytes_ -= image.residency.bytes;
+        image.image.texture = texture;
+        image.image.w = surface->w;
+        image.image.h = surface->h;
+        image.filename = filename;
+        image.residency.bytes = (size_t)surface->w * surface->h * 4;
+        image.residency.lastUsed = frame_;
+        image.residency.resident = true;
+        image.residency.restoring = false;
+        textureBytes_ += image.residency.bytes;
+        return texture;
+    }
+
     void Context::freeImages() {
         for (auto& [k, v] : images_) {
-            SDL_DestroyTexture(v.texture);
-            v.texture = nullptr;
+            SDL_DestroyTexture(v.image.texture);
+            v.image.texture = nullptr;
+            textureBytes_ -= v.residency.bytes;
         }
         images_.clear();
     }
 
     bool Context::imageLoaded(const std::string& resourceName) const { return images_.count(resourceName); }
 
-    SDL_Texture* Context::getImage(const std::string& resourceName) const {
-        if (images_.count(resourceName)) {
-            return images_.at(resourceName).texture;
+    SDL_Texture* Context::getImage(const std::string& resourceName) {
+        auto it = images_.find(resourceName);
+        if (it == images_.end())
+            return nullptr;
+        _useTexture(it->second.residency);
+        if (!it->second.residency.resident) {
+            _restoreImage(it->second);
+            return _placeholder(1, 1);
         }
-        return nullptr;
+        return it->second.image.texture;
     }
 
     //////////////////////////////////////////////////////////////////
@@ -366,82 +892,329 @@ namespace GameLib {
     //////////////////////////////////////////////////////////////////
 
     std::vector<TILEIMAGE>& Context::_initTileset(int id) {
-        if (!tilesets_.count(id)) {
-            auto& tileset = tilesets_[id];
-            tileset.clear();
-        } else {
-            auto& tileset = tilesets_[id];
-            for (auto& t : tileset) {
-                if (t.texture) {
-                    SDL_DestroyTexture(t.texture);
-                }
-                t = TILEIMAGE();
+        auto& tileset = tilesets_[id];
+        for (SDL_Texture* page : tileset.pages) {
+            if (page) {
+                SDL_DestroyTexture(page);
             }
-            tilesets_[id].clear();
         }
-        return tilesets_[id];
+        tileset.pages.clear();
+        tileset.tiles.clear();
+        textureBytes_ -= tileset.residency.bytes;
+        tileset.residency = RESIDENCY();
+        tileset.residency.lastUsed = frame_;
+        return tileset.tiles;
     }
 
-    int Context::_addTile(int tilesetId, SDL_Surface* surface) {
+    int Context::_setTileset(int tilesetId, int w, int h, const std::vector<SDL_Surface*>& pages) {
+        auto& tiles = _initTileset(tilesetId);
         auto& tileset = tilesets_[tilesetId];
-
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
-        if (!texture)
-            return 0;
-
-        TILEIMAGE t;
-        t.texture = texture;
-        t.tileId = (int)tileset.size();
-        t.tilesetId = tilesetId;
-        t.w = surface->w;
-        t.h = surface->h;
-        tileset.push_back(t);
-        return t.tileId;
+        for (SDL_Surface* surface : pages) {
+            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
+            if (!texture)
+                continue;
+            tileset.pages.push_back(texture);
+            size_t bytes = (size_t)surface->w * surface->h * 4;
+            tileset.residency.bytes += bytes;
+            textureBytes_ += bytes;
+            for (int y = 0; y + h <= surface->h; y += h) {
+                for (int x = 0; x + w <= surface->w; x += w) {
+                    TILEIMAGE t;
+                    t.texture = texture;
+                    t.tileId = (int)tiles.size();
+                    t.tilesetId = tilesetId;
+                    t.x = x;
+                    t.y = y;
+                    t.w = w;
+                    t.h = h;
+                    tiles.push_back(t);
+                }
+            }
+        }
+        return (int)tiles.size();
     }
 
     int Context::loadTileset(int tilesetId, int w, int h, const std::string& filename) {
-        std::string p = findSearchPath(filename);
-        if (p.empty())
+        HFPROFILE("Context::loadTileset");
+        std::vector<SDL_Surface*> pages = _decodeImage(filename, w, h);
+        if (pages.empty())
             return 0;
-        SDL_Surface* surface = IMG_Load(p.c_str());
-        if (!surface)
-            return 0;
-        int tileCount = 0;
-        SDL_Rect dstrect{ 0, 0, w, h };
-        auto tileset = _initTileset(tilesetId);
-        for (int y = 0; y < surface->h; y += h) {
-            for (int x = 0; x < surface->w; x += w) {
-                SDL_Surface* tile = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
-                if (!tile) {
-                    SDL_FreeSurface(surface);
-                    return 0;
+        int count = _setTileset(tilesetId, w, h, pages);
+        for (SDL_Surface* page : pages) {
+            SDL_FreeSurface(page);
+        }
+        tilesetSources_[tilesetId] = { w, h, filename };
+        HFLOGINFO("loaded '%s'", filename.c_str());
+        return count;
+    }
+
+    std::vector<SDL_Surface*> Context::_packTileset(SDL_Surface* sheet, int w, int h) const {
+        if (w <= 0 || h <= 0 || w > maxTextureSize_ || h > maxTextureSize_) {
+            SDL_FreeSurface(sheet);
+            return {};
+        }
+        // tiles are copied as rows of RGBA32 pixels, so other formats are converted once up front
+        SDL_Surface* rgba = sheet;
+        if (sheet->format->format != SDL_PIXELFORMAT_RGBA32) {
+            rgba = SDL_ConvertSurfaceFormat(sheet, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(sheet);
+        }
+        if (!rgba)
+            return {};
+
+        // tiles at the right and bottom edges may be partly outside the sheet, like before they are padded
+        // with transparent pixels. When the sheet fits in one texture the page has the sheet's layout
+        int cols = (rgba->w + w - 1) / w;
+        int rows = (rgba->h + h - 1) / h;
+        int count = cols * rows;
+        int pageCols = std::min(cols, maxTextureSize_ / w);
+        int pageTiles = pageCols * (maxTextureSize_ / h);
+        // a sheet of whole tiles that fits in one texture is already its own atlas
+        if (pageTiles >= count && cols == pageCols && rgba->w == cols * w && rgba->h == rows * h)
+            return { rgba };
+
+        // a partly filled last row would add padding tiles that _setTileset() counts as tiles,
+        // so the tiles of a last page that do not fill a row get a one row page of their own
+        std::vector<SDL_Surface*> pages;
+        std::vector<int> firstTiles;
+        for (int first = 0; first < count;) {
+            int n = std::min(pageTiles, count - first);
+            if (n > pageCols && n % pageCols)
+                n -= n % pageCols;
+            int pageW = std::min(n, pageCols) * w;
+            int pageH = (n + pageCols - 1) / pageCols * h;
+            SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, pageW, pageH, 32, SDL_PIXELFORMAT_RGBA32);
+            if (!page) {
+                for (SDL_Surface* p : pages)
+                    SDL_FreeSurface(p);
+                SDL_FreeSurface(rgba);
+                return {};
+            }
+            pages.push_back(page);
+            firstTiles.push_back(first);
+            first += n;
+        }
+
+        SDL_LockSurface(rgba);
+        auto copyTiles = [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                int sx = (i % cols) * w;
+                int sy = (i / cols) * h;
+                int cw = std::min(w, rgba->w - sx);
+                int ch = std::min(h, rgba->h - sy);
+                int p = int(std::upper_bound(firstTiles.begin(), firstTiles.end(), i) - firstTiles.begin()) - 1;
+                SDL_Surface* page = pages[p];
+                int j = i - firstTiles[p];
+                int dx = (j % pageCols) * w;
+                int dy = (j / pageCols) * h;
+                const char* src = static_cast<const char*>(rgba->pixels) + sy * rgba->pitch + sx * 4;
+                char* dst = static_cast<char*>(page->pixels) + dy * page->pitch + dx * 4;
+                for (int y = 0; y < ch; y++) {
+                    memcpy(dst + y * page->pitch, src + y * rgba->pitch, cw * 4);
                 }
-                SDL_Rect srcrect{ x, y, w, h };
-                SDL_BlitSurface(surface, &srcrect, tile, &dstrect);
-                _addTile(tilesetId, tile);
-                tileCount++;
             }
+        };
+        // large sheets are copied in chunks of tiles shared with the loader pool, each chunk goes to
+        // disjoint parts of the pages. The calling thread takes chunks too, so packing never waits on
+        // pool tasks queued behind other loads, and tasks that start after the last chunk do nothing
+        int chunks = (count + MinTilesPerPackThread - 1) / MinTilesPerPackThread;
+        if (chunks > 1) {
+            struct PACKSTATE {
+                std::function<void(int, int)> copy;
+                int count{ 0 };
+                int chunks{ 0 };
+                std::atomic<int> next{ 0 };
+                int finished{ 0 };
+                std::mutex mutex;
+                std::condition_variable cv;
+            };
+            auto state = std::make_shared<PACKSTATE>();
+            state->copy = copyTiles;
+            state->count = count;
+            state->chunks = chunks;
+            auto work = [state]() {
+                for (int chunk; (chunk = state->next++) < state->chunks;) {
+                    int begin = chunk * MinTilesPerPackThread;
+                    state->copy(begin, std::min(state->count, begin + MinTilesPerPackThread));
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (++state->finished == state->chunks)
+                        state->cv.notify_all();
+                }
+            };
+            ThreadPool& pool = _loaderPool();
+            int tasks = std::min(pool.threadCount(), chunks - 1);
+            for (int t = 0; t < tasks; t++) {
+                pool.submit(work);
+            }
+            work();
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&]() { return state->finished == state->chunks; });
+        } else {
+            copyTiles(0, count);
         }
-        HFLOGINFO("loaded '%s'", filename.c_str());
-        return tileCount;
+        SDL_UnlockSurface(rgba);
+        SDL_FreeSurface(rgba);
+        return pages;
     }
 
     void Context::freeTilesets() {
         for (auto& [k, v] : tilesets_) {
-            for (auto& t : v) {
-                SDL_DestroyTexture(t.texture);
+            for (SDL_Texture* page : v.pages) {
+                SDL_DestroyTexture(page);
+            }
+            v.pages.clear();
+            for (auto& t : v.tiles) {
                 t.texture = nullptr;
             }
+            textureBytes_ -= v.residency.bytes;
+            v.residency = RESIDENCY();
+            v.residency.resident = false;
         }
+        // freed tilesets have no source, so they are not restored or hot reloaded
+        tilesetSources_.clear();
     }
 
     TILEIMAGE* Context::getTile(int tilesetId, int tileId) {
-        if (!tilesets_.count(tilesetId))
+        auto it = tilesets_.find(tilesetId);
+        if (it == tilesets_.end())
             return nullptr;
-        auto& tileset = tilesets_.at(tilesetId);
-        if (tileId >= tileset.size())
+        auto& tileset = it->second;
+        if (tileId < 0 || tileId >= (int)tileset.tiles.size())
             return nullptr;
-        return &tileset[tileId];
+        _useTexture(tileset.residency);
+        if (!tileset.residency.resident)
+            _restoreTileset(tilesetId, tileset);
+        return &tileset.tiles[tileId];
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // TEXTURE RESIDENCY /////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////
+
+    void Context::setTextureBudget(size_t bytes) {
+        textureBudget_ = bytes;
+        _evictTextures();
+    }
+
+    Context::TEXTURESTATS Context::textureStats() const {
+        TEXTURESTATS stats;
+        stats.bytes = textureBytes_;
+        stats.budget = textureBudget_;
+        for (auto& [k, v] : images_) {
+            v.residency.resident ? stats.resident++ : stats.evicted++;
+        }
+        for (auto& [k, v] : tilesets_) {
+            v.residency.resident ? stats.resident++ : stats.evicted++;
+        }
+        stats.hits = textureHits_;
+        stats.misses = textureMisses_;
+        stats.evictions = textureEvictions_;
+        return stats;
+    }
+
+    void Context::_restoreImage(IMAGE& image) {
+        if (image.residency.restoring)
+            return;
+        textureMisses_++;
+        image.residency.restoring = true;
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::IMAGE;
+        job->filename = image.filename;
+        job->reload = true;
+        _queueLoad(job);
+    }
+
+    void Context::_restoreFailed(const LOADJOB& job) {
+        // the placeholder stays until the next access queues the restore again
+        if (job.type == LOADJOB::IMAGE) {
+            auto it = images_.find(filesystem::path(job.filename).filename().string());
+            if (it != images_.end())
+                it->second.residency.restoring = false;
+        } else if (job.type == LOADJOB::TILESET) {
+            auto it = tilesets_.find(job.id);
+            if (it != tilesets_.end())
+                it->second.residency.restoring = false;
+        }
+    }
+
+    void Context::_restoreTileset(int tilesetId, TILESET& tileset) {
+        auto source = tilesetSources_.find(tilesetId);
+        if (tileset.residency.restoring || source == tilesetSources_.end())
+            return;
+        textureMisses_++;
+        tileset.residency.restoring = true;
+        // every tile draws the placeholder from its origin until _setTileset() rebuilds the tiles
+        SDL_Texture* placeholder = _placeholder(source->second.w, source->second.h);
+        for (auto& t : tileset.tiles) {
+            t.texture = placeholder;
+            t.x = 0;
+            t.y = 0;
+        }
+        auto job = std::make_shared<LOADJOB>();
+        job->type = LOADJOB::TILESET;
+        job->id = tilesetId;
+        job->filename = source->second.filename;
+        job->w = source->second.w;
+        job->h = source->second.h;
+        job->reload = true;
+        _queueLoad(job);
+    }
+
+    SDL_Texture* Context::_placeholder(int w, int h) {
+        SDL_Texture*& texture = placeholders_[{ w, h }];
+        if (texture || !renderer_)
+            return texture;
+        texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, w, h);
+        if (!texture)
+            return nullptr;
+        // every byte is 0x80, so the pixel is the same in any byte order
+        std::vector<uint32_t> pixels((size_t)w * h, 0x80808080);
+        SDL_UpdateTexture(texture, nullptr, pixels.data(), w * 4);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        return texture;
+    }
+
+    void Context::_evictTextures() {
+        while (textureBudget_ && textureBytes_ > textureBudget_) {
+            // the budget is only enforced between frames and the resource count is small, so a scan is enough
+            RESIDENCY* oldest = nullptr;
+            IMAGE* image = nullptr;
+            TILESET* tileset = nullptr;
+            for (auto& [k, v] : images_) {
+                RESIDENCY& r = v.residency;
+                if (r.resident && r.bytes && r.lastUsed < frame_ && (!oldest || r.lastUsed < oldest->lastUsed)) {
+                    oldest = &r;
+                    image = &v;
+                    tileset = nullptr;
+                }
+            }
+            for (auto& [k, v] : tilesets_) {
+                RESIDENCY& r = v.residency;
+                if (r.resident && r.bytes && r.lastUsed < frame_ && (!oldest || r.lastUsed < oldest->lastUsed)) {
+                    oldest = &r;
+                    image = nullptr;
+                    tileset = &v;
+                }
+            }
+            if (!oldest)
+                break;
+            if (image) {
+                SDL_DestroyTexture(image->image.texture);
+                image->image.texture = nullptr;
+            } else {
+                for (SDL_Texture* page : tileset->pages) {
+                    SDL_DestroyTexture(page);
+                }
+                tileset->pages.clear();
+                for (auto& t : tileset->tiles) {
+                    t.texture = nullptr;
+                }
+            }
+            textureBytes_ -= oldest->bytes;
+            oldest->bytes = 0;
+            oldest->resident = false;
+            textureEvictions_++;
+        }
     }
 
     //////////////////////////////////////////////////////////////////
@@ -470,22 +1243,28 @@ namespace GameLib {
     }
 
     AUDIOINFO* Context::loadAudioClip(int clipId, const std::string& filename) {
+        HFPROFILE("Context::loadAudioClip");
         if (!audioInitialized_)
             return nullptr;
-        std::string p = findSearchPath(filename);
-        if (p.empty())
+        SDL_RWops* rw = openAsset(filename);
+        if (!rw)
             return nullptr;
         AUDIOINFO& audio = *initAudioClip(clipId);
 
-        Mix_Chunk* chunk = Mix_LoadWAV(p.c_str());
+        Mix_Chunk* chunk;
+        {
+            std::lock_guard<std::mutex> lock(audioDecodeMutex_);
+            chunk = Mix_LoadWAV_RW(rw, 1);
+        }
         if (!chunk) {
             HFLOGWARN("Unable to load '%s'", filename.c_str());
             HFLOGWARN("Mix_LoadWAV returned '%s'", Mix_GetError());
             return nullptr;
         }
-        filesystem::path path = p;
+        filesystem::path path = filename;
         audio.chunk = chunk;
         audio.name = path.filename().string();
+        audio.filename = filename;
         HFLOGINFO("loaded '%s'", filename.c_str());
         return &audio;
     }
@@ -496,7 +1275,47 @@ namespace GameLib {
         AUDIOINFO* audio = getAudioClip(clipId);
         if (!audio)
             return -1;
-        return Mix_PlayChannel(-1, audio->chunk, 0);
+        return Mix_PlayChannel(channel, audio->chunk, 0);
+    }
+
+    int Context::allocateAudioChannels(int count) {
+        if (!audioInitialized_)
+            return 0;
+        return Mix_AllocateChannels(count);
+    }
+
+    bool Context::audioChannelPlaying(int channel) const {
+        if (!audioInitialized_)
+            return false;
+        return Mix_Playing(channel) != 0;
+    }
+
+    bool Context::setAudioBufferSize(int samples) {
+        if (!audioInitialized_)
+            return false;
+        int frequency;
+        Uint16 format;
+        int channels;
+        Mix_QuerySpec(&frequency, &format, &channels);
+        // reopening resets the channels to SDL_mixer's default, so the count and volumes an Audio
+        // voice pool set up are put back. The channels that were playing are stopped
+        int channelCount = Mix_AllocateChannels(-1);
+        std::vector<int> volumes(channelCount);
+        for (int i = 0; i < channelCount; i++) {
+            volumes[i] = Mix_Volume(i, -1);
+        }
+        Mix_CloseAudio();
+        if (Mix_OpenAudio(frequency, format, channels, samples) != 0) {
+            HFLOGERROR("Failed to reopen audio: %s", SDL_GetError());
+            audioInitialized_ = false;
+            return false;
+        }
+        Mix_AllocateChannels(channelCount);
+        for (int i = 0; i < channelCount; i++) {
+            Mix_Volume(i, volumes[i]);
+        }
+        HFLOGINFO("Audio buffer:      %d samples", samples);
+        return true;
     }
 
     void Context::stopAudioChannel(int channel) {
@@ -526,20 +1345,25 @@ namespace GameLib {
     }
 
     MUSICINFO* Context::loadMusicClip(int musicId, const std::string& filename) {
+        HFPROFILE("Context::loadMusicClip");
         if (!audioInitialized_)
             return nullptr;
-        std::string p = findSearchPath(filename);
-        if (p.empty())
+        SDL_RWops* rw = openAsset(filename);
+        if (!rw)
             return nullptr;
         MUSICINFO& music = *initMusicClip(musicId);
 
-        Mix_Music* chunk = Mix_LoadMUS(p.c_str());
+        Mix_Music* chunk;
+        {
+            std::lock_guard<std::mutex> lock(audioDecodeMutex_);
+            chunk = Mix_LoadMUS_RW(rw, 1);
+        }
         if (!chunk) {
             HFLOGWARN("Unable to load '%s'", filename.c_str());
             HFLOGWARN("Mix_LoadWAV returned '%s'", Mix_GetError());
             return nullptr;
         }
-        filesystem::path path = p;
+        filesystem::path path = filename;
         music.chunk = chunk;
         music.name = path.filename().string();
         HFLOGINFO("loaded '%s'", filename.c_str());
@@ -2,6 +2,14 @@
 #define GAMELIB_CONTEXT_HPP
 
 #include <gamelib_base.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 namespace GameLib {
     constexpr int WindowDefault = 0;
@@ -9,9 +17,16 @@ namespace GameLib {
     constexpr int WindowBorderless = SDL_WINDOW_BORDERLESS;
     constexpr int WindowResizeable = SDL_WINDOW_RESIZABLE;
     constexpr int WindowOpenGL = SDL_WINDOW_OPENGL;
+    // no window, audio or game controllers, drawing goes to an offscreen software renderer (SDL does not use this bit)
+    constexpr int WindowHeadless = 0x40000000;
 
     static constexpr int LIBXOR_TILESET32 = -1;
 
+    class AssetArchive;
+    class AssetWatcher;
+    class TextureCache;
+    class ThreadPool;
+
     class Context {
     public:
         Context(int width, int height, int flags = WindowResizeable);
@@ -25,6 +40,8 @@ namespace GameLib {
         bool hadError() const;
         const std::string errorString() const { return errorString_; }
         bool audioInitialized() const { return audioInitialized_; }
+        // returns true if the context was made with WindowHeadless
+        bool headless() const { return headless_; }
 
         //////////////////////////////////////////////////////////////
         // TIMING ////////////////////////////////////////////////////
@@ -45,9 +62,100 @@ namespace GameLib {
         void clearSearchPaths();
 
         // find a valid path using the configured search paths
-        // if file is not a regular file, returns an empty string
+        // if file is not a regular file, returns an empty string. Names with a directory are tried
+        // as a path first, bare names are only looked up in the search paths
+        // results, including misses, are cached until the search paths change
         std::string findSearchPath(const std::string& filename) const;
 
+        // rescan the search paths for files added or removed since they were indexed
+        // this happens automatically for new and removed files while hot reload is enabled
+        void refreshSearchPaths();
+
+        // mount a packed asset archive built by the assetpack tool. Archives are searched before
+        // the search paths, in the order they were mounted
+        bool mountArchive(const std::string& path);
+
+        // unmount all asset archives, fonts and music loaded from an archive read it
+        // while they are in use and must be freed first
+        void unmountArchives();
+
+        // returns the contents of filename from a mounted archive, or an empty view if it is not packed
+        std::string_view findArchived(const std::string& filename) const;
+
+        // opens filename from a mounted archive or the search paths, returns nullptr if it is not found
+        SDL_RWops* openAsset(const std::string& filename) const;
+
+        //////////////////////////////////////////////////////////////
+        // TEXTURE CACHE /////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////
+
+        // keep decoded and sliced images in directory so later runs skip decoding them
+        bool enableTextureCache(const std::string& directory);
+
+        // stop reading and writing the texture cache
+        void disableTextureCache();
+
+        // returns the texture cache, or nullptr if it is not enabled
+        const TextureCache* textureCache() const { return textureCache_.get(); }
+
+        //////////////////////////////////////////////////////////////
+        // ASYNC LOADING /////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////
+
+        // these queue a load on the loader threads and return a future that becomes true when the asset
+        // is ready to use, or false if it failed. Finding and decoding the file runs on the loader threads,
+        // textures are created on the main thread by finishLoads(), so the main thread must not wait on
+        // the future before calling waitForLoads(). Search paths must not change while loads are pending
+        std::shared_future<bool> loadImageAsync(const std::string& filename);
+        std::shared_future<bool> loadTilesetAsync(int tilesetId, int w, int h, const std::string& filename);
+        std::shared_future<bool> loadAudioClipAsync(int clipId, const std::string& filename);
+        std::shared_future<bool> loadMusicClipAsync(int musicId, const std::string& filename);
+
+        struct LOADPROGRESS {
+            int queued{ 0 };
+            int finished{ 0 };
+            int failed{ 0 };
+            // returns 1 when every queued load has finished
+            float fraction() const { return queued ? (float)finished / queued : 1.0f; }
+        };
+
+        // returns the number of async loads queued and finished so far, e.g. for a loading bar
+        LOADPROGRESS loadProgress() const;
+
+        // returns true if async loads are queued or waiting for finishLoads()
+        bool loadsPending() const { return loadsFinished_ < loadsQueued_; }
+
+        // creates textures for decoded loads and installs them, returns the number installed
+        // getEvents() calls this once per frame
+        int finishLoads();
+
+        // blocks until every queued load is finished
+        void waitForLoads();
+
+        // number of loader threads used when the first load is queued, 0 uses one per core less one
+        int loaderThreadCount{ 0 };
+
+        // SDL_mixer's loaders are not documented as thread safe, so every Mix_Load call holds this lock
+        // and only image decodes run in parallel on the loader threads
+        std::mutex& audioDecodeMutex() const { return audioDecodeMutex_; }
+
+        //////////////////////////////////////////////////////////////
+        // HOT RELOAD ////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////
+
+        // watch the search paths for changed files. Changed images, tilesets, and audio clips
+        // are decoded on the loader threads and swapped in by getEvents()
+        bool enableHotReload();
+
+        // stop watching the search paths
+        void disableHotReload();
+
+        // returns true if the search paths are being watched
+        bool hotReloadEnabled() const { return watcher_ != nullptr; }
+
+        // call onChanged with the new path from getEvents() when filename changes in a search path
+        void watchFile(const std::string& filename, std::function<void(const std::string&)> onChanged);
+
         //////////////////////////////////////////////////////////////
         // DRAWING AND IMAGES ////////////////////////////////////////
         //////////////////////////////////////////////////////////////
@@ -68,7 +176,8 @@ namespace GameLib {
         bool imageLoaded(const std::string& resourceName) const;
 
         // returns a pointer to the SDL_Texture, or nullptr if it does not exist
-        SDL_Texture* getImage(const std::string& resourceName) const;
+        // an image evicted by the texture budget is reloaded, so call this each frame rather than keeping the pointer
+        SDL_Texture* getImage(const std::string& resourceName);
 
         // load a tileset with a given tilesetId, width, and height
         int loadTileset(int tilesetId, int w, int h, const std::string& filename);
@@ -80,10 +189,16 @@ namespace GameLib {
         TILEIMAGE* getTile(int tilesetId, int tileId);
 
         // returns a pointer to the SDL_Texture with no error checking
-        TILEIMAGE* getTileFast(int tilesetId, int tileId) { return &tilesets_[tilesetId][tileId]; }
+        TILEIMAGE* getTileFast(int tilesetId, int tileId) {
+            TILESET& tileset = tilesets_[tilesetId];
+            _useTexture(tileset.residency);
+            if (!tileset.residency.resident)
+                _restoreTileset(tilesetId, tileset);
+            return &tileset.tiles[tileId];
+        }
 
         // returns number of tiles in a tileset
-        int getTileCount(int tilesetId) { return (int)tilesets_.at(tilesetId).size(); }
+        int getTileCount(int tilesetId) { return (int)tilesets_.at(tilesetId).tiles.size(); }
 
         // draws a rectangle to the screen. returns 0 if success, -1 if error
         int drawTexture(glm::vec2 position, glm::vec2 size, SDL_Texture* texture);
@@ -94,6 +209,57 @@ namespace GameLib {
         // draws a rotated, centerable, flipable rectangle to the screen. returns 0 if success, -1 if error
         int drawTexture(int tilesetId, int tileId, SPRITEINFO& spriteInfo);
 
+        struct RENDERSTATS {
+            // copies to the renderer made through gamelib
+            int drawCalls{ 0 };
+            // draws that used a different texture from the draw before, each one can break a batch
+            int textureSwitches{ 0 };
+        };
+
+        // counts a draw of texture in the frame's RENDERSTATS, gamelib calls this for every copy it makes
+        void countDraw(SDL_Texture* texture) {
+            if (!countDraws_)
+                return;
+            renderStats_.drawCalls++;
+            if (texture != lastDrawnTexture_) {
+                renderStats_.textureSwitches++;
+                lastDrawnTexture_ = texture;
+            }
+        }
+        // stops counting draws, so a debug overlay can draw without changing the counts it shows
+        void setDrawCounting(bool count) { countDraws_ = count; }
+        // returns the counts for the last frame presented by swapBuffers()
+        const RENDERSTATS& renderStats() const { return lastRenderStats_; }
+
+        //////////////////////////////////////////////////////////////
+        // TEXTURE RESIDENCY /////////////////////////////////////////
+        //////////////////////////////////////////////////////////////
+
+        struct TEXTURESTATS {
+            // bytes of texture memory held by images and tilesets, and the budget, 0 if unlimited
+            size_t bytes{ 0 };
+            size_t budget{ 0 };
+            // images and tilesets with textures, and those evicted
+            int resident{ 0 };
+            int evicted{ 0 };
+            // lookups that found textures, lookups that had to reload them, and evictions
+            uint64_t hits{ 0 };
+            uint64_t misses{ 0 };
+            uint64_t evictions{ 0 };
+        };
+
+        // limit the texture memory held by images and tilesets, 0 for no limit. getEvents() evicts the
+        // least recently drawn images and tilesets until the budget is met. The next time getImage() or
+        // getTile() asks for them they are decoded again on the loader threads, and a placeholder is drawn
+        // until finishLoads() installs them. Anything drawn this frame is never evicted
+        void setTextureBudget(size_t bytes);
+
+        // returns the texture budget in bytes, 0 if there is no limit
+        size_t textureBudget() const { return textureBudget_; }
+
+        // returns texture memory use and the residency counters
+        TEXTURESTATS textureStats() const;
+
         //////////////////////////////////////////////////////////////
         // AUDIO CODE ////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////
@@ -112,6 +278,13 @@ namespace GameLib {
         int playAudioClip(int clipId, int channel = -1);
         // stop an audio channel from playing
         void stopAudioChannel(int channel);
+        // sets the number of mixer channels, returns the number allocated
+        int allocateAudioChannels(int count);
+        // returns true if a clip is playing on the channel
+        bool audioChannelPlaying(int channel) const;
+        // reopens the audio device with a buffer of this many samples, smaller buffers lower latency
+        // this stops every channel and the music, the channel count and volumes are kept
+        bool setAudioBufferSize(int samples);
         // set the volume for a specific channel in the range 0 to 1
         void setChannelVolume(int channel, float volume);
         // get the volume for a specific channel in the range 0 to 1
@@ -133,7 +306,7 @@ namespace GameLib {
         // EVENT HANDLING CODE ///////////////////////////////////////
         //////////////////////////////////////////////////////////////
 
-        // handle all SDL events
+        // handle all SDL events, call once per frame. This also ends the Hf::Profiler frame
         int getEvents();
 
         // set quitRequested to a nonzero value to indicate the game loop should end
@@ -181,6 +354,7 @@ namespace GameLib {
     private:
         bool initialized_{ false };
         bool audioInitialized_{ false };
+        bool headless_{ false };
         mutable bool hadError_{ false };
         std::string errorString_;
         SDL_Window* window_{ nullptr };
@@ -189,11 +363,112 @@ namespace GameLib {
         SDL_AudioSpec audioSpec_;
         SDL_AudioDeviceID audioDeviceId_{ 0 };
         std::vector<std::string> searchPaths_;
-        std::map<std::string, TILEIMAGE> images_;
-        std::map<int, std::vector<TILEIMAGE>> tilesets_;
+        // every file under the search paths by its relative name, so lookups do not touch the disk
+        using SearchIndex = std::unordered_map<std::string, std::string>;
+        SearchIndex searchIndex_;
+        // findSearchPath results, an empty path records a file that was not found
+        mutable std::unordered_map<std::string, std::string> searchCache_;
+        // findSearchPath is also called from the loader threads
+        mutable std::mutex searchMutex_;
+        std::vector<std::unique_ptr<AssetArchive>> archives_;
+        std::unique_ptr<TextureCache> textureCache_;
+
+        // the texture memory held by an image or tileset, and the frame it was last used in
+        struct RESIDENCY {
+            size_t bytes{ 0 };
+            uint64_t lastUsed{ 0 };
+            bool resident{ true };
+            // an evicted texture is being decoded again on the loader threads
+            bool restoring{ false };
+        };
+        struct IMAGE {
+            TILEIMAGE image;
+            std::string filename;
+            RESIDENCY residency;
+        };
+        struct TILESET {
+            std::vector<TILEIMAGE> tiles;
+            // atlas textures the tiles are drawn from, usually one
+            std::vector<SDL_Texture*> pages;
+            RESIDENCY residency;
+        };
+        std::map<std::string, IMAGE> images_;
+        std::map<int, TILESET> tilesets_;
+        size_t textureBudget_{ 0 };
+        size_t textureBytes_{ 0 };
+        // counts getEvents() calls, textures used in the current frame are not evicted
+        uint64_t frame_{ 1 };
+        RENDERSTATS renderStats_;
+        RENDERSTATS lastRenderStats_;
+        SDL_Texture* lastDrawnTexture_{ nullptr };
+        bool countDraws_{ true };
+        uint64_t textureHits_{ 0 };
+        uint64_t textureMisses_{ 0 };
+        uint64_t textureEvictions_{ 0 };
+        // largest texture the renderer supports, tilesets are packed into pages no bigger than this
+        int maxTextureSize_{ 4096 };
+        // tilesets are packed in chunks of this many tiles, smaller tilesets are packed on the calling thread
+        static constexpr int MinTilesPerPackThread = 256;
         std::map<int, AUDIOINFO> audioClips_;
         std::map<int, MUSICINFO> musicClips_;
 
+        // where each tileset came from so it can be reloaded
+        struct TILESETSOURCE {
+            int w{ 0 };
+            int h{ 0 };
+            std::string filename;
+        };
+        std::map<int, TILESETSOURCE> tilesetSources_;
+
+        // a file to decode on a loader thread, and the decoded result
+        struct LOADJOB {
+            enum { IMAGE, TILESET, AUDIO, MUSIC } type{ IMAGE };
+            int id{ 0 };
+            std::string filename;
+            int w{ 0 };
+            int h{ 0 };
+            // hot reloads only replace assets that are still loaded
+            bool reload{ false };
+            SDL_Surface* surface{ nullptr };
+            std::vector<SDL_Surface*> pages;
+            Mix_Chunk* chunk{ nullptr };
+            Mix_Music* music{ nullptr };
+            std::promise<bool> done;
+            // measures load latency for the "asset load ms" stat
+            std::chrono::steady_clock::time_point queued;
+            void free();
+        };
+        using LoadJobPtr = std::shared_ptr<LOADJOB>;
+
+        mutable std::unique_ptr<ThreadPool> loaderPool_;
+        mutable std::mutex loaderPoolMutex_;
+        mutable std::mutex loadMutex_;
+        mutable std::mutex audioDecodeMutex_;
+        std::condition_variable loadCv_;
+        std::vector<LoadJobPtr> loadResults_;
+        std::atomic<int> loadsQueued_{ 0 };
+        std::atomic<int> loadsFinished_{ 0 };
+        std::atomic<int> loadsFailed_{ 0 };
+
+        std::unique_ptr<AssetWatcher> watcher_;
+        std::multimap<std::string, std::function<void(const std::string&)>> fileWatches_;
+
+        std::shared_future<bool> _queueLoad(LoadJobPtr job);
+        // returns the loader pool, starting it on first use
+        ThreadPool& _loaderPool() const;
+        void _decode(LOADJOB& job) const;
+        // decodes filename, packed into atlas pages of w x h tiles if w and h are not 0, using the texture
+        // cache if enabled. The caller frees the returned surfaces
+        std::vector<SDL_Surface*> _decodeImage(const std::string& filename, int w, int h) const;
+        bool _install(LOADJOB& job);
+        void _queueReloads(const std::string& path);
+        // adds the files under a new search path to the index
+        void _indexSearchPath(const std::string& dir);
+        // adds the files under dir to index, keeping names that are already there
+        static void _scanSearchPath(const std::string& dir, SearchIndex& index);
+        // updates the index entry of a file the watcher reported, returns false if it was removed
+        bool _updateSearchIndex(const std::string& path);
+
         bool _init();
         bool _initSubsystems();
         bool _initScreen(int width, int height, int windowFlags);
@@ -204,7 +479,25 @@ namespace GameLib {
         void _setError(std::string&& errorString);
 
         std::vector<TILEIMAGE>& _initTileset(int i);
-        int _addTile(int tilesetId, SDL_Surface* surface);
+        SDL_Texture* _setImage(const std::string& name, const std::string& filename, SDL_Surface* surface);
+        void _useTexture(RESIDENCY& residency) {
+            residency.lastUsed = frame_;
+            if (residency.resident)
+                textureHits_++;
+        }
+        void _restoreImage(IMAGE& image);
+        void _restoreTileset(int tilesetId, TILESET& tileset);
+        // lets an evicted texture whose restore failed be restored again
+        void _restoreFailed(const LOADJOB& job);
+        void _evictTextures();
+        // returns a translucent grey w x h texture drawn in place of textures that are being restored
+        SDL_Texture* _placeholder(int w, int h);
+        std::map<std::pair<int, int>, SDL_Texture*> placeholders_;
+        // uploads atlas pages from _packTileset() and fills the tileset with their w x h tiles
+        int _setTileset(int tilesetId, int w, int h, const std::vector<SDL_Surface*>& pages);
+        // copies the w x h tiles of sheet into as few RGBA32 atlas pages as the maximum texture size allows
+        // sheet is freed or returned as the only page, the caller frees the returned surfaces
+        std::vector<SDL_Surface*> _packTileset(SDL_Surface* sheet, int w, int h) const;
     };
 }
 
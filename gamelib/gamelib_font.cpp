@@ -6,6 +6,7 @@ namespace GameLib {
 
 
 	Font::~Font() {
+		_freeGlyphCaches();
 		if (font_) {
 			TTF_CloseFont(font_);
 			font_ = nullptr;
@@ -14,8 +15,11 @@ namespace GameLib {
 
 
 	bool Font::load(const std::string& filename, int ptsize) {
-		std::string path = context_->findSearchPath(filename);
-		font_ = TTF_OpenFont(path.c_str(), ptsize);
+		SDL_RWops* rw = context_->openAsset(filename);
+		if (!rw)
+			return false;
+		_freeGlyphCaches();
+		font_ = TTF_OpenFontRW(rw, 1, ptsize);
 		return font_ != nullptr;
 	}
 
@@ -38,6 +42,7 @@ namespace GameLib {
 		rect_.x = x;
 		rect_.y = y;
 		SDL_Renderer* renderer_ = context_->renderer();
+		context_->countDraw(texture_);
 		SDL_RenderCopy(renderer_, texture_, nullptr, &rect_);
 	}
 
@@ -74,6 +79,7 @@ namespace GameLib {
 	void Font::draw(int x, int y, const char* text, SDL_Color fg, int flags) { draw(x, y, text, fg, Black, flags); }
 
 	void Font::draw(int x, int y, const char* text, SDL_Color fg, SDL_Color bg, int flags) {
+		HFPROFILE("Font::draw");
 		if (!font_)
 			return;
 
@@ -105,4 +111,118 @@ namespace GameLib {
 		render(text, fg);
 		draw(x, y);
 	}
+
+
+	void Font::drawCached(int x, int y, const char* text, SDL_Color fg, int flags) { drawCached(x, y, text, fg, Black, flags); }
+
+	void Font::drawCached(int x, int y, const char* text, SDL_Color fg, SDL_Color bg, int flags) {
+		GLYPHCACHE* cache = _glyphCache(flags);
+		if (!cache)
+			return;
+
+		if ((flags & HALIGN_CENTER) == HALIGN_CENTER) {
+			x -= calcCachedWidth(text, flags) >> 1;
+		} else if ((flags & HALIGN_RIGHT) == HALIGN_RIGHT) {
+			x -= calcCachedWidth(text, flags);
+		}
+
+		if ((flags & VALIGN_CENTER) == VALIGN_CENTER) {
+			y -= calcHeight() >> 1;
+		} else if ((flags & VALIGN_BOTTOM) == VALIGN_BOTTOM) {
+			y -= calcHeight();
+		}
+
+		if (flags & SHADOWED)
+			_drawCached(x + 2, y + 2, text, bg, *cache);
+		_drawCached(x, y, text, fg, *cache);
+	}
+
+
+	int Font::calcCachedWidth(const char* text, int flags) {
+		GLYPHCACHE* cache = _glyphCache(flags);
+		if (!cache)
+			return 0;
+		int w{ 0 };
+		for (const char* c = text; *c; c++) {
+			if (*c >= FirstGlyph && *c <= LastGlyph)
+				w += cache->glyphs[*c - FirstGlyph].advance;
+		}
+		return w;
+	}
+
+
+	Font::GLYPHCACHE* Font::_glyphCache(int flags) {
+		if (!font_)
+			return nullptr;
+		int style = ((flags & BOLD) ? 1 : 0) | ((flags & ITALIC) ? 2 : 0);
+		GLYPHCACHE& cache = glyphCaches_[style];
+		if (cache.texture)
+			return &cache;
+
+		TTF_SetFontStyle(font_, ((style & 1) ? TTF_STYLE_BOLD : 0) | ((style & 2) ? TTF_STYLE_ITALIC : 0));
+		SDL_Surface* surfaces[LastGlyph - FirstGlyph + 1]{};
+		int w{ 0 };
+		int h{ 0 };
+		for (int ch = FirstGlyph; ch <= LastGlyph; ch++) {
+			GLYPH& glyph = cache.glyphs[ch - FirstGlyph];
+			SDL_Surface* surface = TTF_RenderGlyph_Blended(font_, (Uint16)ch, White);
+			if (!surface)
+				continue;
+			surfaces[ch - FirstGlyph] = surface;
+			if (TTF_GlyphMetrics(font_, (Uint16)ch, nullptr, nullptr, nullptr, nullptr, &glyph.advance) < 0)
+				glyph.advance = surface->w;
+			glyph.rect = { w, 0, surface->w, surface->h };
+			// a pixel between glyphs keeps filtering from bleeding into neighbours
+			w += surface->w + 1;
+			h = std::max(h, surface->h);
+		}
+
+		SDL_Surface* atlas = w > 0 ? SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888) : nullptr;
+		for (int i = 0; i <= LastGlyph - FirstGlyph; i++) {
+			if (!surfaces[i])
+				continue;
+			if (atlas) {
+				SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+				SDL_BlitSurface(surfaces[i], nullptr, atlas, &cache.glyphs[i].rect);
+			}
+			SDL_FreeSurface(surfaces[i]);
+		}
+		if (!atlas) {
+			HFLOGERROR("glyphs could not be rendered");
+			return nullptr;
+		}
+		cache.texture = SDL_CreateTextureFromSurface(context_->renderer(), atlas);
+		SDL_FreeSurface(atlas);
+		if (!cache.texture)
+			return nullptr;
+		SDL_SetTextureBlendMode(cache.texture, SDL_BLENDMODE_BLEND);
+		return &cache;
+	}
+
+
+	void Font::_drawCached(int x, int y, const char* text, SDL_Color color, GLYPHCACHE& cache) {
+		SDL_Renderer* renderer = context_->renderer();
+		SDL_SetTextureColorMod(cache.texture, color.r, color.g, color.b);
+		SDL_SetTextureAlphaMod(cache.texture, color.a);
+		for (const char* c = text; *c; c++) {
+			if (*c < FirstGlyph || *c > LastGlyph)
+				continue;
+			const GLYPH& glyph = cache.glyphs[*c - FirstGlyph];
+			if (glyph.rect.w > 0) {
+				SDL_Rect dstrect{ x, y, glyph.rect.w, glyph.rect.h };
+				context_->countDraw(cache.texture);
+				SDL_RenderCopy(renderer, cache.texture, &glyph.rect, &dstrect);
+			}
+			x += glyph.advance;
+		}
+	}
+
+
+	void Font::_freeGlyphCaches() {
+		for (auto& cache : glyphCaches_) {
+			if (cache.texture)
+				SDL_DestroyTexture(cache.texture);
+			cache = GLYPHCACHE();
+		}
+	}
 } // namespace GameLib
@@ -52,7 +52,32 @@ namespace GameLib {
 		void draw(int x, int y, const char* text, SDL_Color fg, int flags);
 		void draw(int x, int y, const char* text, SDL_Color fg, SDL_Color bg, int flags);
 
+		// draws text from a texture of printable ASCII glyphs rendered on first use, so changing text costs
+		// no TTF rendering or texture uploads. Other characters are skipped and kerning is ignored
+		void drawCached(int x, int y, const char* text, SDL_Color fg, int flags);
+		void drawCached(int x, int y, const char* text, SDL_Color fg, SDL_Color bg, int flags);
+
+		// calculates the width of text drawn by drawCached()
+		int calcCachedWidth(const char* text, int flags = 0);
+
 	private:
+		static constexpr int FirstGlyph = 32;
+		static constexpr int LastGlyph = 126;
+		struct GLYPH {
+			SDL_Rect rect{ 0, 0, 0, 0 };
+			int advance{ 0 };
+		};
+		// one texture of glyphs for each combination of BOLD and ITALIC
+		struct GLYPHCACHE {
+			SDL_Texture* texture{ nullptr };
+			GLYPH glyphs[LastGlyph - FirstGlyph + 1];
+		};
+		GLYPHCACHE glyphCaches_[4];
+
+		GLYPHCACHE* _glyphCache(int flags);
+		void _drawCached(int x, int y, const char* text, SDL_Color color, GLYPHCACHE& cache);
+		void _freeGlyphCaches();
+
 		Context* context_{ nullptr };
 		TTF_Font* font_{ nullptr };
 		SDL_Texture* texture_{ nullptr };
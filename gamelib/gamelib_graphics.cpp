@@ -23,7 +23,10 @@ namespace GameLib {
 		glm::ivec2 p = transform({ x, y });
 		if (clip(p))
 			return;
-		context->drawTexture(p, { tileImage->w, tileImage->h }, tileImage->texture);
+		SDL_Rect srcrect{ tileImage->x, tileImage->y, tileImage->w, tileImage->h };
+		SDL_Rect dstrect{ p.x, p.y, tileImage->w, tileImage->h };
+		context->countDraw(tileImage->texture);
+		SDL_RenderCopy(context->renderer(), tileImage->texture, &srcrect, &dstrect);
 	}
 
 	void Graphics::draw(int tileSetId, int tileId, int x, int y, int flipFlags) {
@@ -44,6 +47,7 @@ namespace GameLib {
 			return;
 		SDL_Rect rect{ p.x, p.y, w, h };
 		SDL_SetRenderDrawColor(context->renderer(), color.r, color.g, color.b, SDL_ALPHA_OPAQUE);
+		context->countDraw(nullptr);
 		SDL_RenderFillRect(context->renderer(), &rect);
 	}
 
@@ -53,6 +57,7 @@ namespace GameLib {
 		int hy = size.y >> 1;
 		SDL_Rect rect{ p.x - hx, p.y - hy, size.x, size.y };
 		SDL_SetRenderDrawColor(context->renderer(), color.r, color.g, color.b, SDL_ALPHA_OPAQUE);
+		context->countDraw(nullptr);
 		SDL_RenderFillRect(context->renderer(), &rect);
 	}
 
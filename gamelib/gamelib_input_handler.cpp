@@ -5,58 +5,94 @@
 #define CHECKPOINTER(button)                                                                                                                                   \
     if (!button)                                                                                                                                               \
         button = &nullCommand;
-#define CHECKSCANCODE(x, command)                                                                                                                              \
-    if (context->keyboard.scancodes[SDL_SCANCODE_##x]) {                                                                                                       \
-        command;                                                                                                                                               \
-    }
-#define HANDLESCANCODE(x, command, value)                                                                                                                      \
-    if (command && context->keyboard.scancodes[SDL_SCANCODE_##x]) {                                                                                            \
-        bool result = command->execute(value);                                                                                                                 \
-        if (result)                                                                                                                                            \
-            context->keyboard.scancodes[SDL_SCANCODE_##x] = 0;                                                                                                 \
-    }
 
 namespace GameLib {
-    void InputHandler::handle() {
+    namespace {
+        struct BUTTONKEY {
+            uint32_t button;
+            SDL_Scancode scancode;
+            InputCommand* InputHandler::*command;
+        };
+
+        // in the order their commands execute
+        const BUTTONKEY ButtonKeys[] = {
+            { InputHandler::BUTTON_DPADPOSY, SDL_SCANCODE_W, &InputHandler::dpadPosY },
+            { InputHandler::BUTTON_DPADNEGY, SDL_SCANCODE_S, &InputHandler::dpadNegY },
+            { InputHandler::BUTTON_DPADNEGX, SDL_SCANCODE_A, &InputHandler::dpadNegX },
+            { InputHandler::BUTTON_DPADPOSX, SDL_SCANCODE_D, &InputHandler::dpadPosX },
+            { InputHandler::BUTTON_BACK, SDL_SCANCODE_ESCAPE, &InputHandler::back },
+            { InputHandler::BUTTON_START, SDL_SCANCODE_RETURN, &InputHandler::start },
+            { InputHandler::BUTTON_A, SDL_SCANCODE_SPACE, &InputHandler::buttonA },
+        };
+
+        const BUTTONKEY NumberKeys[] = {
+            { InputHandler::BUTTON_KEY1 << 0, SDL_SCANCODE_1, &InputHandler::key1 },
+            { InputHandler::BUTTON_KEY1 << 1, SDL_SCANCODE_2, &InputHandler::key2 },
+            { InputHandler::BUTTON_KEY1 << 2, SDL_SCANCODE_3, &InputHandler::key3 },
+            { InputHandler::BUTTON_KEY1 << 3, SDL_SCANCODE_4, &InputHandler::key4 },
+            { InputHandler::BUTTON_KEY1 << 4, SDL_SCANCODE_5, &InputHandler::key5 },
+            { InputHandler::BUTTON_KEY1 << 5, SDL_SCANCODE_6, &InputHandler::key6 },
+            { InputHandler::BUTTON_KEY1 << 6, SDL_SCANCODE_7, &InputHandler::key7 },
+            { InputHandler::BUTTON_KEY1 << 7, SDL_SCANCODE_8, &InputHandler::key8 },
+            { InputHandler::BUTTON_KEY1 << 8, SDL_SCANCODE_9, &InputHandler::key9 },
+            { InputHandler::BUTTON_KEY1 << 9, SDL_SCANCODE_0, &InputHandler::key0 },
+        };
+
+        // a command returning true is one time, so its key is cleared until pressed again
+        template <size_t N>
+        void executeButtons(InputHandler& handler, Context* context, const BUTTONKEY (&keys)[N], uint32_t buttons) {
+            for (auto& key : keys) {
+                if (!(buttons & key.button))
+                    continue;
+                if ((handler.*key.command)->execute(1.0f))
+                    context->keyboard.scancodes[key.scancode] = 0;
+            }
+        }
+    }
+
+    void InputHandler::handle() { handle(_readState(Locator::getContext())); }
+
+    void InputHandler::handle(const INPUTSTATE& state) {
         Context* context = Locator::getContext();
         _checkPointers();
-        const float ONE = 1.0f;
-        HANDLESCANCODE(W, dpadPosY, ONE);
-        HANDLESCANCODE(S, dpadNegY, ONE);
-        HANDLESCANCODE(A, dpadNegX, ONE);
-        HANDLESCANCODE(D, dpadPosX, ONE);
-        HANDLESCANCODE(ESCAPE, back, ONE);
-        HANDLESCANCODE(RETURN, start, ONE);
-        HANDLESCANCODE(SPACE, buttonA, ONE);
-        glm::vec3 axis1{ 0.0f, 0.0f, 0.0f };
-        CHECKSCANCODE(LEFT, axis1.x -= 1);
-        CHECKSCANCODE(RIGHT, axis1.x += 1);
-        CHECKSCANCODE(UP, axis1.y -= 1);
-        CHECKSCANCODE(DOWN, axis1.y += 1);
+        state_ = state;
+        executeButtons(*this, context, ButtonKeys, state.buttons);
+        axis1X->execute(state.axis1.x);
+        axis1Y->execute(state.axis1.y);
+        executeButtons(*this, context, NumberKeys, state.buttons);
+    }
+
+    InputHandler::INPUTSTATE InputHandler::_readState(Context* context) {
+        INPUTSTATE state;
+        for (auto& key : ButtonKeys) {
+            if (context->keyboard.scancodes[key.scancode])
+                state.buttons |= key.button;
+        }
+        for (auto& key : NumberKeys) {
+            if (context->keyboard.scancodes[key.scancode])
+                state.buttons |= key.button;
+        }
+
+        if (context->keyboard.scancodes[SDL_SCANCODE_LEFT])
+            state.axis1.x -= 1;
+        if (context->keyboard.scancodes[SDL_SCANCODE_RIGHT])
+            state.axis1.x += 1;
+        if (context->keyboard.scancodes[SDL_SCANCODE_UP])
+            state.axis1.y -= 1;
+        if (context->keyboard.scancodes[SDL_SCANCODE_DOWN])
+            state.axis1.y += 1;
 
         for (int i = 0; i < context->MaxGameControllers; i++) {
 			// use first working controller
             if (context->gameControllers[i].enabled) {
-                axis1.x += context->gameControllers[0].axis1.x;
-                axis1.y += context->gameControllers[0].axis1.y;
+                state.axis1.x += context->gameControllers[0].axis1.x;
+                state.axis1.y += context->gameControllers[0].axis1.y;
                 // axis2.x += context->gameControllers[0].axis2.x;
                 // axis2.y += context->gameControllers[0].axis2.y;
                 break;
             }
         }
-        axis1X->execute(axis1.x);
-        axis1Y->execute(axis1.y);
-
-        HANDLESCANCODE(1, key1, ONE);
-        HANDLESCANCODE(2, key2, ONE);
-        HANDLESCANCODE(3, key3, ONE);
-        HANDLESCANCODE(4, key4, ONE);
-        HANDLESCANCODE(5, key5, ONE);
-        HANDLESCANCODE(6, key6, ONE);
-        HANDLESCANCODE(7, key7, ONE);
-        HANDLESCANCODE(8, key8, ONE);
-        HANDLESCANCODE(9, key9, ONE);
-        HANDLESCANCODE(0, key0, ONE);
+        return state;
     }
 
     void InputHandler::_checkPointers() {
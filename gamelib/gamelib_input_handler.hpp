@@ -4,9 +4,38 @@
 #include <gamelib_command.hpp>
 
 namespace GameLib {
+    class Context;
+
     class InputHandler {
     public:
+        // the buttons and axis handle() reads in one frame, this is what InputRecorder saves
+        struct INPUTSTATE {
+            // a bit for each button down, see the BUTTON constants
+            uint32_t buttons{ 0 };
+            glm::vec2 axis1{ 0.0f, 0.0f };
+
+            bool operator==(const INPUTSTATE& other) const { return buttons == other.buttons && axis1 == other.axis1; }
+            bool operator!=(const INPUTSTATE& other) const { return !(*this == other); }
+        };
+
+        static constexpr uint32_t BUTTON_DPADPOSY = 1 << 0;
+        static constexpr uint32_t BUTTON_DPADNEGY = 1 << 1;
+        static constexpr uint32_t BUTTON_DPADNEGX = 1 << 2;
+        static constexpr uint32_t BUTTON_DPADPOSX = 1 << 3;
+        static constexpr uint32_t BUTTON_BACK = 1 << 4;
+        static constexpr uint32_t BUTTON_START = 1 << 5;
+        static constexpr uint32_t BUTTON_A = 1 << 6;
+        // key1 to key9 and then key0
+        static constexpr uint32_t BUTTON_KEY1 = 1 << 7;
+        // bits from here up are not handled, a game can record its own events in them
+        static constexpr uint32_t BUTTON_USER = 1 << 24;
+
+        // reads the keyboard and game controllers and executes the commands
         void handle();
+        // executes the commands for a state, e.g. one played back by InputPlayer
+        void handle(const INPUTSTATE& state);
+        // returns the state handled last
+        const INPUTSTATE& state() const { return state_; }
 
         InputCommand* axis1X{ nullptr };
         InputCommand* axis1Y{ nullptr };
@@ -44,6 +73,11 @@ namespace GameLib {
         InputCommand nullCommand;
 
         void _checkPointers();
+
+    private:
+        INPUTSTATE state_;
+
+        INPUTSTATE _readState(Context* context);
     };
 }
 
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include <gamelib_input_recorder.hpp>
+#include <cstring>
+
+namespace GameLib {
+    namespace {
+        const char Magic[4]{ 'G', 'L', 'I', 'R' };
+        constexpr uint32_t Version = 1;
+        constexpr size_t HeaderSize = sizeof(Magic) + 2 * sizeof(uint32_t);
+
+        // flags leading each frame
+        constexpr uint8_t FRAME_BUTTONS = 0x01;
+        constexpr uint8_t FRAME_AXIS1 = 0x02;
+
+        // values are stored in host byte order, which is little endian on every platform gamelib builds for
+        template <typename T>
+        void put(std::ofstream& fout, T value) {
+            fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void putVarint(std::ofstream& fout, uint32_t value) {
+            while (value >= 0x80) {
+                put<uint8_t>(fout, (uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            put<uint8_t>(fout, (uint8_t)value);
+        }
+    }
+
+    bool InputRecorder::open(const std::string& path, uint32_t seed) {
+        close();
+        fout_.open(path, std::ios::binary);
+        if (!fout_) {
+            HFLOGERROR("could not record input to '%s'", path.c_str());
+            return false;
+        }
+        fout_.write(Magic, sizeof(Magic));
+        put(fout_, Version);
+        put(fout_, seed);
+        last_ = InputHandler::INPUTSTATE();
+        frames_ = 0;
+        return true;
+    }
+
+    void InputRecorder::close() {
+        if (!fout_.is_open())
+            return;
+        fout_.close();
+        HFLOGINFO("recorded %llu frames of input", (unsigned long long)frames_);
+    }
+
+    void InputRecorder::write(const INPUTFRAME& frame) {
+        if (!fout_.is_open())
+            return;
+        uint8_t flags = 0;
+        if (frame.state.buttons != last_.buttons)
+            flags |= FRAME_BUTTONS;
+        if (frame.state.axis1 != last_.axis1)
+            flags |= FRAME_AXIS1;
+        put(fout_, flags);
+        putVarint(fout_, frame.ticks);
+        put(fout_, frame.time);
+        put(fout_, frame.dt);
+        if (flags & FRAME_BUTTONS)
+            put(fout_, frame.state.buttons);
+        if (flags & FRAME_AXIS1) {
+            put(fout_, frame.state.axis1.x);
+            put(fout_, frame.state.axis1.y);
+        }
+        last_ = frame.state;
+        frames_++;
+    }
+
+    bool InputPlayer::open(const std::string& path) {
+        data_.clear();
+        std::ifstream fin(path, std::ios::binary);
+        if (!fin) {
+            HFLOGERROR("could not open input recording '%s'", path.c_str());
+            return false;
+        }
+        data_.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+        uint32_t version = 0;
+        if (data_.size() >= HeaderSize) {
+            memcpy(&version, &data_[sizeof(Magic)], sizeof(version));
+            memcpy(&seed_, &data_[sizeof(Magic) + sizeof(version)], sizeof(seed_));
+        }
+        if (data_.size() < HeaderSize || memcmp(data_.data(), Magic, sizeof(Magic)) != 0 || version != Version) {
+            HFLOGERROR("'%s' is not an input recording", path.c_str());
+            data_.clear();
+            return false;
+        }
+        rewind();
+        return true;
+    }
+
+    void InputPlayer::rewind() {
+        pos_ = HeaderSize;
+        last_ = InputHandler::INPUTSTATE();
+    }
+
+    bool InputPlayer::next(INPUTFRAME& frame) {
+        auto get = [&](void* value, size_t size) {
+            if (pos_ + size > data_.size())
+                return false;
+            memcpy(value, &data_[pos_], size);
+            pos_ += size;
+            return true;
+        };
+
+        uint8_t flags;
+        if (!get(&flags, sizeof(flags)))
+            return false;
+        frame.ticks = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte;
+            if (shift > 28 || !get(&byte, sizeof(byte)))
+                return false;
+            frame.ticks |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        if (!get(&frame.time, sizeof(frame.time)) || !get(&frame.dt, sizeof(frame.dt)))
+            return false;
+        if ((flags & FRAME_BUTTONS) && !get(&last_.buttons, sizeof(last_.buttons)))
+            return false;
+        if ((flags & FRAME_AXIS1) && (!get(&last_.axis1.x, sizeof(float)) || !get(&last_.axis1.y, sizeof(float))))
+            return false;
+        frame.state = last_;
+        return true;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GAMELIB_INPUT_RECORDER_HPP
+#define GAMELIB_INPUT_RECORDER_HPP
+
+#include <gamelib_input_handler.hpp>
+
+namespace GameLib {
+    // one frame of a recording: the input handled and the fixed ticks that ran on it
+    struct INPUTFRAME {
+        InputHandler::INPUTSTATE state;
+        // world updates run in the frame
+        uint32_t ticks{ 0 };
+        // game time and frame time in seconds, as set in Context::currentTime_s and deltaTime
+        float time{ 0.0f };
+        float dt{ 0.0f };
+    };
+
+    // InputRecorder writes a session's input and random seed to a compact binary stream. Each frame
+    // stores its tick count and times, and the buttons and axis only when they change. Replaying it
+    // with InputPlayer after seeding GameLib::random the same way repeats the session exactly
+    class InputRecorder {
+    public:
+        ~InputRecorder() { close(); }
+
+        bool open(const std::string& path, uint32_t seed);
+        void close();
+        bool isOpen() const { return fout_.is_open(); }
+
+        void write(const INPUTFRAME& frame);
+
+        uint64_t frames() const { return frames_; }
+
+    private:
+        std::ofstream fout_;
+        InputHandler::INPUTSTATE last_;
+        uint64_t frames_{ 0 };
+    };
+
+    // InputPlayer reads a stream written by InputRecorder
+    class InputPlayer {
+    public:
+        bool open(const std::string& path);
+        bool isOpen() const { return !data_.empty(); }
+
+        // the seed the session was recorded with
+        uint32_t seed() const { return seed_; }
+
+        // returns false at the end of the stream
+        bool next(INPUTFRAME& frame);
+        // starts again from the first frame
+        void rewind();
+
+    private:
+        std::vector<uint8_t> data_;
+        size_t pos_{ 0 };
+        uint32_t seed_{ 0 };
+        InputHandler::INPUTSTATE last_;
+    };
+}
+
+#endif
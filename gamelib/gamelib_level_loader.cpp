@@ -0,0 +1,100 @@
+#include "pch.h"
+#include <gamelib_level_loader.hpp>
+
+namespace GameLib {
+	LevelLoader::~LevelLoader() { cancel(); }
+
+	void LevelLoader::addTileset(int tilesetId, int w, int h, const std::string& filename) {
+		assets_.push_back(context_->loadTilesetAsync(tilesetId, w, h, filename));
+	}
+
+	void LevelLoader::addAudioClip(int clipId, const std::string& filename) {
+		assets_.push_back(context_->loadAudioClipAsync(clipId, filename));
+	}
+
+	void LevelLoader::addMusicClip(int musicId, const std::string& filename) {
+		assets_.push_back(context_->loadMusicClipAsync(musicId, filename));
+	}
+
+	void LevelLoader::start(const std::string& worldFilename) {
+		if (thread_.joinable())
+			thread_.join();
+		filename_ = worldFilename;
+		loaded_ = false;
+		result_ = false;
+		next_ = std::make_unique<World>();
+		next_->deferPhysics(true);
+		boxes_.clear();
+		thread_ = std::thread(&LevelLoader::_run, this);
+	}
+
+	bool LevelLoader::ready() const {
+		if (!loaded_)
+			return false;
+		for (auto& asset : assets_) {
+			if (asset.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return false;
+		}
+		return true;
+	}
+
+	float LevelLoader::progress() const {
+		int finished = loaded_ ? 1 : 0;
+		for (auto& asset : assets_) {
+			if (asset.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				finished++;
+		}
+		return (float)finished / (float)(assets_.size() + 1);
+	}
+
+	bool LevelLoader::swap(World& world) {
+		if (!thread_.joinable())
+			return false;
+		Hf::StopWatch stopwatch;
+		// textures can only be installed by the main thread, so wait here rather than on the futures
+		if (!ready())
+			context_->waitForLoads();
+		thread_.join();
+		assets_.clear();
+		if (!result_) {
+			next_.reset();
+			return false;
+		}
+		world.adoptTiles(*next_, boxes_);
+		next_.reset();
+		boxes_.clear();
+		HFLOGINFO("swapped in level '%s' in %.1f ms", filename_.c_str(), stopwatch.stop_msf());
+		return true;
+	}
+
+	void LevelLoader::cancel() {
+		if (thread_.joinable())
+			thread_.join();
+		next_.reset();
+		boxes_.clear();
+		assets_.clear();
+	}
+
+	void LevelLoader::_run() {
+		Hf::Profiler.setThreadName("LevelLoader");
+		HFPROFILE("LevelLoader::load");
+		Hf::StopWatch stopwatch;
+		std::string_view archived = context_->findArchived(filename_);
+		if (archived.data()) {
+			next_->readText(archived);
+			result_ = true;
+		} else {
+			std::string path = context_->findSearchPath(filename_);
+			bool binary = path.size() > 4 && path.compare(path.size() - 4, 4, ".gwb") == 0;
+			result_ = !path.empty() && (binary ? next_->loadBinary(path) : next_->load(path));
+		}
+
+		if (result_) {
+			boxes_ = next_->solidBoxes();
+			HFLOGINFO("loaded level '%s' (%d boxes) in %.1f ms", filename_.c_str(), (int)boxes_.size(), stopwatch.stop_msf());
+		} else {
+			HFLOGERROR("level '%s' could not be loaded", filename_.c_str());
+		}
+		loaded_ = true;
+	}
+} // namespace GameLib
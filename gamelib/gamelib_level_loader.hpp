@@ -0,0 +1,63 @@
+#ifndef GAMELIB_LEVEL_LOADER_HPP
+#define GAMELIB_LEVEL_LOADER_HPP
+
+#include <gamelib_context.hpp>
+#include <gamelib_world.hpp>
+#include <atomic>
+#include <future>
+
+namespace GameLib {
+	// LevelLoader prepares the next level while the current screen keeps running, e.g. during a
+	// StoryScreen or DialogueScreen. The world file is parsed and its solid tiles are merged into
+	// boxes on a background thread, and tilesets and audio go through the Context loader threads.
+	// Their textures are installed by Context::getEvents(), which the story screens call every frame.
+	// swap() then moves the level into the live world in one step on the main thread, where the Box2D
+	// bodies are created because the Box2D world is not thread safe.
+	// The level is parsed into a World of its own with its own DEFINE and FLAGS tables, so the live
+	// world can be drawn and updated meanwhile. Reload worlds through start() and swap() as well so
+	// no world file is parsed on the main thread.
+	class LevelLoader {
+	public:
+		LevelLoader(Context* context) : context_(context) {}
+		~LevelLoader();
+
+		// these queue a level asset on the Context loader threads
+		void addTileset(int tilesetId, int w, int h, const std::string& filename);
+		void addAudioClip(int clipId, const std::string& filename);
+		void addMusicClip(int musicId, const std::string& filename);
+
+		// starts loading a text, binary (.gwb), or archived world file on a background thread
+		// any level that was loaded but not swapped in is dropped
+		void start(const std::string& worldFilename);
+
+		// returns true if a level was started and has not been swapped in yet
+		bool pending() const { return thread_.joinable(); }
+
+		// returns true when the world and every asset is loaded so swap() will not block
+		bool ready() const;
+
+		// returns the fraction of the world and assets loaded so far, e.g. for a loading bar
+		float progress() const;
+
+		// waits for the level to finish loading and swaps its tiles and bodies into world
+		// returns false if no level was started or the world file could not be loaded
+		bool swap(World& world);
+
+		// waits for the background thread and drops the loaded level
+		void cancel();
+
+	private:
+		Context* context_{ nullptr };
+		std::string filename_;
+		std::thread thread_;
+		std::atomic<bool> loaded_{ false };
+		bool result_{ false };
+		std::unique_ptr<World> next_;
+		std::vector<SDL_Rect> boxes_;
+		std::vector<std::shared_future<bool>> assets_;
+
+		void _run();
+	};
+} // namespace GameLib
+
+#endif
@@ -0,0 +1,89 @@
+#include "pch.h"
+#include <gamelib_mapped_file.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GameLib {
+#ifdef _WIN32
+	bool MappedFile::open(const std::string& path) {
+		close();
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		file_ = file;
+		mapping_ = mapping;
+		data_ = static_cast<const char*>(data);
+		size_ = (size_t)size.QuadPart;
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (data_)
+			UnmapViewOfFile(data_);
+		if (mapping_)
+			CloseHandle(mapping_);
+		if (file_)
+			CloseHandle(file_);
+		data_ = nullptr;
+		mapping_ = nullptr;
+		file_ = nullptr;
+		size_ = 0;
+	}
+#else
+	bool MappedFile::open(const std::string& path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			::close(fd);
+			return false;
+		}
+		fd_ = fd;
+		data_ = static_cast<const char*>(data);
+		size_ = (size_t)st.st_size;
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (data_)
+			munmap(const_cast<char*>(data_), size_);
+		if (fd_ >= 0)
+			::close(fd_);
+		data_ = nullptr;
+		fd_ = -1;
+		size_ = 0;
+	}
+#endif
+} // namespace GameLib
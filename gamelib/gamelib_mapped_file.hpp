@@ -0,0 +1,52 @@
+#ifndef GAMELIB_MAPPED_FILE_HPP
+#define GAMELIB_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace GameLib {
+	// MappedFile maps a whole file read only into memory
+	class MappedFile {
+	public:
+		MappedFile() {}
+		MappedFile(const std::string& path) { open(path); }
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// maps the file at path, returns false if it could not be opened or is empty
+		bool open(const std::string& path);
+
+		// unmaps the file
+		void close();
+
+		operator bool() const { return data_ != nullptr; }
+
+		// returns a pointer to the first byte of the file
+		const char* data() const { return data_; }
+
+		// returns the size of the file in bytes
+		size_t size() const { return size_; }
+
+		// returns a pointer to a T at offset, or nullptr if count T's do not fit in the file
+		template <typename T>
+		const T* at(size_t offset, size_t count = 1) const {
+			if (!data_ || offset > size_ || count > (size_ - offset) / sizeof(T))
+				return nullptr;
+			return reinterpret_cast<const T*>(data_ + offset);
+		}
+
+	private:
+		const char* data_{ nullptr };
+		size_t size_{ 0 };
+#ifdef _WIN32
+		void* file_{ nullptr };
+		void* mapping_{ nullptr };
+#else
+		int fd_{ -1 };
+#endif
+	};
+} // namespace GameLib
+
+#endif
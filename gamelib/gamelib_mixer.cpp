@@ -0,0 +1,276 @@
+#include "pch.h"
+#include <gamelib_mixer.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAMELIB_MIXER_SSE2
+#endif
+
+namespace GameLib {
+	namespace {
+		// out[2i] += in[i] * gainL, out[2i+1] += in[i] * gainR
+		void mixMonoToStereo(float* out, const float* in, int count, float gainL, float gainR) {
+			int i = 0;
+#ifdef GAMELIB_MIXER_SSE2
+			__m128 gain = _mm_setr_ps(gainL, gainR, gainL, gainR);
+			for (; i + 4 <= count; i += 4) {
+				__m128 s = _mm_loadu_ps(in + i);
+				float* o = out + 2 * i;
+				_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(_mm_unpacklo_ps(s, s), gain)));
+				_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_mul_ps(_mm_unpackhi_ps(s, s), gain)));
+			}
+#endif
+			for (; i < count; i++) {
+				out[2 * i] += in[i] * gainL;
+				out[2 * i + 1] += in[i] * gainR;
+			}
+		}
+
+		// adds float samples to 16 bit samples with saturation
+		void addToS16(Sint16* out, const float* in, int count) {
+			int i = 0;
+#ifdef GAMELIB_MIXER_SSE2
+			__m128 scale = _mm_set1_ps(32767.0f);
+			for (; i + 8 <= count; i += 8) {
+				__m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+				__m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+				__m128i d = _mm_loadu_si128((const __m128i*)(out + i));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_adds_epi16(d, _mm_packs_epi32(a, b)));
+			}
+#endif
+			for (; i < count; i++) {
+				int v = out[i] + (int)std::lrint(in[i] * 32767.0f);
+				out[i] = (Sint16)clamp(v, -32768, 32767);
+			}
+		}
+	} // namespace
+
+	Mixer::Mixer() {
+		for (auto& busy : busy_)
+			busy = false;
+		block_.resize(BlockFrames * 2);
+	}
+
+	Mixer::~Mixer() { stop(); }
+
+	bool Mixer::start(Context* context, int bufferSamples) {
+		stop();
+		context_ = context;
+		if (!context_ || !context_->audioInitialized())
+			return false;
+		if (bufferSamples > 0 && !context_->setAudioBufferSize(bufferSamples))
+			return false;
+
+		Uint16 format;
+		int channels;
+		if (!Mix_QuerySpec(&frequency_, &format, &channels))
+			return false;
+		if (format != AUDIO_S16SYS || channels != 2) {
+			HFLOGERROR("the mixer needs 16 bit stereo output");
+			return false;
+		}
+		Mix_SetPostMix(&Mixer::_postMix, this);
+		running_ = true;
+		HFLOGINFO("mixer started at %dHz", frequency_);
+		return true;
+	}
+
+	void Mixer::stop() {
+		// SDL_mixer holds its lock while calling the post mix, so the callback is not running after this
+		if (running_)
+			Mix_SetPostMix(nullptr, nullptr);
+		running_ = false;
+		queueHead_ = 0;
+		queueTail_ = 0;
+		for (int i = 0; i < MaxVoices; i++) {
+			voices_[i] = VOICE();
+			busy_[i] = false;
+		}
+		retired_.clear();
+	}
+
+	bool Mixer::addClip(int clipId) {
+		AUDIOINFO* audio = context_ ? context_->getAudioClip(clipId) : nullptr;
+		if (!audio || !audio->chunk)
+			return false;
+		// Mix_LoadWAV converts clips to the 16 bit stereo device format
+		const Sint16* s = (const Sint16*)audio->chunk->abuf;
+		size_t frames = audio->chunk->alen / (2 * sizeof(Sint16));
+		std::vector<float> samples(frames);
+		for (size_t i = 0; i < frames; i++) {
+			samples[i] = (s[2 * i] + s[2 * i + 1]) * (0.5f / 32768.0f);
+		}
+		addClip(clipId, std::move(samples));
+		return true;
+	}
+
+	void Mixer::addClip(int clipId, std::vector<float> samples) {
+		auto& clip = clips_[clipId];
+		if (clip)
+			retired_.push_back(std::move(clip));
+		clip = std::make_unique<CLIP>();
+		clip->samples = std::move(samples);
+	}
+
+	int Mixer::play(int clipId, glm::vec2 position, float volume) {
+		auto it = clips_.find(clipId);
+		if (it == clips_.end())
+			return -1;
+		COMMAND command;
+		command.type = COMMAND::PLAY;
+		command.clip = it->second.get();
+		_gains(position, volume, command.gainL, command.gainR);
+		if (command.gainL <= 0.0f && command.gainR <= 0.0f) {
+			culled_++;
+			return -1;
+		}
+		for (int i = 0; i < MaxVoices; i++) {
+			if (busy_[i])
+				continue;
+			generation_[i] = (generation_[i] + 1) & 0xFFFFFF;
+			command.handle = (generation_[i] << 8) | i;
+			busy_[i] = true;
+			if (!_push(command)) {
+				busy_[i] = false;
+				break;
+			}
+			played_++;
+			return command.handle;
+		}
+		dropped_++;
+		return -1;
+	}
+
+	void Mixer::move(int voice, glm::vec2 position, float volume) {
+		if (voice < 0)
+			return;
+		COMMAND command;
+		command.type = COMMAND::MOVE;
+		command.handle = voice;
+		_gains(position, volume, command.gainL, command.gainR);
+		_push(command);
+	}
+
+	void Mixer::stopVoice(int voice) {
+		if (voice < 0)
+			return;
+		COMMAND command;
+		command.type = COMMAND::STOP;
+		command.handle = voice;
+		_push(command);
+	}
+
+	bool Mixer::playing(int voice) const {
+		if (voice < 0)
+			return false;
+		// a stale handle's slot may have been reused by a newer voice
+		int i = voice & 0xFF;
+		return busy_[i] && generation_[i] == (voice >> 8);
+	}
+
+	Mixer::MIXSTATS Mixer::stats() const {
+		MIXSTATS s;
+		for (auto& busy : busy_) {
+			if (busy)
+				s.playing++;
+		}
+		s.played = played_;
+		s.culled = culled_;
+		s.dropped = dropped_;
+		s.blocks = blocks_;
+		s.voiceFrames = voiceFrames_;
+		return s;
+	}
+
+	bool Mixer::_push(const COMMAND& command) {
+		uint32_t head = queueHead_.load(std::memory_order_relaxed);
+		if (head - queueTail_.load(std::memory_order_acquire) >= QueueSize)
+			return false;
+		queue_[head % QueueSize] = command;
+		queueHead_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void Mixer::_gains(glm::vec2 position, float volume, float& gainL, float& gainR) const {
+		glm::vec2 d = position - listener_;
+		float attenuation = 1.0f - glm::length(d) / maxDistance;
+		if (attenuation <= 0.0f) {
+			gainL = gainR = 0.0f;
+			return;
+		}
+		// constant power pan, both sides are at -3 dB in the center
+		float pan = clamp(d.x / panDistance, -1.0f, 1.0f);
+		float angle = (pan + 1.0f) * 0.25f * 3.14159265f;
+		gainL = std::cos(angle) * attenuation * volume;
+		gainR = std::sin(angle) * attenuation * volume;
+	}
+
+	void Mixer::_runCommands() {
+		uint32_t tail = queueTail_.load(std::memory_order_relaxed);
+		uint32_t head = queueHead_.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			const COMMAND& command = queue_[tail % QueueSize];
+			int index = command.handle & 0xFF;
+			if (index >= MaxVoices)
+				continue;
+			VOICE& voice = voices_[index];
+			switch (command.type) {
+			case COMMAND::PLAY:
+				voice.clip = command.clip;
+				voice.position = 0;
+				voice.handle = command.handle;
+				voice.gainL = command.gainL;
+				voice.gainR = command.gainR;
+				break;
+			case COMMAND::MOVE:
+				if (voice.handle == command.handle) {
+					voice.gainL = command.gainL;
+					voice.gainR = command.gainR;
+				}
+				break;
+			case COMMAND::STOP:
+				if (voice.handle == command.handle && voice.clip) {
+					voice.clip = nullptr;
+					busy_[index] = false;
+				}
+				break;
+			}
+		}
+		queueTail_.store(tail, std::memory_order_release);
+	}
+
+	void Mixer::mix(float* out, int frames) {
+		_runCommands();
+		std::fill(out, out + frames * 2, 0.0f);
+		uint64_t voiceFrames = 0;
+		for (int i = 0; i < MaxVoices; i++) {
+			VOICE& voice = voices_[i];
+			if (!voice.clip)
+				continue;
+			size_t length = voice.clip->samples.size();
+			int count = (int)std::min<size_t>(frames, length - voice.position);
+			mixMonoToStereo(out, voice.clip->samples.data() + voice.position, count, voice.gainL, voice.gainR);
+			voice.position += count;
+			voiceFrames += count;
+			if (voice.position >= length) {
+				voice.clip = nullptr;
+				busy_[i] = false;
+			}
+		}
+		blocks_.fetch_add(1, std::memory_order_relaxed);
+		voiceFrames_.fetch_add(voiceFrames, std::memory_order_relaxed);
+	}
+
+	void Mixer::_postMix(void* udata, Uint8* stream, int len) {
+		Mixer* mixer = (Mixer*)udata;
+		Sint16* out = (Sint16*)stream;
+		int frames = len / (int)(2 * sizeof(Sint16));
+		while (frames > 0) {
+			int count = std::min(frames, (int)BlockFrames);
+			mixer->mix(mixer->block_.data(), count);
+			addToS16(out, mixer->block_.data(), count * 2);
+			out += count * 2;
+			frames -= count;
+		}
+	}
+} // namespace GameLib
@@ -0,0 +1,130 @@
+#ifndef GAMELIB_MIXER_HPP
+#define GAMELIB_MIXER_HPP
+
+#include <gamelib_context.hpp>
+#include <array>
+#include <atomic>
+
+namespace GameLib {
+	// Mixer mixes float clips into the SDL_mixer output with a gain and pan for each voice taken from
+	// its position in the world. It is registered with Mix_SetPostMix, so SDL_mixer channels and music
+	// keep playing underneath it. Clips are converted to mono float once when they are added, and
+	// play, move and stop are queued to the audio thread without locks. Call these from the main thread
+	class Mixer {
+	public:
+		static constexpr int MaxVoices = 64;
+		static constexpr int QueueSize = 256;
+		// frames mixed at a time by the audio callback
+		static constexpr int BlockFrames = 512;
+
+		Mixer();
+		~Mixer();
+
+		// registers the mixer with SDL_mixer, a bufferSamples above 0 first reopens the audio device
+		// with that buffer size for lower latency. The device must be 16 bit stereo
+		bool start(Context* context, int bufferSamples = 0);
+
+		// unregisters the mixer, voices stop playing
+		void stop();
+
+		// returns true if the mixer is registered with SDL_mixer
+		bool running() const { return running_; }
+
+		// converts a loaded Context audio clip to mono float for the mixer
+		bool addClip(int clipId);
+
+		// adds mono float samples at the device frequency, e.g. for generated sounds
+		void addClip(int clipId, std::vector<float> samples);
+
+		// sets the position used for attenuation and pan, usually the camera center in world tiles
+		void setListener(glm::vec2 position) { listener_ = position; }
+
+		// voices are silent at this many tiles from the listener
+		float maxDistance{ 40.0f };
+
+		// voices this many tiles left or right of the listener are panned fully to one side
+		float panDistance{ 20.0f };
+
+		// plays a clip heard from position, returns a voice handle or -1 if it is out of range or
+		// every voice is busy
+		int play(int clipId, glm::vec2 position, float volume = 1.0f);
+
+		// updates the gain and pan of a playing voice, e.g. for a moving actor
+		void move(int voice, glm::vec2 position, float volume = 1.0f);
+
+		// stops a playing voice
+		void stopVoice(int voice);
+
+		// returns true until the voice finishes or is stopped
+		bool playing(int voice) const;
+
+		// mixes frames stereo frames of the playing voices into out, which is cleared first
+		// the audio callback calls this, it is public for tests and benchmarks
+		void mix(float* out, int frames);
+
+		struct MIXSTATS {
+			int playing{ 0 };		   // voices playing now
+			uint64_t played{ 0 };	   // voices started
+			uint64_t culled{ 0 };	   // voices out of range
+			uint64_t dropped{ 0 };	   // voices not started because the pool or queue was full
+			uint64_t blocks{ 0 };	   // blocks mixed
+			uint64_t voiceFrames{ 0 }; // frames mixed summed over voices
+		};
+
+		MIXSTATS stats() const;
+
+	private:
+		struct CLIP {
+			std::vector<float> samples;
+		};
+
+		struct COMMAND {
+			enum { PLAY, MOVE, STOP } type{ PLAY };
+			int handle{ -1 };
+			const CLIP* clip{ nullptr };
+			float gainL{ 0.0f };
+			float gainR{ 0.0f };
+		};
+
+		// owned by the audio thread
+		struct VOICE {
+			const CLIP* clip{ nullptr };
+			size_t position{ 0 };
+			float gainL{ 0.0f };
+			float gainR{ 0.0f };
+			int handle{ -1 };
+		};
+
+		Context* context_{ nullptr };
+		bool running_{ false };
+		int frequency_{ 0 };
+		glm::vec2 listener_{ 0.0f, 0.0f };
+
+		std::map<int, std::unique_ptr<CLIP>> clips_;
+		// replaced clips are kept until stop() in case a voice is still playing them
+		std::vector<std::unique_ptr<CLIP>> retired_;
+
+		std::array<COMMAND, QueueSize> queue_;
+		std::atomic<uint32_t> queueHead_{ 0 };
+		std::atomic<uint32_t> queueTail_{ 0 };
+
+		// set by play(), cleared by the audio thread when the voice finishes
+		std::array<std::atomic<bool>, MaxVoices> busy_;
+		std::array<int, MaxVoices> generation_{};
+		std::array<VOICE, MaxVoices> voices_;
+		std::vector<float> block_;
+
+		uint64_t played_{ 0 };
+		uint64_t culled_{ 0 };
+		uint64_t dropped_{ 0 };
+		std::atomic<uint64_t> blocks_{ 0 };
+		std::atomic<uint64_t> voiceFrames_{ 0 };
+
+		bool _push(const COMMAND& command);
+		void _gains(glm::vec2 position, float volume, float& gainL, float& gainR) const;
+		void _runCommands();
+		static void _postMix(void* udata, Uint8* stream, int len);
+	};
+} // namespace GameLib
+
+#endif
@@ -0,0 +1,568 @@
+#include "pch.h"
+#include <gamelib_music_streamer.hpp>
+#include <cctype>
+#include <cstring>
+
+namespace GameLib {
+	class MusicStreamer::Source {
+	public:
+		virtual ~Source() {}
+
+		// reads up to frames stereo float frames at the device frequency, fewer at the end of the track
+		virtual int read(float* out, int frames) = 0;
+	};
+
+	namespace {
+		uint32_t readU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+		uint16_t readU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+		// reads PCM from a WAV file as it plays, an SDL_AudioStream converts it to the device format
+		// seeking back to the loop start feeds the stream without a break, so loops are gapless
+		class WavSource : public MusicStreamer::Source {
+		public:
+			~WavSource() override {
+				if (stream_)
+					SDL_FreeAudioStream(stream_);
+				SDL_RWclose(rw_);
+			}
+
+			// takes ownership of rw, returns nullptr if it is not a PCM WAV file
+			static std::unique_ptr<WavSource> open(SDL_RWops* rw, int frequency, bool loop, double loopStart, double loopEnd) {
+				auto source = std::unique_ptr<WavSource>(new WavSource(rw));
+				if (!source->_readHeader())
+					return nullptr;
+				source->stream_ = SDL_NewAudioStream(source->format_, source->channels_, source->rate_, AUDIO_F32SYS, 2, frequency);
+				if (!source->stream_)
+					return nullptr;
+				source->loop_ = loop;
+				source->loopStart_ = clamp<int64_t>((int64_t)(loopStart * source->rate_ + 0.5), 0, source->frames_);
+				source->loopEnd_ = loopEnd > 0.0 ? clamp<int64_t>((int64_t)(loopEnd * source->rate_ + 0.5), 0, source->frames_) : source->frames_;
+				if (source->loopEnd_ <= source->loopStart_)
+					source->loop_ = false;
+				source->raw_.resize((size_t)RawFrames * source->blockAlign_);
+				return source;
+			}
+
+			int read(float* out, int frames) override {
+				int bytes = frames * 2 * (int)sizeof(float);
+				while (SDL_AudioStreamAvailable(stream_) < bytes && !ended_) {
+					int64_t end = loop_ ? loopEnd_ : frames_;
+					size_t count = (size_t)std::min<int64_t>(RawFrames, end - position_);
+					size_t got = count ? SDL_RWread(rw_, raw_.data(), blockAlign_, count) : 0;
+					if (got)
+						SDL_AudioStreamPut(stream_, raw_.data(), (int)(got * blockAlign_));
+					position_ = got < count ? end : position_ + got;
+					if (position_ < end)
+						continue;
+					if (loop_) {
+						SDL_RWseek(rw_, dataOffset_ + loopStart_ * blockAlign_, RW_SEEK_SET);
+						position_ = loopStart_;
+					} else {
+						SDL_AudioStreamFlush(stream_);
+						ended_ = true;
+					}
+				}
+				int got = SDL_AudioStreamGet(stream_, out, bytes);
+				return got > 0 ? got / (2 * (int)sizeof(float)) : 0;
+			}
+
+		private:
+			static constexpr int RawFrames = 4096;
+
+			SDL_RWops* rw_{ nullptr };
+			SDL_AudioStream* stream_{ nullptr };
+			SDL_AudioFormat format_{ 0 };
+			int channels_{ 0 };
+			int rate_{ 0 };
+			int blockAlign_{ 0 };
+			int64_t dataOffset_{ 0 };
+			int64_t frames_{ 0 };
+			int64_t position_{ 0 };
+			int64_t loopStart_{ 0 };
+			int64_t loopEnd_{ 0 };
+			bool loop_{ false };
+			bool ended_{ false };
+			std::vector<uint8_t> raw_;
+
+			WavSource(SDL_RWops* rw) : rw_(rw) {}
+
+			bool _readHeader() {
+				uint8_t header[12];
+				if (SDL_RWread(rw_, header, 1, 12) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+					return false;
+				bool haveFormat = false;
+				uint8_t chunk[8];
+				while (SDL_RWread(rw_, chunk, 1, 8) == 8) {
+					uint32_t size = readU32(chunk + 4);
+					int64_t next = SDL_RWtell(rw_) + size + (size & 1);
+					if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+						uint8_t fmt[16];
+						if (SDL_RWread(rw_, fmt, 1, 16) != 16)
+							return false;
+						uint16_t tag = readU16(fmt);
+						int bits = readU16(fmt + 14);
+						channels_ = readU16(fmt + 2);
+						rate_ = (int)readU32(fmt + 4);
+						blockAlign_ = readU16(fmt + 12);
+						if (tag == 3 && bits == 32)
+							format_ = AUDIO_F32LSB;
+						else if ((tag == 1 || tag == 0xFFFE) && bits == 16)
+							format_ = AUDIO_S16LSB;
+						else if (tag == 1 && bits == 8)
+							format_ = AUDIO_U8;
+						else if (tag == 1 && bits == 32)
+							format_ = AUDIO_S32LSB;
+						else
+							return false;
+						haveFormat = channels_ > 0 && rate_ > 0 && blockAlign_ > 0;
+					} else if (!memcmp(chunk, "data", 4)) {
+						if (!haveFormat)
+							return false;
+						dataOffset_ = SDL_RWtell(rw_);
+						frames_ = size / blockAlign_;
+						return true;
+					}
+					SDL_RWseek(rw_, next, RW_SEEK_SET);
+				}
+				return false;
+			}
+		};
+
+		// plays a chunk that SDL_mixer decoded to the 16 bit stereo device format
+		class ChunkSource : public MusicStreamer::Source {
+		public:
+			ChunkSource(Mix_Chunk* chunk, int frequency, bool loop, double loopStart, double loopEnd) : chunk_(chunk) {
+				samples_ = (const Sint16*)chunk->abuf;
+				frames_ = chunk->alen / (2 * sizeof(Sint16));
+				loopStart_ = clamp<int64_t>((int64_t)(loopStart * frequency + 0.5), 0, frames_);
+				loopEnd_ = loopEnd > 0.0 ? clamp<int64_t>((int64_t)(loopEnd * frequency + 0.5), 0, frames_) : frames_;
+				loop_ = loop && loopEnd_ > loopStart_;
+			}
+
+			~ChunkSource() override { Mix_FreeChunk(chunk_); }
+
+			int read(float* out, int frames) override {
+				int count = 0;
+				while (count < frames) {
+					int64_t end = loop_ ? loopEnd_ : frames_;
+					if (position_ >= end) {
+						if (!loop_)
+							break;
+						position_ = loopStart_;
+					}
+					int n = (int)std::min<int64_t>(frames - count, end - position_);
+					const Sint16* in = samples_ + position_ * 2;
+					for (int i = 0; i < n * 2; i++) {
+						out[count * 2 + i] = in[i] * (1.0f / 32768.0f);
+					}
+					count += n;
+					position_ += n;
+				}
+				return count;
+			}
+
+		private:
+			Mix_Chunk* chunk_{ nullptr };
+			const Sint16* samples_{ nullptr };
+			int64_t frames_{ 0 };
+			int64_t position_{ 0 };
+			int64_t loopStart_{ 0 };
+			int64_t loopEnd_{ 0 };
+			bool loop_{ false };
+		};
+	} // namespace
+
+	MusicStreamer::MusicStreamer() {}
+
+	MusicStreamer::~MusicStreamer() { stop(); }
+
+	bool MusicStreamer::start(Context* context, int bufferMs) {
+		stop();
+		context_ = context;
+		if (!context_ || !context_->audioInitialized())
+			return false;
+		Uint16 format;
+		int channels;
+		if (!Mix_QuerySpec(&frequency_, &format, &channels))
+			return false;
+		if (format != AUDIO_S16SYS || channels != 2) {
+			HFLOGERROR("the music streamer needs 16 bit stereo output");
+			return false;
+		}
+
+		int frames = std::max(bufferMs, 1) * frequency_ / 1000;
+		capacity_ = std::max(2, (frames + BlockFrames - 1) / BlockFrames) * BlockFrames;
+		for (auto& slot : slots_) {
+			slot.ring.assign((size_t)capacity_ * 2, 0.0f);
+		}
+		block_.assign((size_t)BlockFrames * 2, 0.0f);
+		mix_.assign((size_t)BlockFrames * 2, 0.0f);
+		// the callback swaps these, so neither side allocates for the usual handful of fades
+		fades_.reserve(16);
+		hookFades_.reserve(16);
+		underruns_ = 0;
+		framesPlayed_ = 0;
+		applied_ = 0;
+		quit_ = false;
+		thread_ = std::thread(&MusicStreamer::_run, this);
+		decoder_ = std::thread(&MusicStreamer::_runDecoder, this);
+		Mix_HookMusic(&MusicStreamer::_hook, this);
+		hooked_ = true;
+		HFLOGINFO("streaming music with %d ms buffered", capacity_ * 1000 / frequency_);
+		return true;
+	}
+
+	void MusicStreamer::stop() {
+		if (!thread_.joinable())
+			return;
+		// SDL_mixer holds its lock while changing the hook, so the callback is not running after this
+		if (hooked_)
+			Mix_HookMusic(nullptr, nullptr);
+		hooked_ = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		cv_.notify_all();
+		decodeCv_.notify_all();
+		thread_.join();
+		decoder_.join();
+		for (auto& slot : slots_) {
+			slot.source.reset();
+			slot.head = 0;
+			slot.tail = 0;
+			slot.free = true;
+			slot.ended = false;
+			slot.active = false;
+		}
+		starts_.clear();
+		hookFades_.clear();
+		voiceCount_ = 0;
+		{
+			std::lock_guard<std::mutex> lock(fadeMutex_);
+			fades_.clear();
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		commands_.clear();
+		decodes_.clear();
+		decoded_.clear();
+	}
+
+	void MusicStreamer::addTrack(int musicId, const std::string& filename, double loopStart, double loopEnd) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		tracks_[musicId] = { filename, loopStart, loopEnd };
+	}
+
+	void MusicStreamer::play(int musicId, int fadeMs, bool loop) {
+		if (!running())
+			return;
+		if (musicId >= 0 && !canStream(musicId)) {
+			// SDL_mixer only plays its own music while the hook is removed
+			stopMusic(0);
+			if (hooked_)
+				Mix_HookMusic(nullptr, nullptr);
+			hooked_ = false;
+			if (!context_->playMusicClip(musicId, loop ? -1 : 1, fadeMs))
+				HFLOGWARN("music track %d can not be played", musicId);
+			return;
+		}
+		if (!hooked_) {
+			// the stop queued when the hook was removed cuts the old tracks as soon as the callback runs
+			context_->stopMusicClip();
+			Mix_HookMusic(&MusicStreamer::_hook, this);
+			hooked_ = true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			commands_.push_back({ musicId, fadeMs, loop, ++serial_ });
+		}
+		cv_.notify_one();
+	}
+
+	void MusicStreamer::stopMusic(int fadeMs) {
+		if (running() && !hooked_)
+			context_->stopMusicClip();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			commands_.push_back({ -1, fadeMs, false, ++serial_ });
+		}
+		cv_.notify_one();
+	}
+
+	bool MusicStreamer::canStream(int musicId) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = tracks_.find(musicId);
+		if (it == tracks_.end())
+			return false;
+		// SDL_mixer can not load MIDI as a chunk
+		std::string ext = it->second.filename.substr(std::min(it->second.filename.size(), it->second.filename.rfind('.') + 1));
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		return ext != "mid" && ext != "midi";
+	}
+
+	MusicStreamer::STREAMSTATS MusicStreamer::stats() const {
+		STREAMSTATS s;
+		int buffered = -1;
+		for (auto& slot : slots_) {
+			if (slot.free || slot.ended)
+				continue;
+			int frames = (int)(slot.head - slot.tail);
+			buffered = buffered < 0 ? frames : std::min(buffered, frames);
+		}
+		s.bufferedFrames = std::max(buffered, 0);
+		s.capacity = capacity_;
+		s.tracks = voiceCount_;
+		s.underruns = underruns_;
+		s.framesPlayed = framesPlayed_;
+		return s;
+	}
+
+	void MusicStreamer::_run() {
+		while (!quit_) {
+			_runCommands();
+			_startTracks();
+			bool filled = false;
+			for (auto& slot : slots_) {
+				// the audio callback is done with the track
+				if (slot.free && slot.source)
+					slot.source.reset();
+				else if (_fill(slot))
+					filled = true;
+			}
+			if (!filled) {
+				// slots freed by the audio callback are picked up on the next pass
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait_for(lock, std::chrono::milliseconds(5), [this] { return quit_ || !commands_.empty() || !decoded_.empty(); });
+			}
+		}
+	}
+
+	void MusicStreamer::_runDecoder() {
+		for (;;) {
+			DECODE decode;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				decodeCv_.wait(lock, [this] { return quit_ || !decodes_.empty(); });
+				if (quit_)
+					return;
+				decode = std::move(decodes_.front());
+				decodes_.pop_front();
+			}
+			decode.source = _decode(decode.track, decode.command.loop);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				decoded_.push_back(std::move(decode));
+			}
+			cv_.notify_one();
+		}
+	}
+
+	void MusicStreamer::_runCommands() {
+		std::vector<COMMAND> commands;
+		std::vector<DECODE> decoded;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			commands.swap(commands_);
+			decoded.swap(decoded_);
+		}
+		// decoded tracks were asked for before any of these commands
+		for (auto& decode : decoded) {
+			if (decode.source && decode.command.serial > applied_)
+				_apply(decode.command, std::move(decode.source));
+		}
+		for (auto& command : commands) {
+			if (command.musicId < 0) {
+				_apply(command, nullptr);
+				continue;
+			}
+			TRACK track;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto it = tracks_.find(command.musicId);
+				if (it == tracks_.end()) {
+					HFLOGWARN("music track %d was not added", command.musicId);
+					continue;
+				}
+				track = it->second;
+			}
+			bool decode = false;
+			std::unique_ptr<Source> source = _open(track, command.loop, decode);
+			if (source) {
+				_apply(command, std::move(source));
+			} else if (decode) {
+				// the playing tracks keep streaming until the decoder thread is done
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					decodes_.push_back({ command, std::move(track), nullptr });
+				}
+				decodeCv_.notify_one();
+			}
+		}
+	}
+
+	void MusicStreamer::_apply(const COMMAND& command, std::unique_ptr<Source> source) {
+		applied_ = command.serial;
+		starts_.push_back({ command, std::move(source) });
+	}
+
+	bool MusicStreamer::_startTracks() {
+		while (!starts_.empty()) {
+			START& start = starts_.front();
+			float fadeFrames = start.command.fadeMs * 0.001f * frequency_;
+			FADE fade;
+			fade.gain = fadeFrames >= 1.0f ? 0.0f : 1.0f;
+			fade.step = fadeFrames >= 1.0f ? 1.0f / fadeFrames : 1.0f;
+			if (start.source) {
+				int i = 0;
+				while (i < MaxTracks && !(slots_[i].free && !slots_[i].source))
+					i++;
+				if (i == MaxTracks)
+					return false;
+				SLOT& slot = slots_[i];
+				slot.head = 0;
+				slot.tail = 0;
+				slot.ended = false;
+				slot.free = false;
+				slot.source = std::move(start.source);
+				// the first block is ready by the time the callback starts the track
+				_fill(slot);
+				fade.slot = i;
+			}
+			{
+				std::lock_guard<std::mutex> lock(fadeMutex_);
+				fades_.push_back(fade);
+			}
+			starts_.pop_front();
+		}
+		return true;
+	}
+
+	bool MusicStreamer::_fill(SLOT& slot) {
+		if (slot.free || !slot.source)
+			return false;
+		uint64_t head = slot.head.load(std::memory_order_relaxed);
+		if (capacity_ - (int)(head - slot.tail.load(std::memory_order_acquire)) < BlockFrames)
+			return false;
+		int count = slot.source->read(block_.data(), BlockFrames);
+		for (int i = 0; i < count; i++) {
+			size_t index = (size_t)((head + i) % capacity_) * 2;
+			slot.ring[index] = block_[i * 2];
+			slot.ring[index + 1] = block_[i * 2 + 1];
+		}
+		slot.head.store(head + count, std::memory_order_release);
+		if (count < BlockFrames) {
+			// the callback frees the slot once it has played what is left
+			slot.source.reset();
+			slot.ended.store(true, std::memory_order_release);
+			return false;
+		}
+		return true;
+	}
+
+	void MusicStreamer::_mix(Sint16* out, int frames) {
+		float* mix = mix_.data();
+		std::fill(mix, mix + frames * 2, 0.0f);
+		int playing = 0;
+		bool underrun = false;
+		for (auto& slot : slots_) {
+			if (!slot.active)
+				continue;
+			// ended is read first so head is final once it is set
+			bool ended = slot.ended.load(std::memory_order_acquire);
+			uint64_t head = slot.head.load(std::memory_order_acquire);
+			uint64_t tail = slot.tail.load(std::memory_order_relaxed);
+			// a fade out of 0 ms stops the track before it is heard again
+			bool stopped = slot.step <= -1.0f;
+			int count = stopped ? 0 : (int)std::min<uint64_t>(frames, head - tail);
+			for (int i = 0; i < count; i++) {
+				size_t index = (size_t)((tail + i) % capacity_) * 2;
+				mix[i * 2] += slot.ring[index] * slot.gain;
+				mix[i * 2 + 1] += slot.ring[index + 1] * slot.gain;
+				slot.gain = clamp(slot.gain + slot.step, 0.0f, 1.0f);
+			}
+			slot.tail.store(tail + count, std::memory_order_release);
+			if (count < frames && !ended && !stopped)
+				underrun = true;
+			if (stopped || (slot.step < 0.0f && slot.gain <= 0.0f) || (ended && tail + count == head)) {
+				slot.active = false;
+				slot.free.store(true, std::memory_order_release);
+			} else {
+				playing++;
+			}
+		}
+		for (int i = 0; i < frames * 2; i++) {
+			out[i] = (Sint16)clamp((int)std::lrint(mix[i] * 32767.0f), -32768, 32767);
+		}
+		if (underrun)
+			underruns_++;
+		voiceCount_ = playing;
+	}
+
+	std::unique_ptr<MusicStreamer::Source> MusicStreamer::_open(const TRACK& track, bool loop, bool& decode) {
+		SDL_RWops* rw = context_->openAsset(track.filename);
+		if (!rw) {
+			HFLOGERROR("music '%s' not found", track.filename.c_str());
+			return nullptr;
+		}
+		char magic[12]{};
+		SDL_RWread(rw, magic, 1, sizeof(magic));
+		SDL_RWseek(rw, 0, RW_SEEK_SET);
+		if (!memcmp(magic, "RIFF", 4) && !memcmp(magic + 8, "WAVE", 4)) {
+			auto source = WavSource::open(rw, frequency_, loop, track.loopStart, track.loopEnd);
+			if (!source)
+				HFLOGERROR("music '%s' is not a PCM WAV file", track.filename.c_str());
+			return source;
+		}
+		SDL_RWclose(rw);
+		decode = true;
+		return nullptr;
+	}
+
+	std::unique_ptr<MusicStreamer::Source> MusicStreamer::_decode(const TRACK& track, bool loop) {
+		HFPROFILE("MusicStreamer::decode");
+		SDL_RWops* rw = context_->openAsset(track.filename);
+		if (!rw) {
+			HFLOGERROR("music '%s' not found", track.filename.c_str());
+			return nullptr;
+		}
+		// SDL_mixer has no way to decode these formats a block at a time, so the track is decoded whole
+		Mix_Chunk* chunk;
+		{
+			std::lock_guard<std::mutex> lock(context_->audioDecodeMutex());
+			chunk = Mix_LoadWAV_RW(rw, 1);
+		}
+		if (!chunk) {
+			HFLOGERROR("music '%s' can not be streamed: %s", track.filename.c_str(), Mix_GetError());
+			return nullptr;
+		}
+		return std::make_unique<ChunkSource>(chunk, frequency_, loop, track.loopStart, track.loopEnd);
+	}
+
+	void MusicStreamer::_hook(void* udata, Uint8* stream, int len) {
+		MusicStreamer* streamer = (MusicStreamer*)udata;
+		Sint16* out = (Sint16*)stream;
+		int frames = len / (int)(2 * sizeof(Sint16));
+		// the callback never waits for the worker thread, fades it is posting are taken next time
+		if (streamer->fadeMutex_.try_lock()) {
+			streamer->hookFades_.swap(streamer->fades_);
+			streamer->fadeMutex_.unlock();
+		}
+		for (auto& fade : streamer->hookFades_) {
+			for (auto& slot : streamer->slots_) {
+				if (slot.active)
+					slot.step = -fade.step;
+			}
+			if (fade.slot >= 0) {
+				SLOT& slot = streamer->slots_[fade.slot];
+				slot.active = true;
+				slot.gain = fade.gain;
+				slot.step = fade.step;
+			}
+		}
+		streamer->hookFades_.clear();
+		for (int done = 0; done < frames; done += BlockFrames) {
+			streamer->_mix(out + done * 2, std::min(BlockFrames, frames - done));
+		}
+		streamer->framesPlayed_ += frames;
+	}
+} // namespace GameLib
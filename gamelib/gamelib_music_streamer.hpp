@@ -0,0 +1,172 @@
+#ifndef GAMELIB_MUSIC_STREAMER_HPP
+#define GAMELIB_MUSIC_STREAMER_HPP
+
+#include <gamelib_context.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace GameLib {
+	// MusicStreamer plays music through Mix_HookMusic from ring buffers that a worker thread keeps
+	// filled ahead of the audio callback, one per track, so decoding never runs on the audio thread.
+	// The callback mixes the tracks and applies their fades itself, so stops and crossfades are heard
+	// within one callback rather than after the buffered music has played out. WAV files are
+	// decoded as they play. Other formats SDL_mixer can load as a chunk (OGG, MP3, FLAC) are decoded
+	// whole on a decoder thread while the playing track keeps streaming, and the crossfade starts once
+	// the new track is ready. Files are opened with Context::openAsset() so packed archives work without
+	// temp files. Tracks that were not added, and MIDI tracks, are played by SDL_mixer from their
+	// MUSICINFO with the hook removed, so Context::playMusicClip() music is heard until the next
+	// streamed track
+	class MusicStreamer {
+	public:
+		// milliseconds of music decoded ahead of the audio callback for each track
+		static constexpr int DefaultBufferMs = 500;
+		// frames decoded at a time by the worker thread
+		static constexpr int BlockFrames = 1024;
+		// tracks that can play or fade at once, a new track waits for a fade to finish beyond this
+		static constexpr int MaxTracks = 4;
+
+		MusicStreamer();
+		~MusicStreamer();
+
+		// hooks the SDL_mixer music output and starts the worker thread, the device must be 16 bit stereo
+		bool start(Context* context, int bufferMs = DefaultBufferMs);
+
+		// stops the worker thread and unhooks the music output
+		void stop();
+
+		// returns true if the streamer is hooked into SDL_mixer
+		bool running() const { return thread_.joinable(); }
+
+		// registers a track under the same id as its MUSICINFO. Loops run from loopStart to loopEnd
+		// seconds without a gap, a loopEnd of 0 is the end of the file
+		void addTrack(int musicId, const std::string& filename, double loopStart = 0.0, double loopEnd = 0.0);
+
+		// starts a track, crossfading from the playing tracks over fadeMs
+		// tracks the streamer can not play fall back to Context::playMusicClip()
+		void play(int musicId, int fadeMs = 0, bool loop = true);
+
+		// fades out the playing tracks over fadeMs
+		void stopMusic(int fadeMs = 0);
+
+		// returns false for tracks that were not added or that SDL_mixer has to play itself, e.g. MIDI
+		bool canStream(int musicId) const;
+
+		struct STREAMSTATS {
+			int bufferedFrames{ 0 };   // frames decoded ahead of the audio callback, for the track with the fewest
+			int capacity{ 0 };		   // frames each ring buffer holds
+			int tracks{ 0 };		   // tracks playing or fading
+			uint64_t underruns{ 0 };   // audio callbacks that ran out of decoded music
+			uint64_t framesPlayed{ 0 }; // frames handed to SDL_mixer
+		};
+
+		STREAMSTATS stats() const;
+
+		class Source;
+
+	private:
+		struct TRACK {
+			std::string filename;
+			double loopStart{ 0.0 };
+			double loopEnd{ 0.0 };
+		};
+
+		struct COMMAND {
+			int musicId{ -1 }; // -1 stops the music
+			int fadeMs{ 0 };
+			bool loop{ true };
+			// commands are numbered in order, a decoded track is dropped if a later command was applied
+			uint64_t serial{ 0 };
+		};
+
+		// a track for the decoder thread, and the decoded result
+		struct DECODE {
+			COMMAND command;
+			TRACK track;
+			std::unique_ptr<Source> source;
+		};
+
+		// a track or stop waiting for a free slot, owned by the worker thread
+		struct START {
+			COMMAND command;
+			std::unique_ptr<Source> source;
+		};
+
+		// a fade for the audio callback, a slot of -1 only fades out the playing tracks
+		struct FADE {
+			int slot{ -1 };
+			float gain{ 0.0f };
+			float step{ 0.0f };
+		};
+
+		// stereo float frames of one track, written by the worker thread and read by the audio callback
+		struct SLOT {
+			std::vector<float> ring;
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> tail{ 0 };
+			// set by the audio callback once the track has faded out or played to the end
+			std::atomic<bool> free{ true };
+			// set by the worker thread when the source has no more frames
+			std::atomic<bool> ended{ false };
+			// owned by the worker thread
+			std::unique_ptr<Source> source;
+			// owned by the audio callback
+			bool active{ false };
+			float gain{ 0.0f };
+			float step{ 0.0f };
+		};
+
+		Context* context_{ nullptr };
+		int frequency_{ 0 };
+
+		std::thread thread_;
+		std::thread decoder_;
+		std::atomic<bool> quit_{ false };
+		mutable std::mutex mutex_;
+		std::condition_variable cv_;
+		std::condition_variable decodeCv_;
+		std::map<int, TRACK> tracks_;
+		std::vector<COMMAND> commands_;
+		uint64_t serial_{ 0 };
+		// waiting for the decoder thread, and decoded tracks waiting for the worker thread
+		std::deque<DECODE> decodes_;
+		std::vector<DECODE> decoded_;
+		// owned by the worker thread
+		uint64_t applied_{ 0 };
+		std::deque<START> starts_;
+		std::vector<float> block_;
+		// false while SDL_mixer plays a track the streamer can not play, main thread only
+		bool hooked_{ false };
+
+		SLOT slots_[MaxTracks];
+		int capacity_{ 0 };
+		// fades posted by the worker thread, the audio callback takes them without waiting
+		std::mutex fadeMutex_;
+		std::vector<FADE> fades_;
+		// owned by the audio callback
+		std::vector<FADE> hookFades_;
+		std::vector<float> mix_;
+		std::atomic<int> voiceCount_{ 0 };
+		std::atomic<uint64_t> underruns_{ 0 };
+		std::atomic<uint64_t> framesPlayed_{ 0 };
+
+		void _run();
+		void _runDecoder();
+		void _runCommands();
+		// queues source to start once a slot is free, fading out the playing tracks, or only fades them out
+		void _apply(const COMMAND& command, std::unique_ptr<Source> source);
+		// hands queued starts to free slots and posts their fades, returns false if one is still waiting
+		bool _startTracks();
+		// decodes one block into the slot, returns false if its ring buffer is full or its track ended
+		bool _fill(SLOT& slot);
+		// mixes frames of the playing tracks into out, applying their fades
+		void _mix(Sint16* out, int frames);
+		// opens a WAV track to decode as it plays, sets decode for formats the decoder thread decodes whole
+		std::unique_ptr<Source> _open(const TRACK& track, bool loop, bool& decode);
+		std::unique_ptr<Source> _decode(const TRACK& track, bool loop);
+		static void _hook(void* udata, Uint8* stream, int len);
+	};
+} // namespace GameLib
+
+#endif
@@ -1,5 +1,7 @@
 #include "pch.h"
+#include <gamelib_mapped_file.hpp>
 #include <gamelib_object.hpp>
+#include <gamelib_text_scanner.hpp>
 
 namespace GameLib {
 	Object::Object() {}
@@ -19,19 +21,31 @@ namespace GameLib {
 		_setInfo(_updateInfo());
 	}
 
+	void Object::readLine(std::string_view line) {
+		std::istringstream istr(std::string{ line });
+		readCharStream(istr);
+	}
+
 	bool Object::load(const std::string& filename) {
-		std::ifstream fin(filename);
-		if (!fin)
-			return false;
-		while (fin) {
-			std::string str;
-			std::getline(fin, str);
-			std::istringstream istr(str);
-			readCharStream(istr);
+		HFPROFILE("Object::load");
+		MappedFile file;
+		if (!file.open(filename)) {
+			// empty files can't be mapped but still load
+			std::ifstream fin(filename);
+			return (bool)fin;
 		}
+		readText({ file.data(), file.size() });
 		return true;
 	}
 
+	void Object::readText(std::string_view text) {
+		TextScanner scanner(text);
+		std::string_view line;
+		while (scanner.line(line)) {
+			readLine(line);
+		}
+	}
+
 	bool Object::write(const std::string& filename) {
 		std::ofstream fout(filename);
 		if (!fout)
@@ -2,6 +2,7 @@
 #define GAMELIB_OBJECT_HPP
 
 #include <gamelib_base.hpp>
+#include <string_view>
 
 namespace GameLib {
 	class Object : public std::enable_shared_from_this<Object> {
@@ -55,9 +56,16 @@ namespace GameLib {
 			return is;
 		}
 
-		// Read line by line the contents of the file, calling readCharStream with an istringstream
+		// Reads one line of a file without copying. The default wraps the line in an istringstream
+		// and calls readCharStream, override it to parse the line directly with a TextScanner
+		virtual void readLine(std::string_view line);
+
+		// Maps the file into memory and calls readLine for each line
 		bool load(const std::string& filename);
 
+		// Calls readLine for each line of text, e.g. a file packed in an asset archive
+		void readText(std::string_view text);
+
 		// Write line by line the contents of the file, calling writeCharStream with an ofstream
 		bool write(const std::string& filename);
 
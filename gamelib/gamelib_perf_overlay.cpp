@@ -0,0 +1,101 @@
+#include "pch.h"
+#include <gamelib_perf_overlay.hpp>
+
+namespace GameLib {
+	void PerfOverlay::update(float frameMs, const World* world) {
+		frameMs_[next_] = frameMs;
+		next_ = (next_ + 1) % GraphFrames;
+		count_ = std::min(count_ + 1, GraphFrames);
+		if (!visible)
+			return;
+
+		float worst{ 0.0f };
+		float total{ 0.0f };
+		for (int i = 0; i < count_; i++) {
+			worst = std::max(worst, frameMs_[i]);
+			total += frameMs_[i];
+		}
+
+		lineCount_ = 0;
+		snprintf(lines_[lineCount_++], sizeof(lines_[0]), "frame %5.2f ms  avg %5.2f  max %5.2f", frameMs, total / count_, worst);
+
+		const Context::RENDERSTATS& render = context_->renderStats();
+		snprintf(lines_[lineCount_++], sizeof(lines_[0]), "draws %d  texture switches %d", render.drawCalls, render.textureSwitches);
+
+		if (world) {
+			snprintf(lines_[lineCount_++],
+				sizeof(lines_[0]),
+				"actors %d dynamic  %d static  %d trigger",
+				(int)world->dynamicActors.size(),
+				(int)world->staticActors.size(),
+				(int)world->triggerActors.size());
+		}
+
+		// without HFALLOC_TRACKER_HOOKS() in the program there is nothing to show
+		if (Hf::AllocTracker::isEnabled() && Hf::AllocTracker::hooksInstalled()) {
+			const Hf::AllocTracker::FRAMESTATS& allocs = Hf::AllocTracker::lastFrame();
+			snprintf(lines_[lineCount_++],
+				sizeof(lines_[0]),
+				"allocs %llu  frees %llu  +%llu -%llu bytes",
+				(unsigned long long)allocs.allocations,
+				(unsigned long long)allocs.frees,
+				(unsigned long long)allocs.bytes,
+				(unsigned long long)allocs.freedBytes);
+		}
+
+		const Hf::FrameProfiler::FRAMESTATS& profile = Hf::Profiler.lastFrame();
+		int rows = std::min((int)profile.zones.size(), ZoneRows);
+		for (int i = 0; i < rows; i++) {
+			const auto& zone = profile.zones[i];
+			snprintf(lines_[lineCount_++], sizeof(lines_[0]), "%-22.22s %6.2f ms  x%d", zone.name, zone.totalMs, zone.calls);
+		}
+		if (!Hf::Profiler.isEnabled())
+			snprintf(lines_[lineCount_++], sizeof(lines_[0]), "profiler off");
+	}
+
+	void PerfOverlay::draw(int x, int y) {
+		if (!visible)
+			return;
+		HFPROFILE("PerfOverlay::draw");
+		context_->setDrawCounting(false);
+		SDL_Renderer* renderer = context_->renderer();
+
+		// the graph is scaled so the budget sits at half height
+		constexpr int GraphHeight = 60;
+		int lineHeight = font_->calcHeight();
+		int width = GraphFrames * 2;
+		SDL_Rect back{ x, y, width, GraphHeight + lineHeight * lineCount_ + 4 };
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+		SDL_RenderFillRect(renderer, &back);
+
+		SDL_Rect under[GraphFrames];
+		SDL_Rect over[GraphFrames];
+		int underCount{ 0 };
+		int overCount{ 0 };
+		float scale = GraphHeight * 0.5f / budgetMs;
+		for (int i = 0; i < count_; i++) {
+			// oldest on the left
+			float ms = frameMs_[(next_ - count_ + i + GraphFrames) % GraphFrames];
+			int h = std::min(GraphHeight, std::max(1, (int)(ms * scale)));
+			SDL_Rect bar{ x + i * 2, y + GraphHeight - h, 2, h };
+			if (ms > budgetMs)
+				over[overCount++] = bar;
+			else
+				under[underCount++] = bar;
+		}
+		SDL_SetRenderDrawColor(renderer, 64, 224, 64, 255);
+		SDL_RenderFillRects(renderer, under, underCount);
+		SDL_SetRenderDrawColor(renderer, 224, 64, 64, 255);
+		SDL_RenderFillRects(renderer, over, overCount);
+		SDL_SetRenderDrawColor(renderer, 255, 255, 255, 96);
+		SDL_RenderDrawLine(renderer, x, y + GraphHeight / 2, x + width, y + GraphHeight / 2);
+
+		int ty = y + GraphHeight + 2;
+		for (int i = 0; i < lineCount_; i++) {
+			font_->drawCached(x + 2, ty, lines_[i], White, 0);
+			ty += lineHeight;
+		}
+		context_->setDrawCounting(true);
+	}
+} // namespace GameLib
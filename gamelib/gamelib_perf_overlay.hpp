@@ -0,0 +1,47 @@
+#ifndef GAMELIB_PERF_OVERLAY_HPP
+#define GAMELIB_PERF_OVERLAY_HPP
+
+#include <gamelib_font.hpp>
+#include <gamelib_world.hpp>
+
+namespace GameLib {
+	// PerfOverlay draws a frame time graph and the numbers behind it: the slowest profiler zones of the
+	// last frame, draw calls and texture switches, and actor counts. Text goes through
+	// Font::drawCached() and the graph is one batch of rectangles, and the overlay's own draws are not
+	// counted, so turning it on barely moves what it reports. The zones need Hf::Profiler enabled
+	class PerfOverlay {
+	public:
+		// frames shown in the graph
+		static constexpr int GraphFrames = 120;
+		// zones listed in the breakdown
+		static constexpr int ZoneRows = 8;
+
+		PerfOverlay(Context* context, Font* font) : context_(context), font_(font) {}
+
+		void toggle() { visible = !visible; }
+		bool visible{ false };
+
+		// frames slower than this are drawn in red
+		float budgetMs{ 1000.0f / 60.0f };
+
+		// records the last frame, call once per frame after swapBuffers(). The zones shown are the
+		// ones Context::getEvents() collected with Hf::Profiler.frame(). world may be nullptr
+		void update(float frameMs, const World* world);
+
+		// draws the overlay with its top left corner at x, y
+		void draw(int x, int y);
+
+	private:
+		Context* context_{ nullptr };
+		Font* font_{ nullptr };
+
+		float frameMs_[GraphFrames]{};
+		int next_{ 0 };
+		int count_{ 0 };
+		// text is formatted in update() so draw() only draws
+		char lines_[ZoneRows + 5][96]{};
+		int lineCount_{ 0 };
+	};
+} // namespace GameLib
+
+#endif
@@ -14,7 +14,13 @@ namespace GameLib {
 			}
 		}
 
-		unsigned int rd() { return rd_(); }
+		// restarts the sequence, rd() then draws from it too so a run can be repeated exactly
+		void seed(unsigned int seed) {
+			mt32_.seed(seed);
+			seeded_ = true;
+		}
+
+		unsigned int rd() { return seeded_ ? (unsigned int)mt32_() : rd_(); }
 		float positive() { return positive0to1(mt32_); }
 		float normal() { return minus1to1(mt32_); }
 		int between(int a, int b) { return a + (int)(0.5f + positive() * (b - a)); }
@@ -22,6 +28,7 @@ namespace GameLib {
 	private:
 		std::mt19937 mt32_;
 		std::random_device rd_;
+		bool seeded_{ false };
 		std::uniform_real_distribution<float> positive0to1{ 0.0f, 1.0f };
 		std::uniform_real_distribution<float> minus1to1{ -1.0f, 1.0f };
 	};
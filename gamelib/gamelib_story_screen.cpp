@@ -2,7 +2,9 @@
 #include <algorithm>
 #include <cmath>
 #include <gamelib_locator.hpp>
+#include <gamelib_mapped_file.hpp>
 #include <gamelib_story_screen.hpp>
+#include <gamelib_text_scanner.hpp>
 
 namespace GameLib {
 	StoryScreen::StoryScreen() {
@@ -48,8 +50,10 @@ namespace GameLib {
 	void StoryScreen::setImage(int image, const std::string& path, float w, float h) {
 		if (image < 0 || image >= MAX_IMAGES)
 			return;
-		images[image].texture = context->loadImage(path);
-		if (!images[image].texture) {
+		images[image].name.clear();
+		if (context->loadImage(path)) {
+			images[image].name = path.substr(path.find_last_of("/\\") + 1);
+		} else {
 			HFLOGWARN("Image not found '%s'", path.c_str());
 		}
 		images[image].size.x = w * ptsize;
@@ -69,6 +73,7 @@ namespace GameLib {
 		input.back = &escapeButton;
 		GameLib::InputHandler* oldinput = Locator::getInput();
 		Locator::provide(&input);
+		Locator::getAudio()->setClipPriority(blipSoundId_, BlipPriority);
 
 		float t0 = stopwatch.stop_msf();
 		tickCount = 0;
@@ -104,11 +109,14 @@ namespace GameLib {
 
 
 	bool StoryScreen::load(const std::string& path) {
+		std::string_view archived = context->findArchived(path);
+		if (archived.data())
+			return readText(archived);
 		std::string foundPath = context->findSearchPath(path);
-		std::ifstream fin(foundPath);
-		if (!fin)
+		MappedFile file;
+		if (!file.open(foundPath))
 			return false;
-		return readStream(fin);
+		return readText({ file.data(), file.size() });
 	}
 
 
@@ -281,17 +289,19 @@ namespace GameLib {
 
 			glm::vec2 location = position + center - size2 * scale;
 			SDL_Rect dstrect{ (int)location.x, (int)location.y, (int)(img.size.x * scale), (int)(img.size.y * scale) };
-			if (img.texture) {
-				SDL_SetTextureBlendMode(img.texture, SDL_BLENDMODE_BLEND);
-				SDL_SetTextureAlphaMod(img.texture, (Uint8)(255 * imageCurve));
+			SDL_Texture* texture = img.name.empty() ? nullptr : context->getImage(img.name);
+			if (texture) {
+				SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+				SDL_SetTextureAlphaMod(texture, (Uint8)(255 * imageCurve));
+				context->countDraw(texture);
 				SDL_RenderCopyEx(context->renderer(),
-					img.texture,
+					texture,
 					nullptr,
 					&dstrect,
 					angle,
 					nullptr,
 					SDL_RendererFlip::SDL_FLIP_NONE);
-				SDL_SetTextureAlphaMod(img.texture, 255);
+				SDL_SetTextureAlphaMod(texture, 255);
 			}
 		}
 
@@ -344,7 +354,7 @@ namespace GameLib {
 
 			if (lastCharsDrawn_ != charsDrawn) {
 				lastCharsDrawn_ = charsDrawn;
-				context->playAudioClip(blipSoundId_);
+				Locator::getAudio()->playAudio(blipSoundId_, false);
 			}
 		}
 	} // namespace GameLib
@@ -396,13 +406,23 @@ namespace GameLib {
 
 
 	bool StoryScreen::readStream(std::istream& is) {
-		int actorCount;
-		is >> actorCount;
+		std::string text{ std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
+		return readText(text);
+	}
+
+
+	bool StoryScreen::readText(std::string_view text) {
+		TextScanner scanner(text);
+		std::string_view line;
+
+		int actorCount = 0;
+		scanner.read(actorCount);
+		scanner.skipLine();
 		actors.clear();
 
 		for (int i = 0; i < actorCount; i++) {
-			std::string actorName;
-			std::getline(is, actorName);
+			scanner.line(line);
+			std::string actorName{ line };
 			actors[actorName] = makeActor(actorName,
 				std::make_shared<InputComponent>(),
 				std::make_shared<ActorComponent>(),
@@ -411,40 +431,45 @@ namespace GameLib {
 			auto actor = actors[actorName];
 
 			// get name of image (a PNG or JPG)
-			std::getline(is, actor->imageName);
+			scanner.line(line);
+			actor->imageName = line;
 			if (!context->loadImage(actor->imageName)) {
 				HFLOGERROR("Can't load image '%s'", actor->imageName.c_str());
 				exit(0);
 			}
 
-			std::string line;
-			std::getline(is, line);
-			std::istringstream istr(line);
-			istr >> actor->size.x;
-			istr >> actor->size.y;
+			// the size may be on one line or two
+			scanner.read(actor->size.x);
+			scanner.read(actor->size.y);
+			scanner.skipLine();
 			actor->size *= ptsize;
 		}
 
 		dialogue.clear();
-		int duration = 0;
-		while (is) {
+		while (!scanner.eof()) {
+			// the end of the text after whitespace finishes the story like a -1, anything else is an error
 			int duration;
-			is >> duration;
+			if (!scanner.read(duration))
+				return scanner.eof();
+			scanner.skipLine();
 			if (duration < 0)
-				break;
+				return true;
 			Dialogue d;
 			d.duration = duration;
-			std::getline(is, d.actorName);
+			scanner.line(line);
+			d.actorName = line;
 
-			int size;
-			is >> size;
+			int size = 0;
+			scanner.read(size);
+			scanner.skipLine();
 			d.lines.resize(size);
-			for (std::string& line : d.lines) {
-				std::getline(is, line);
+			for (std::string& dline : d.lines) {
+				scanner.line(line);
+				dline = line;
 			}
 			dialogue.push_back(d);
 		}
-		return is.eof();
+		return true;
 	}
 
 
@@ -459,6 +484,7 @@ namespace GameLib {
 		for (auto d : dialogue) {
 			os << d.duration << "\n";
 			os << d.actorName << "\n";
+			os << d.lines.size() << "\n";
 			for (auto line : d.lines) {
 				os << line << "\n";
 			}
@@ -582,6 +608,7 @@ namespace GameLib {
 		input.back = &escapeButton;
 		GameLib::InputHandler* oldinput = Locator::getInput();
 		Locator::provide(&input);
+		Locator::getAudio()->setClipPriority(blipSoundId_, BlipPriority);
 
 		float t0 = stopwatch.stop_msf();
 		tickCount = 0;
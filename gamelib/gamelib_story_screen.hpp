@@ -4,6 +4,7 @@
 #include <gamelib_actor.hpp>
 #include <gamelib_font.hpp>
 #include <gamelib_world.hpp>
+#include <string_view>
 
 namespace GameLib {
 
@@ -39,6 +40,10 @@ namespace GameLib {
 		// sound effects
 		void setBlipSound(int blipSoundId) { blipSoundId_ = blipSoundId; }
 
+		// the blip plays through the audio service below the default priority of 0,
+		// so it never takes a voice from game sounds
+		static constexpr int BlipPriority = -1;
+
 		void newFrame(int duration,
 			int headerColor,
 			int headerShadowColor,
@@ -97,6 +102,10 @@ namespace GameLib {
 		// returns false if EOF encountered during read
 		bool readStream(std::istream& is);
 
+		// reads the same format as readStream from a buffer without copying lines
+		// returns false if EOF encountered during read
+		bool readText(std::string_view text);
+
 	protected:
 		using string_vector = std::vector<std::string>;
 
@@ -197,7 +206,8 @@ namespace GameLib {
 
 		static constexpr int MAX_IMAGES = 16;
 		struct IMAGEINFO {
-			SDL_Texture* texture{ nullptr };
+			// resource name looked up each frame, the texture may be evicted and reloaded
+			std::string name;
 			SDL_Rect rect;
 			glm::vec2 size;
 		} images[MAX_IMAGES];
@@ -0,0 +1,137 @@
+#ifndef GAMELIB_TEXT_SCANNER_HPP
+#define GAMELIB_TEXT_SCANNER_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace GameLib {
+	// case insensitive FNV-1a hash, usable in case labels so commands can be matched with a switch
+	// duplicate case labels are a compile error, so a set of commands that compiles is a perfect hash
+	constexpr uint32_t hashToken(std::string_view s) {
+		uint32_t h = 2166136261u;
+		for (char c : s) {
+			if (c >= 'a' && c <= 'z')
+				c = c - 'a' + 'A';
+			h = (h ^ (uint8_t)c) * 16777619u;
+		}
+		return h;
+	}
+
+	// TextScanner reads lines and tokens from a buffer without copying, in the same way
+	// std::getline() and operator>> would read from an istream
+	// The buffer must outlive the scanner and any string_view it returns
+	class TextScanner {
+	public:
+		TextScanner() {}
+		TextScanner(std::string_view text) : p_(text.data()), end_(text.data() + text.size()) {}
+		TextScanner(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+		// returns true if the whole buffer has been read
+		bool eof() const { return p_ >= end_; }
+
+		// returns the unread part of the buffer
+		std::string_view rest() const { return { p_, (size_t)(end_ - p_) }; }
+
+		// reads up to the next '\n' like std::getline, a trailing '\r' is dropped
+		bool line(std::string_view& out) {
+			if (p_ >= end_)
+				return false;
+			const char* first = p_;
+			const char* nl = static_cast<const char*>(memchr(p_, '\n', end_ - p_));
+			const char* last = nl ? nl : end_;
+			p_ = nl ? nl + 1 : end_;
+			if (last > first && last[-1] == '\r')
+				last--;
+			out = { first, (size_t)(last - first) };
+			return true;
+		}
+
+		// skips whitespace, including line breaks
+		void skipSpace() {
+			while (p_ < end_ && isSpace(*p_))
+				p_++;
+		}
+
+		// reads the next whitespace separated token like operator>> into a std::string
+		bool token(std::string_view& out) {
+			skipSpace();
+			if (p_ >= end_)
+				return false;
+			const char* first = p_;
+			while (p_ < end_ && !isSpace(*p_))
+				p_++;
+			out = { first, (size_t)(p_ - first) };
+			return true;
+		}
+
+		// reads the next non whitespace character like operator>> into a char
+		bool read(char& c) {
+			skipSpace();
+			if (p_ >= end_)
+				return false;
+			c = *p_++;
+			return true;
+		}
+
+		// reads an integer or floating point number like operator>>
+		template <typename T>
+		bool read(T& value) {
+			skipSpace();
+			if (p_ < end_ && *p_ == '+')
+				p_++;
+			if constexpr (std::is_floating_point_v<T>) {
+				return readFloat(value);
+			} else {
+				auto [ptr, ec] = std::from_chars(p_, end_, value);
+				if (ec != std::errc())
+					return false;
+				p_ = ptr;
+				return true;
+			}
+		}
+
+		// skips past the end of the current line
+		void skipLine() {
+			std::string_view unused;
+			line(unused);
+		}
+
+		static constexpr bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+	private:
+		// floating point from_chars needs GCC 11 or a recent libc++, so floats use strtof and strtod
+		// the buffer is not null terminated, so the token is copied first
+		template <typename T>
+		bool readFloat(T& value) {
+			char buffer[64];
+			size_t n = 0;
+			while (p_ + n < end_ && n < sizeof(buffer) - 1 && !isSpace(p_[n])) {
+				buffer[n] = p_[n];
+				n++;
+			}
+			buffer[n] = '\0';
+			char* last = buffer;
+			T result;
+			if constexpr (std::is_same_v<T, float>)
+				result = strtof(buffer, &last);
+			else if constexpr (std::is_same_v<T, double>)
+				result = strtod(buffer, &last);
+			else
+				result = (T)strtold(buffer, &last);
+			if (last == buffer)
+				return false;
+			value = result;
+			p_ += last - buffer;
+			return true;
+		}
+
+		const char* p_{ nullptr };
+		const char* end_{ nullptr };
+	};
+} // namespace GameLib
+
+#endif
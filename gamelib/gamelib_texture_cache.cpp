@@ -0,0 +1,196 @@
+#include "pch.h"
+#include <gamelib_texture_cache.hpp>
+#include <gamelib_mapped_file.hpp>
+#include <cstring>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace filesystem = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace filesystem = std::experimental::filesystem;
+#endif
+
+namespace GameLib {
+	// Texture cache entry format (little endian)
+	// TEXHEADER
+	// TEXIMAGE[count]          size of each image
+	// char[pathLength]         source path, to tell hash collisions apart
+	// pixels                   count RGBA32 images, starting on a PixelAlignment boundary
+	constexpr char TEX_MAGIC[4] = { 'G', 'L', 'T', 'C' };
+	constexpr uint32_t TEX_VERSION = 2;
+	constexpr uint64_t PixelAlignment = 16;
+	constexpr const char* TEX_EXTENSION = ".gltc";
+
+	struct TEXHEADER {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+		uint32_t pathLength;
+		uint64_t sourceSize;
+		uint64_t sourceStamp;
+	};
+
+	struct TEXIMAGE {
+		uint32_t w;
+		uint32_t h;
+	};
+
+	static uint64_t pixelsOffset(uint32_t count, uint32_t pathLength) {
+		return (sizeof(TEXHEADER) + count * sizeof(TEXIMAGE) + pathLength + PixelAlignment - 1) & ~(PixelAlignment - 1);
+	}
+
+	uint64_t TextureCache::hash(std::string_view data, uint64_t h) {
+		for (char c : data) {
+			h ^= (uint8_t)c;
+			h *= 0x100000001b3ULL;
+		}
+		return h;
+	}
+
+	bool TextureCache::open(const std::string& directory) {
+		std::error_code ec;
+		filesystem::create_directories(directory, ec);
+		if (!filesystem::is_directory(directory, ec)) {
+			HFLOGERROR("'%s' can not be used as a texture cache", directory.c_str());
+			return false;
+		}
+		directory_ = directory;
+		if (directory_.back() != '/')
+			directory_.push_back('/');
+		return true;
+	}
+
+	std::string TextureCache::_entryPath(const SOURCE& source) const {
+		uint64_t h = hash(source.path);
+		h = hash({ reinterpret_cast<const char*>(&source.w), sizeof(source.w) }, h);
+		h = hash({ reinterpret_cast<const char*>(&source.h), sizeof(source.h) }, h);
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)h);
+		return directory_ + name + TEX_EXTENSION;
+	}
+
+	std::vector<SDL_Surface*> TextureCache::load(const SOURCE& source) const {
+		if (directory_.empty())
+			return {};
+		MappedFile file;
+		// a missing entry is the usual miss, so it is not logged
+		if (!file.open(_entryPath(source))) {
+			misses_++;
+			return {};
+		}
+		const TEXHEADER* header = file.at<TEXHEADER>(0);
+		if (!header || memcmp(header->magic, TEX_MAGIC, sizeof(TEX_MAGIC)) != 0 || header->version != TEX_VERSION) {
+			misses_++;
+			return {};
+		}
+		const TEXIMAGE* images = file.at<TEXIMAGE>(sizeof(TEXHEADER), header->count);
+		const char* path = images ? file.at<char>(sizeof(TEXHEADER) + header->count * sizeof(TEXIMAGE), header->pathLength) : nullptr;
+		if (!path || header->sourceSize != source.size || header->sourceStamp != source.stamp ||
+			std::string_view(path, header->pathLength) != source.path) {
+			misses_++;
+			return {};
+		}
+		uint64_t pixelsSize = 0;
+		for (uint32_t i = 0; i < header->count; i++) {
+			pixelsSize += (uint64_t)images[i].w * images[i].h * 4;
+		}
+		const uint8_t* pixels = file.at<uint8_t>(pixelsOffset(header->count, header->pathLength), (size_t)pixelsSize);
+		if (!pixels || !header->count) {
+			HFLOGWARN("texture cache entry for '%s' is truncated", source.path.c_str());
+			misses_++;
+			return {};
+		}
+
+		std::vector<SDL_Surface*> surfaces;
+		for (uint32_t i = 0; i < header->count; i++) {
+			const TEXIMAGE& image = images[i];
+			SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, image.w, image.h, 32, SDL_PIXELFORMAT_RGBA32);
+			if (!surface) {
+				for (SDL_Surface* s : surfaces)
+					SDL_FreeSurface(s);
+				return {};
+			}
+			uint8_t* dst = static_cast<uint8_t*>(surface->pixels);
+			for (uint32_t y = 0; y < image.h; y++) {
+				memcpy(dst + y * surface->pitch, pixels + y * image.w * 4, image.w * 4);
+			}
+			pixels += (size_t)image.w * image.h * 4;
+			surfaces.push_back(surface);
+		}
+		hits_++;
+		return surfaces;
+	}
+
+	bool TextureCache::store(const SOURCE& source, const std::vector<SDL_Surface*>& surfaces) const {
+		if (directory_.empty() || surfaces.empty())
+			return false;
+
+		TEXHEADER header{};
+		memcpy(header.magic, TEX_MAGIC, sizeof(TEX_MAGIC));
+		header.version = TEX_VERSION;
+		header.count = (uint32_t)surfaces.size();
+		header.pathLength = (uint32_t)source.path.size();
+		header.sourceSize = source.size;
+		header.sourceStamp = source.stamp;
+
+		// loader threads may store the same entry at once, so each writes its own file and renames it
+		std::string entryPath = _entryPath(source);
+		std::string tempPath = entryPath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		std::ofstream fout(tempPath, std::ios::binary);
+		if (!fout) {
+			HFLOGWARN("'%s' could not be written", tempPath.c_str());
+			return false;
+		}
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (SDL_Surface* surface : surfaces) {
+			TEXIMAGE image{ (uint32_t)surface->w, (uint32_t)surface->h };
+			fout.write(reinterpret_cast<const char*>(&image), sizeof(image));
+		}
+		fout.write(source.path.data(), source.path.size());
+		static const char zeros[PixelAlignment] = { 0 };
+		fout.write(zeros, pixelsOffset(header.count, header.pathLength) - sizeof(header) - header.count * sizeof(TEXIMAGE) - header.pathLength);
+		for (SDL_Surface* surface : surfaces) {
+			SDL_Surface* rgba = surface;
+			if (surface->format->format != SDL_PIXELFORMAT_RGBA32)
+				rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+			if (!rgba) {
+				fout.setstate(std::ios::failbit);
+				break;
+			}
+			SDL_LockSurface(rgba);
+			const char* src = static_cast<const char*>(rgba->pixels);
+			for (int y = 0; y < rgba->h; y++) {
+				fout.write(src + y * rgba->pitch, rgba->w * 4);
+			}
+			SDL_UnlockSurface(rgba);
+			if (rgba != surface)
+				SDL_FreeSurface(rgba);
+		}
+		fout.close();
+
+		std::error_code ec;
+		if (!fout)
+			filesystem::remove(tempPath, ec);
+		else
+			filesystem::rename(tempPath, entryPath, ec);
+		if (!fout || ec) {
+			HFLOGWARN("texture cache entry for '%s' could not be written", source.path.c_str());
+			filesystem::remove(tempPath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	void TextureCache::clear() {
+		if (directory_.empty())
+			return;
+		std::error_code ec;
+		for (auto& entry : filesystem::directory_iterator(directory_, ec)) {
+			if (entry.path().extension() == TEX_EXTENSION)
+				filesystem::remove(entry.path(), ec);
+		}
+		hits_ = 0;
+		misses_ = 0;
+	}
+} // namespace GameLib
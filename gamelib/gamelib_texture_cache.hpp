@@ -0,0 +1,61 @@
+#ifndef GAMELIB_TEXTURE_CACHE_HPP
+#define GAMELIB_TEXTURE_CACHE_HPP
+
+#include <gamelib_base.hpp>
+#include <atomic>
+#include <string_view>
+
+namespace GameLib {
+	// TextureCache keeps decoded, already packed RGBA32 pixels on disk so images load without
+	// decompressing them. An entry is stale once the size or stamp of its source changes
+	class TextureCache {
+	public:
+		// identifies the image an entry was decoded from
+		struct SOURCE {
+			std::string path;
+			// the size in bytes and modification time or content hash of the source file
+			uint64_t size{ 0 };
+			uint64_t stamp{ 0 };
+			// the tile size the image was packed for, 0 for a whole image
+			int w{ 0 };
+			int h{ 0 };
+		};
+
+		// keeps cache files in directory, creating it if needed, returns false if it can not be created
+		bool open(const std::string& directory);
+
+		// stops using the cache directory, the files are kept
+		void close() { directory_.clear(); }
+
+		operator bool() const { return !directory_.empty(); }
+
+		// returns the directory the cache files are kept in
+		const std::string& directory() const { return directory_; }
+
+		// returns the surfaces cached for source, or an empty vector if there is no fresh entry
+		// the caller frees the returned surfaces
+		std::vector<SDL_Surface*> load(const SOURCE& source) const;
+
+		// writes surfaces to the cache for source
+		bool store(const SOURCE& source, const std::vector<SDL_Surface*>& surfaces) const;
+
+		// deletes every cache file
+		void clear();
+
+		// returns the number of loads that were found in the cache and that were not
+		int hits() const { return hits_; }
+		int misses() const { return misses_; }
+
+		// 64-bit FNV-1a hash of data
+		static uint64_t hash(std::string_view data, uint64_t h = 0xcbf29ce484222325ULL);
+
+	private:
+		std::string directory_;
+		mutable std::atomic<int> hits_{ 0 };
+		mutable std::atomic<int> misses_{ 0 };
+
+		std::string _entryPath(const SOURCE& source) const;
+	};
+} // namespace GameLib
+
+#endif
@@ -0,0 +1,48 @@
+#include "pch.h"
+#include <gamelib_thread_pool.hpp>
+
+namespace GameLib {
+	ThreadPool::ThreadPool(int threadCount) {
+		if (threadCount <= 0)
+			threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		for (int i = 0; i < threadCount; i++) {
+			threads_.emplace_back(&ThreadPool::_run, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		cv_.notify_all();
+		for (auto& t : threads_) {
+			t.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		pending_++;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.push_back(std::move(task));
+		}
+		cv_.notify_one();
+	}
+
+	void ThreadPool::_run() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [this] { return quit_ || !tasks_.empty(); });
+				if (tasks_.empty())
+					return;
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+			pending_--;
+		}
+	}
+} // namespace GameLib
@@ -0,0 +1,46 @@
+#ifndef GAMELIB_THREAD_POOL_HPP
+#define GAMELIB_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GameLib {
+	// ThreadPool runs queued tasks in FIFO order on a fixed set of worker threads
+	class ThreadPool {
+	public:
+		// starts threadCount workers, 0 uses one per core less one for the main thread
+		ThreadPool(int threadCount = 0);
+
+		// finishes the tasks already queued, then joins the workers
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// queues task to run on a worker thread
+		void submit(std::function<void()> task);
+
+		// returns the number of worker threads
+		int threadCount() const { return (int)threads_.size(); }
+
+		// returns the number of tasks queued or running
+		int pending() const { return pending_; }
+
+	private:
+		std::vector<std::thread> threads_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::deque<std::function<void()>> tasks_;
+		std::atomic<int> pending_{ 0 };
+		bool quit_{ false };
+
+		void _run();
+	};
+} // namespace GameLib
+
+#endif
@@ -1,28 +1,20 @@
 #include "pch.h"
 #include <gamelib_actor.hpp>
 #include <gamelib_locator.hpp>
+#include <gamelib_mapped_file.hpp>
+#include <gamelib_text_scanner.hpp>
 #include <gamelib_world.hpp>
 
 namespace GameLib {
-	namespace Tokens {
-#define WORLD_TOKENS(ENUM)                                                                                             \
-	ENUM(WORLDSIZE)                                                                                                    \
-	ENUM(WORLD)                                                                                                        \
-	ENUM(DEFINE)                                                                                                       \
-	ENUM(COLLIDE)                                                                                                      \
-	ENUM(FLAGS)
-#define ENUM_VAL(x) x,
-#define ENUM_MAP(x) { #x, Tiles::x },
-
-		enum class Tiles { WORLD_TOKENS(ENUM_VAL) };
-		std::map<std::string, Tiles> worldTokens{ WORLD_TOKENS(ENUM_MAP) };
-		std::map<char, unsigned> charToTiles{};
-		std::map<char, unsigned> charToFlags{};
-	} // namespace Tokens
-
-	World::World() { resize(worldSizeX, worldSizeY); }
+	World::World() {
+		resize(worldSizeX, worldSizeY);
+		for (int i = 0; i < 256; i++) {
+			_updateTileCache((char)i);
+		}
+	}
 
 	World::~World() {
+		stopStreaming();
 		tiles.clear();
 		collisionTiles.clear();
 		dynamicActors.clear();
@@ -32,6 +24,13 @@ namespace GameLib {
 
 	void World::resize(unsigned sizeX, unsigned sizeY) {
 		unsigned numTiles = sizeX * sizeY;
+		if (windowPagesX_) {
+			// the streamed window does not map onto the full grid
+			windowPagesX_ = 0;
+			windowPagesY_ = 0;
+			windowSlots_.clear();
+			tiles.clear();
+		}
 		tiles.resize(numTiles);
 		worldSizeX = sizeX;
 		worldSizeY = sizeY;
@@ -54,6 +53,7 @@ namespace GameLib {
 	}
 
 	void World::update(float deltaTime) {
+		HFPROFILE("World::update");
 		for (auto& actor : triggerActors) {
 			if (!actor->active)
 				continue;
@@ -72,6 +72,7 @@ namespace GameLib {
 	}
 
 	void World::physics(float deltaTime) {
+		HFPROFILE("World::physics");
 		for (auto a : staticActors) {
 			a->preupdate();
 		}
@@ -99,9 +100,13 @@ namespace GameLib {
 		}
 	}
 
-	void World::drawTiles(Graphics& graphics) { _draw(graphics); }
+	void World::drawTiles(Graphics& graphics) {
+		HFPROFILE("World::drawTiles");
+		_draw(graphics);
+	}
 
 	void World::draw(Graphics& graphics) {
+		HFPROFILE("World::draw");
 		for (auto actor : staticActors) {
 			if (!actor->active || !actor->visible)
 				continue;
@@ -135,26 +140,41 @@ namespace GameLib {
 	}
 
 
+	int World::_tileIndex(int x, int y) const {
+		if (x < 0 || y < 0 || x >= worldSizeX || y >= worldSizeY)
+			return -1;
+		if (!windowPagesX_)
+			return y * worldSizeX + x;
+		int px = x / WorldTilesX;
+		int py = y / WorldTilesY;
+		int sx = px % windowPagesX_;
+		int sy = py % windowPagesY_;
+		if (windowSlots_[sy * windowPagesX_ + sx] != py * pagesX_ + px)
+			return -1;
+		int row = sy * WorldTilesY + y - py * WorldTilesY;
+		return row * windowPagesX_ * WorldTilesX + sx * WorldTilesX + x - px * WorldTilesX;
+	}
+
 	void World::setTile(int x, int y, Tile tile) {
-		if (x >= worldSizeX || y >= worldSizeY)
+		int index = _tileIndex(x, y);
+		if (index < 0)
 			return;
-		auto index = y * worldSizeX + x;
 		tiles[index] = std::move(tile);
 	}
 
 	Tile& World::getTile(int x, int y) {
 		static Tile t;
-		if (x >= worldSizeX || y >= worldSizeY)
+		int index = _tileIndex(x, y);
+		if (index < 0)
 			return t;
-		auto index = y * worldSizeX + x;
 		return tiles[index];
 	}
 
 	const Tile& World::getTile(int x, int y) const {
 		static Tile t;
-		if (x >= worldSizeX || y >= worldSizeY)
+		int index = _tileIndex(x, y);
+		if (index < 0)
 			return t;
-		auto index = y * worldSizeX + x;
 		return tiles[index];
 	}
 
@@ -163,7 +183,9 @@ namespace GameLib {
 		int iy = (int)(CollisionTileResolution * y);
 		ix = clamp<int>(ix, 0, collisionSizeX - 1);
 		iy = clamp<int>(iy, 0, collisionSizeY - 1);
-		int index = iy * collisionSizeX + ix;
+		size_t index = iy * collisionSizeX + ix;
+		if (index >= collisionTiles.size())
+			return 0;
 		return collisionTiles[index];
 	}
 
@@ -172,63 +194,63 @@ namespace GameLib {
 		int iy = (int)(CollisionTileResolution * y);
 		ix = clamp<int>(ix, 0, collisionSizeX - 1);
 		iy = clamp<int>(iy, 0, collisionSizeY - 1);
-		int index = iy * collisionSizeX + ix;
-		collisionTiles[index] = value;
+		size_t index = iy * collisionSizeX + ix;
+		if (index < collisionTiles.size())
+			collisionTiles[index] = value;
 	}
 
 	std::istream& World::readCharStream(std::istream& s) {
-		std::string cmd;
-		s >> cmd;
-		std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
-		if (!Tokens::worldTokens.count(cmd))
-			return s;
-		Tokens::Tiles token = Tokens::worldTokens[cmd];
-
-		// ensure objects don't pass through
-		auto box2d = Locator::getBox2D();
+		std::string line;
+		std::getline(s, line);
+		readLine(line);
+		return s;
+	}
+
+	void World::readLine(std::string_view line) {
+		TextScanner scanner(line);
+		std::string_view cmd;
+		if (!scanner.token(cmd))
+			return;
 
 		char c;
 		unsigned val;
-		switch (token) {
-		case Tokens::Tiles::WORLDSIZE:
+		switch (hashToken(cmd)) {
+		case hashToken("WORLDSIZE"):
 			unsigned w, h;
-			s >> w;
-			s >> h;
-			resize(w, h);
+			if (scanner.read(w) && scanner.read(h))
+				resize(w, h);
 			break;
-		case Tokens::Tiles::WORLD:
+		case hashToken("WORLD"): {
 			int row;
-			s >> row;
-			for (int i = 0; i < worldSizeX; i++) {
-				char c;
-				s >> c;
-				unsigned tile = c;
-				if (Tokens::charToTiles.count(c)) {
-					tile = Tokens::charToTiles[tile];
-				}
-				setTile(i, row, Tile(tile, c));
-
-				unsigned flags = Tile::SOLID;
-				if (Tokens::charToFlags.count(c)) {
-					flags = Tokens::charToFlags[c];
-				}
-				getTile(i, row).flags = flags;
+			if (!scanner.read(row) || row < 0 || row >= worldSizeY)
+				break;
+			for (int i = 0; i < worldSizeX && scanner.read(c); i++) {
+				setTile(i, row, _makeTile(c));
 				_addTileToPhysics(i, row);
 			}
 			break;
-		case Tokens::Tiles::FLAGS:
-			s >> c;
-			s >> val;
-			Tokens::charToFlags[c] = val;
+		}
+		case hashToken("FLAGS"):
+			if (scanner.read(c) && scanner.read(val)) {
+				charToFlags_[c] = val;
+				_updateTileCache(c);
+			}
 			break;
-		case Tokens::Tiles::DEFINE:
-			s >> c;
-			s >> val;
-			Tokens::charToTiles[c] = val;
+		case hashToken("DEFINE"):
+			if (scanner.read(c) && scanner.read(val)) {
+				charToTiles_[c] = val;
+				_updateTileCache(c);
+			}
+			break;
+		case hashToken("COLLIDE"):
+			HFLOGWARN("cmd '%.*s' not implemented", (int)cmd.size(), cmd.data());
+			break;
+		default:
+			// lines starting with # are comments
+			if (cmd[0] != '#')
+				HFLOGWARN("unknown cmd '%.*s'", (int)cmd.size(), cmd.data());
 			break;
-		default: HFLOGWARN("cmd '%' not implemented", cmd.c_str());
 		}
-		return s;
 	}
 
 	std::ostream& World::writeCharStream(std::ostream& s) const {
@@ -271,17 +293,23 @@ namespace GameLib {
 		// world 4 #######################
 
 		std::map<unsigned int, char> cellToChar;
-		for (auto& [k, v] : Tokens::charToTiles) {
-			s << "define " << k << " " << v;
+		for (auto& [k, v] : charToTiles_) {
+			s << "define " << k << " " << v << "\n";
 			cellToChar[v] = k;
 		}
+		for (auto& [k, v] : charToFlags_) {
+			s << "flags " << k << " " << v << "\n";
+		}
 
 		s << "worldsize " << worldSizeX << " " << worldSizeY << "\n";
 		for (int y = 0; y < worldSizeY; ++y) {
 			s << "world " << std::setw(2) << y << " ";
 			for (int x = 0; x < worldSizeX; ++x) {
-				auto t = getTile(x, y);
-				if (cellToChar.count(t.spriteId)) {
+				auto& t = getTile(x, y);
+				// several characters may share a sprite, so prefer the original character
+				if (t.charDesc != '?') {
+					s << t.charDesc;
+				} else if (cellToChar.count(t.spriteId)) {
 					s << cellToChar[t.spriteId];
 				} else {
 					s << (char)t.spriteId;
@@ -304,10 +332,310 @@ namespace GameLib {
 	}
 
 	void World::_addTileToPhysics(int i, int j) {
-		auto tile = getTile(i, j);
-		if (!tile.solid())
+		Tile& tile = getTile(i, j);
+		if (!tile.solid() || deferPhysics_)
 			return;
 		auto box2d = Locator::getBox2D();
+		if (!box2d)
+			return;
 		tile.box2dId = box2d->initBody(b2_staticBody, { i + 0.5f, j + 0.5f }, { 0.45f, 0.45f }, 1.0f, 0.3f);
 	}
+
+	void World::_removeTileFromPhysics(int i, int j) {
+		Tile& tile = getTile(i, j);
+		if (tile.box2dId < 0)
+			return;
+		auto box2d = Locator::getBox2D();
+		if (box2d)
+			box2d->killBody(tile.box2dId, b2_staticBody);
+
+		// a merged box is split back into single tile bodies for the tiles that remain
+		auto it = mergedBoxes_.find(tile.box2dId);
+		tile.box2dId = -1;
+		if (it == mergedBoxes_.end())
+			return;
+		SDL_Rect box = it->second;
+		mergedBoxes_.erase(it);
+		for (int y = box.y; y < box.y + box.h; y++) {
+			for (int x = box.x; x < box.x + box.w; x++) {
+				getTile(x, y).box2dId = -1;
+				if (x != i || y != j)
+					_addTileToPhysics(x, y);
+			}
+		}
+	}
+
+	void World::copyDefines(const World& other) {
+		charToTiles_ = other.charToTiles_;
+		charToFlags_ = other.charToFlags_;
+		std::copy(std::begin(other.tileCache_), std::end(other.tileCache_), std::begin(tileCache_));
+	}
+
+	void World::_updateTileCache(char c) {
+		Tile& tile = tileCache_[(uint8_t)c];
+		tile = Tile((unsigned)c, c);
+		tile.flags = Tile::SOLID;
+		auto it = charToTiles_.find(c);
+		if (it != charToTiles_.end())
+			tile.spriteId = it->second;
+		auto flagsIt = charToFlags_.find(c);
+		if (flagsIt != charToFlags_.end())
+			tile.flags = flagsIt->second;
+	}
+
+	void World::_clearTiles() {
+		// only the stored tiles are visited, when streaming that is the resident window
+		auto box2d = Locator::getBox2D();
+		if (box2d) {
+			for (const Tile& t : tiles) {
+				if (t.box2dId >= 0 && !mergedBoxes_.count(t.box2dId))
+					box2d->killBody(t.box2dId, b2_staticBody);
+			}
+			for (auto& [id, box] : mergedBoxes_) {
+				box2d->killBody(id, b2_staticBody);
+			}
+		}
+		mergedBoxes_.clear();
+		tiles.assign(tiles.size(), Tile());
+	}
+
+	int World::reload(const std::string& filename) {
+		if (streaming())
+			return stream(filename) ? 0 : -1;
+
+		World next;
+		next.deferPhysics_ = true;
+		bool binary = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".gwb") == 0;
+		if (!(binary ? next.loadBinary(filename) : next.load(filename)))
+			return -1;
+		copyDefines(next);
+
+		int changed = 0;
+		if (windowPagesX_ || next.worldSizeX != worldSizeX || next.worldSizeY != worldSizeY) {
+			_clearTiles();
+			resize(next.worldSizeX, next.worldSizeY);
+			tiles = std::move(next.tiles);
+			for (int y = 0; y < worldSizeY; y++) {
+				for (int x = 0; x < worldSizeX; x++) {
+					_addTileToPhysics(x, y);
+				}
+			}
+			changed = worldSizeX * worldSizeY;
+		} else {
+			for (int y = 0; y < worldSizeY; y++) {
+				for (int x = 0; x < worldSizeX; x++) {
+					Tile& t = getTile(x, y);
+					const Tile& n = next.getTile(x, y);
+					if (t.spriteId == n.spriteId && t.flags == n.flags && t.charDesc == n.charDesc)
+						continue;
+					changed++;
+					if (t.solid() == n.solid()) {
+						// the body is kept, only the sprite or partial flags changed
+						int box2dId = t.box2dId;
+						t = n;
+						t.box2dId = box2dId;
+						continue;
+					}
+					_removeTileFromPhysics(x, y);
+					t = n;
+					t.box2dId = -1;
+					_addTileToPhysics(x, y);
+				}
+			}
+		}
+		HFLOGINFO("reloaded '%s', %d tiles changed", filename.c_str(), changed);
+		return changed;
+	}
+
+	void World::adoptTiles(World& next, const std::vector<SDL_Rect>& boxes) {
+		stopStreaming();
+		_clearTiles();
+		parkedActors_.clear();
+		resize(next.worldSizeX, next.worldSizeY);
+		tiles = std::move(next.tiles);
+		copyDefines(next);
+		next.resize(0, 0);
+		for (const SDL_Rect& b : boxes) {
+			_addBoxToPhysics(b.x, b.y, b.w, b.h);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////
+	// STREAMING /////////////////////////////////////////////////////
+	//////////////////////////////////////////////////////////////////
+
+	bool World::stream(const std::string& filename) {
+		stopStreaming();
+		MappedFile file;
+		if (!file.open(filename))
+			return false;
+
+		_clearTiles();
+		parkedActors_.clear();
+
+		// the header (define, flags, worldsize) is read here, rows are left for the streamer
+		// worldsize is not passed to resize() so the full grid is never allocated
+		unsigned sizeX = worldSizeX;
+		unsigned sizeY = worldSizeY;
+		TextScanner scanner(file.data(), file.size());
+		std::string_view line;
+		while (scanner.line(line)) {
+			TextScanner tokens(line);
+			std::string_view cmd;
+			if (!tokens.token(cmd))
+				continue;
+			if (hashToken(cmd) == hashToken("WORLD"))
+				break;
+			if (hashToken(cmd) == hashToken("WORLDSIZE")) {
+				unsigned w, h;
+				if (tokens.read(w) && tokens.read(h)) {
+					sizeX = w;
+					sizeY = h;
+				}
+				continue;
+			}
+			readLine(line);
+		}
+
+		worldSizeX = sizeX;
+		worldSizeY = sizeY;
+		pagesX_ = (worldSizeX + WorldTilesX - 1) / WorldTilesX;
+		pagesY_ = (worldSizeY + WorldTilesY - 1) / WorldTilesY;
+		pageStates_.assign(pagesX_ * pagesY_, PAGE_EMPTY);
+
+		// every resident page is within windowRadius_ of the center, so no two share a slot
+		windowRadius_ = std::max(pageEvictRadius, 0);
+		windowPagesX_ = std::min(pagesX_, 2 * windowRadius_ + 1);
+		windowPagesY_ = std::min(pagesY_, 2 * windowRadius_ + 1);
+		windowSlots_.assign(windowPagesX_ * windowPagesY_, -1);
+		tiles = std::vector<Tile>((size_t)windowPagesX_ * WorldTilesX * windowPagesY_ * WorldTilesY);
+		collisionTiles = std::vector<uint8_t>();
+
+		if (!streamer_)
+			streamer_ = std::make_unique<WorldStreamer>();
+		if (!streamer_->open(filename, worldSizeX, worldSizeY))
+			return false;
+		HFLOGINFO("streaming '%s' (%dx%d pages)", filename.c_str(), pagesX_, pagesY_);
+		return true;
+	}
+
+	void World::stopStreaming() {
+		if (streamer_)
+			streamer_->close();
+	}
+
+	bool World::pageResident(int px, int py) const {
+		if (px < 0 || py < 0 || px >= pagesX_ || py >= pagesY_)
+			return false;
+		return pageStates_[py * pagesX_ + px] == PAGE_RESIDENT;
+	}
+
+	void World::updateStreaming(glm::vec2 center) {
+		if (!streaming())
+			return;
+
+		int cx = (int)std::floor(center.x / WorldTilesX);
+		int cy = (int)std::floor(center.y / WorldTilesY);
+		int evictRadius = std::min(pageEvictRadius, windowRadius_);
+		int loadRadius = std::min(pageLoadRadius, evictRadius);
+		auto distance = [cx, cy](int px, int py) { return std::max(std::abs(px - cx), std::abs(py - cy)); };
+
+		// resident pages are exactly the ones held by the window slots
+		for (size_t i = 0; i < windowSlots_.size(); i++) {
+			int pageIndex = windowSlots_[i];
+			if (pageIndex < 0 || distance(pageIndex % pagesX_, pageIndex / pagesX_) <= evictRadius)
+				continue;
+			_evictPage(pageIndex % pagesX_, pageIndex / pagesX_);
+			pageStates_[pageIndex] = PAGE_EMPTY;
+		}
+
+		for (int py = std::max(cy - loadRadius, 0); py <= std::min(cy + loadRadius, pagesY_ - 1); py++) {
+			for (int px = std::max(cx - loadRadius, 0); px <= std::min(cx + loadRadius, pagesX_ - 1); px++) {
+				uint8_t& state = pageStates_[py * pagesX_ + px];
+				if (state != PAGE_EMPTY)
+					continue;
+				streamer_->request(px, py);
+				state = PAGE_REQUESTED;
+			}
+		}
+
+		std::vector<WORLDPAGE> pages;
+		if (!streamer_->poll(pages))
+			return;
+		for (auto& page : pages) {
+			uint8_t& state = pageStates_[page.py * pagesX_ + page.px];
+			if (state != PAGE_REQUESTED)
+				continue;
+			// the center moved away while the page was loading, it is requested again when needed
+			if (distance(page.px, page.py) > evictRadius) {
+				state = PAGE_EMPTY;
+				continue;
+			}
+			_installPage(page);
+			state = PAGE_RESIDENT;
+		}
+	}
+
+	void World::_installPage(const WORLDPAGE& page) {
+		int slot = (page.py % windowPagesY_) * windowPagesX_ + page.px % windowPagesX_;
+		int previous = windowSlots_[slot];
+		if (previous >= 0) {
+			_evictPage(previous % pagesX_, previous / pagesX_);
+			pageStates_[previous] = PAGE_EMPTY;
+		}
+		windowSlots_[slot] = page.py * pagesX_ + page.px;
+
+		int x0 = page.px * WorldTilesX;
+		int y0 = page.py * WorldTilesY;
+		for (int j = 0; j < WorldTilesY; j++) {
+			int y = y0 + j;
+			if (y >= worldSizeY)
+				break;
+			for (int i = 0; i < WorldTilesX; i++) {
+				int x = x0 + i;
+				char c = page.chars[j * WorldTilesX + i];
+				if (x >= worldSizeX || c == '\0')
+					continue;
+				setTile(x, y, _makeTile(c));
+				_addTileToPhysics(x, y);
+			}
+		}
+
+		int pageIndex = page.py * pagesX_ + page.px;
+		auto it = parkedActors_.find(pageIndex);
+		if (it != parkedActors_.end()) {
+			for (auto& a : it->second)
+				a->active = true;
+			parkedActors_.erase(it);
+		}
+	}
+
+	void World::_evictPage(int px, int py) {
+		int x0 = px * WorldTilesX;
+		int y0 = py * WorldTilesY;
+		int x1 = std::min(x0 + WorldTilesX, worldSizeX);
+		int y1 = std::min(y0 + WorldTilesY, worldSizeY);
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				_removeTileFromPhysics(x, y);
+				setTile(x, y, Tile());
+			}
+		}
+
+		// static and trigger actors sleep until their page returns
+		auto& parked = parkedActors_[py * pagesX_ + px];
+		auto park = [&](std::vector<ActorPtr>& actors) {
+			for (auto& a : actors) {
+				glm::vec3 c = a->center();
+				if (!a->active || c.x < x0 || c.x >= x1 || c.y < y0 || c.y >= y1)
+					continue;
+				a->active = false;
+				parked.push_back(a);
+			}
+		};
+		park(staticActors);
+		park(triggerActors);
+
+		windowSlots_[(py % windowPagesY_) * windowPagesX_ + px % windowPagesX_] = -1;
+	}
 } // namespace GameLib
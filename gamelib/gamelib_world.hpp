@@ -3,6 +3,7 @@
 
 #include <gamelib_graphics.hpp>
 #include <gamelib_object.hpp>
+#include <gamelib_world_streamer.hpp>
 
 namespace GameLib {
 	// number of screens in the X direction
@@ -68,8 +69,56 @@ namespace GameLib {
 		void setCollisionTile(float x, float y, int value);
 
 		std::istream& readCharStream(std::istream& s) override;
+		void readLine(std::string_view line) override;
 		std::ostream& writeCharStream(std::ostream& s) const override;
 
+		// loads a world saved by writeBinary() by mapping it into memory, no text is parsed
+		bool loadBinary(const std::string& filename);
+
+		// saves the world in the versioned binary world format, fails for worlds over 65535 tiles wide or high
+		bool writeBinary(const std::string& filename) const;
+
+		// reloads a text or binary world file and updates only the tiles that changed, along
+		// with their physics bodies. Returns the number of changed tiles, or -1 on failure
+		int reload(const std::string& filename);
+
+		// merges solid tiles into rectangles, binary worlds store these and create one body per rectangle
+		std::vector<SDL_Rect> solidBoxes() const;
+
+		// replaces the tiles of this world with the tiles of next and creates a body for each box,
+		// the old tiles and their bodies are removed but actors are kept. next is left empty
+		void adoptTiles(World& next, const std::vector<SDL_Rect>& boxes);
+
+		// replaces the define and flags tables with those of other
+		void copyDefines(const World& other);
+
+		// when set, tiles are loaded without physics bodies, e.g. when loading off the main thread
+		void deferPhysics(bool defer) { deferPhysics_ = defer; }
+
+		// reads the header of the world file and streams pages in on a background thread
+		// only the pages within pageEvictRadius of the center are kept in memory
+		bool stream(const std::string& filename);
+
+		// stops streaming, resident pages stay in the world
+		void stopStreaming();
+
+		// returns true if pages are being streamed
+		bool streaming() const { return streamer_ && streamer_->isOpen(); }
+
+		// requests pages near center (in tiles), evicts far pages, and installs loaded pages
+		// this must be called at a frame boundary, e.g. before updating the world
+		void updateStreaming(glm::vec2 center);
+
+		// returns true if page (px, py) is installed in the world
+		bool pageResident(int px, int py) const;
+
+		// pages within this many pages of the center are loaded
+		int pageLoadRadius{ 1 };
+
+		// pages further than this many pages from the center are evicted, this also sets the
+		// size of the resident window when stream() is called
+		int pageEvictRadius{ 2 };
+
 		std::vector<Tile> tiles;
 		std::vector<uint8_t> collisionTiles;
 
@@ -109,6 +158,58 @@ namespace GameLib {
 	protected:
 		virtual void _draw(Graphics& g);
 		virtual void _addTileToPhysics(int x, int y);
+		virtual void _removeTileFromPhysics(int x, int y);
+		// adds one static body covering w x h tiles, all covered tiles share its box2dId
+		virtual void _addBoxToPhysics(int x, int y, int w, int h);
+
+		// converts a world file character to a tile using the define and flags commands
+		const Tile& _makeTile(char c) const { return tileCache_[(uint8_t)c]; }
+
+		// sprite ids set with the define command
+		std::map<char, unsigned> charToTiles_;
+		// tile flags set with the flags command
+		std::map<char, unsigned> charToFlags_;
+		// charToTiles_ and charToFlags_ flattened for every character
+		Tile tileCache_[256];
+
+		// updates the tile cache entry for c after a define or flags command
+		void _updateTileCache(char c);
+
+		// removes all tiles and their physics bodies
+		void _clearTiles();
+
+		// returns the index of tile (x, y) in tiles, or -1 if it is outside the world or its page is not resident
+		int _tileIndex(int x, int y) const;
+
+		// when set, tiles are loaded without physics bodies
+		bool deferPhysics_{ false };
+		// bodies added by _addBoxToPhysics, keyed by box2dId
+		std::map<int, SDL_Rect> mergedBoxes_;
+
+		// copies a streamed page into the tile grid and physics world
+		virtual void _installPage(const WORLDPAGE& page);
+		// removes a page from the tile grid and physics world
+		virtual void _evictPage(int px, int py);
+
+		static constexpr uint8_t PAGE_EMPTY = 0;
+		static constexpr uint8_t PAGE_REQUESTED = 1;
+		static constexpr uint8_t PAGE_RESIDENT = 2;
+
+		std::unique_ptr<WorldStreamer> streamer_;
+		int pagesX_{ 0 };
+		int pagesY_{ 0 };
+		std::vector<uint8_t> pageStates_;
+
+		// while streaming, tiles only holds a window of windowPagesX_ x windowPagesY_ pages
+		// page (px, py) is stored in slot (px % windowPagesX_, py % windowPagesY_), 0 if not streamed
+		int windowPagesX_{ 0 };
+		int windowPagesY_{ 0 };
+		// the largest evict radius that fits in the window
+		int windowRadius_{ 0 };
+		// the page index held by each slot, -1 if the slot is empty
+		std::vector<int> windowSlots_;
+		// static and trigger actors deactivated because their page was evicted
+		std::map<int, std::vector<ActorPtr>> parkedActors_;
 	};
 } // namespace GameLib
 
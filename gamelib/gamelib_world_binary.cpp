@@ -0,0 +1,224 @@
+#include "pch.h"
+#include <gamelib_locator.hpp>
+#include <gamelib_mapped_file.hpp>
+#include <gamelib_world.hpp>
+#include <cstring>
+
+namespace GameLib {
+	// Binary world format (little endian)
+	// WORLDBINHEADER
+	// int32[256]   sprite id for each DEFINE'd character, -1 if undefined
+	// int32[256]   flags for each FLAGS'd character, -1 if undefined
+	// uint32[N]    sprite ids, N = sizeX * sizeY, row major
+	// uint8[N]     tile flags
+	// char[N]      original characters
+	// BOX[boxCount] solid tiles merged into rectangles for Box2D, so worlds are at most MaxSize tiles wide and high
+	// Every array starts on an 8 byte boundary.
+	namespace Binary {
+		constexpr char MAGIC[4] = { 'G', 'L', 'W', 'B' };
+		constexpr uint32_t VERSION = 1;
+
+		struct WORLDBINHEADER {
+			char magic[4];
+			uint32_t version;
+			uint32_t sizeX;
+			uint32_t sizeY;
+			uint32_t boxCount;
+			uint32_t reserved;
+			uint64_t definesOffset;
+			uint64_t flagDefinesOffset;
+			uint64_t spritesOffset;
+			uint64_t flagsOffset;
+			uint64_t charsOffset;
+			uint64_t boxesOffset;
+		};
+
+		struct BOX {
+			uint16_t x;
+			uint16_t y;
+			uint16_t w;
+			uint16_t h;
+		};
+
+		constexpr int MaxSize = UINT16_MAX;
+
+		inline uint64_t align8(uint64_t x) { return (x + 7) & ~uint64_t(7); }
+	} // namespace Binary
+
+	bool World::loadBinary(const std::string& filename) {
+		HFPROFILE("World::loadBinary");
+		using namespace Binary;
+		MappedFile file;
+		if (!file.open(filename))
+			return false;
+
+		const WORLDBINHEADER* header = file.at<WORLDBINHEADER>(0);
+		if (!header || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+			HFLOGERROR("'%s' is not a binary world", filename.c_str());
+			return false;
+		}
+		if (header->version != VERSION) {
+			HFLOGERROR("'%s' is version %u, expected %u", filename.c_str(), header->version, VERSION);
+			return false;
+		}
+
+		size_t count = (size_t)header->sizeX * header->sizeY;
+		const int32_t* defines = file.at<int32_t>(header->definesOffset, 256);
+		const int32_t* flagDefines = file.at<int32_t>(header->flagDefinesOffset, 256);
+		const uint32_t* sprites = file.at<uint32_t>(header->spritesOffset, count);
+		const uint8_t* flags = file.at<uint8_t>(header->flagsOffset, count);
+		const char* chars = file.at<char>(header->charsOffset, count);
+		const BOX* boxes = file.at<BOX>(header->boxesOffset, header->boxCount);
+		if (!defines || !flagDefines || !sprites || !flags || !chars || (header->boxCount && !boxes)) {
+			HFLOGERROR("'%s' is truncated", filename.c_str());
+			return false;
+		}
+		// a box outside the world would write its body id into the dummy tile getTile() returns
+		for (uint32_t i = 0; i < header->boxCount; i++) {
+			const BOX& b = boxes[i];
+			if ((uint32_t)b.x + b.w > header->sizeX || (uint32_t)b.y + b.h > header->sizeY) {
+				HFLOGERROR("'%s' has a box outside the world", filename.c_str());
+				return false;
+			}
+		}
+
+		stopStreaming();
+		_clearTiles();
+
+		charToTiles_.clear();
+		charToFlags_.clear();
+		for (int i = 0; i < 256; i++) {
+			if (defines[i] >= 0)
+				charToTiles_[(char)i] = (unsigned)defines[i];
+			if (flagDefines[i] >= 0)
+				charToFlags_[(char)i] = (unsigned)flagDefines[i];
+		}
+		for (int i = 0; i < 256; i++) {
+			_updateTileCache((char)i);
+		}
+
+		resize(header->sizeX, header->sizeY);
+		for (size_t i = 0; i < count; i++) {
+			Tile& t = tiles[i];
+			t.spriteId = sprites[i];
+			t.charDesc = chars[i];
+			t.flags = flags[i];
+			t.box2dId = -1;
+		}
+
+		for (uint32_t i = 0; i < header->boxCount; i++) {
+			const BOX& b = boxes[i];
+			_addBoxToPhysics(b.x, b.y, b.w, b.h);
+		}
+		return true;
+	}
+
+	bool World::writeBinary(const std::string& filename) const {
+		using namespace Binary;
+		if (worldSizeX > MaxSize || worldSizeY > MaxSize) {
+			HFLOGERROR("%dx%d is too large for a binary world, at most %dx%d", worldSizeX, worldSizeY, MaxSize, MaxSize);
+			return false;
+		}
+		std::ofstream fout(filename, std::ios::binary);
+		if (!fout)
+			return false;
+
+		std::vector<BOX> boxes;
+		for (const SDL_Rect& r : solidBoxes()) {
+			boxes.push_back({ (uint16_t)r.x, (uint16_t)r.y, (uint16_t)r.w, (uint16_t)r.h });
+		}
+
+		size_t count = (size_t)worldSizeX * worldSizeY;
+		WORLDBINHEADER header{};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.sizeX = worldSizeX;
+		header.sizeY = worldSizeY;
+		header.boxCount = (uint32_t)boxes.size();
+		header.definesOffset = align8(sizeof(WORLDBINHEADER));
+		header.flagDefinesOffset = align8(header.definesOffset + 256 * sizeof(int32_t));
+		header.spritesOffset = align8(header.flagDefinesOffset + 256 * sizeof(int32_t));
+		header.flagsOffset = align8(header.spritesOffset + count * sizeof(uint32_t));
+		header.charsOffset = align8(header.flagsOffset + count);
+		header.boxesOffset = align8(header.charsOffset + count);
+
+		std::vector<int32_t> defines(256, -1);
+		std::vector<int32_t> flagDefines(256, -1);
+		for (auto& [k, v] : charToTiles_)
+			defines[(uint8_t)k] = (int32_t)v;
+		for (auto& [k, v] : charToFlags_)
+			flagDefines[(uint8_t)k] = (int32_t)v;
+
+		std::vector<uint32_t> sprites(count);
+		std::vector<uint8_t> flags(count);
+		std::vector<char> chars(count);
+		for (size_t i = 0; i < count; i++) {
+			// getTile() also covers streamed worlds, where tiles only holds the resident pages
+			const Tile& t = getTile((int)(i % worldSizeX), (int)(i / worldSizeX));
+			sprites[i] = t.spriteId;
+			flags[i] = (uint8_t)t.flags;
+			chars[i] = t.charDesc;
+		}
+
+		auto writeAt = [&fout](uint64_t offset, const void* data, size_t size) {
+			static const char zeros[8] = { 0 };
+			uint64_t pos = (uint64_t)fout.tellp();
+			if (offset > pos)
+				fout.write(zeros, offset - pos);
+			fout.write(static_cast<const char*>(data), size);
+		};
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.definesOffset, defines.data(), defines.size() * sizeof(int32_t));
+		writeAt(header.flagDefinesOffset, flagDefines.data(), flagDefines.size() * sizeof(int32_t));
+		writeAt(header.spritesOffset, sprites.data(), count * sizeof(uint32_t));
+		writeAt(header.flagsOffset, flags.data(), count);
+		writeAt(header.charsOffset, chars.data(), count);
+		writeAt(header.boxesOffset, boxes.data(), boxes.size() * sizeof(BOX));
+		return (bool)fout;
+	}
+
+	std::vector<SDL_Rect> World::solidBoxes() const {
+		// merge horizontal runs of solid tiles, then stack identical runs
+		std::vector<SDL_Rect> boxes;
+		std::map<std::pair<int, int>, size_t> open;
+		for (int y = 0; y < worldSizeY; y++) {
+			std::map<std::pair<int, int>, size_t> next;
+			for (int x = 0; x < worldSizeX;) {
+				if (!getTile(x, y).solid()) {
+					x++;
+					continue;
+				}
+				int x0 = x;
+				while (x < worldSizeX && getTile(x, y).solid())
+					x++;
+				std::pair<int, int> run{ x0, x - x0 };
+				auto it = open.find(run);
+				if (it != open.end()) {
+					boxes[it->second].h++;
+					next[run] = it->second;
+				} else {
+					next[run] = boxes.size();
+					boxes.push_back({ x0, y, x - x0, 1 });
+				}
+			}
+			open = std::move(next);
+		}
+		return boxes;
+	}
+
+	void World::_addBoxToPhysics(int x, int y, int w, int h) {
+		auto box2d = Locator::getBox2D();
+		if (!box2d || deferPhysics_)
+			return;
+		glm::vec2 halfSize{ w * 0.5f, h * 0.5f };
+		glm::vec2 center{ x + halfSize.x, y + halfSize.y };
+		// keep the same 0.05 gap on each side as single tiles
+		int id = box2d->initBody(b2_staticBody, center, halfSize - 0.05f, 1.0f, 0.3f);
+		for (int j = y; j < y + h; j++) {
+			for (int i = x; i < x + w; i++) {
+				getTile(i, j).box2dId = id;
+			}
+		}
+		mergedBoxes_[id] = { x, y, w, h };
+	}
+} // namespace GameLib
@@ -0,0 +1,135 @@
+#include "pch.h"
+#include <gamelib_text_scanner.hpp>
+#include <gamelib_world.hpp>
+#include <gamelib_world_streamer.hpp>
+
+namespace GameLib {
+	WorldStreamer::WorldStreamer() {}
+
+	WorldStreamer::~WorldStreamer() { close(); }
+
+	bool WorldStreamer::open(const std::string& path, int sizeX, int sizeY) {
+		close();
+		std::ifstream fin(path);
+		if (!fin)
+			return false;
+		path_ = path;
+		sizeX_ = sizeX;
+		sizeY_ = sizeY;
+		rows_.assign(sizeY_, {});
+		scanned_ = 0;
+		rowsStarted_ = false;
+		quit_ = false;
+		thread_ = std::thread(&WorldStreamer::_run, this);
+		return true;
+	}
+
+	void WorldStreamer::close() {
+		if (!thread_.joinable())
+			return;
+		quit_ = true;
+		cv_.notify_all();
+		thread_.join();
+		std::lock_guard<std::mutex> lock(mutex_);
+		requests_.clear();
+		completed_.clear();
+		rows_.clear();
+	}
+
+	void WorldStreamer::request(int px, int py) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			requests_.push_back({ px, py });
+		}
+		cv_.notify_one();
+	}
+
+	int WorldStreamer::poll(std::vector<WORLDPAGE>& pages) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		int count = (int)completed_.size();
+		for (auto& page : completed_) {
+			pages.push_back(std::move(page));
+		}
+		completed_.clear();
+		return count;
+	}
+
+	void WorldStreamer::_run() {
+		Hf::Profiler.setThreadName("WorldStreamer");
+		MappedFile file;
+		if (!file.open(path_)) {
+			HFLOGERROR("'%s' could not be opened for streaming", path_.c_str());
+			return;
+		}
+
+		while (!quit_) {
+			std::pair<int, int> p;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [this] { return quit_ || !requests_.empty(); });
+				if (quit_)
+					break;
+				p = requests_.front();
+				requests_.pop_front();
+			}
+
+			WORLDPAGE page;
+			page.px = p.first;
+			page.py = p.second;
+			_loadPage(file, page);
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			completed_.push_back(std::move(page));
+		}
+	}
+
+	std::string_view WorldStreamer::_findRow(const MappedFile& file, int row) {
+		TextScanner scanner(file.data() + scanned_, file.size() - scanned_);
+		std::string_view line;
+		while (rows_[row].empty() && !quit_ && scanner.line(line)) {
+			scanned_ = scanner.rest().data() - file.data();
+			// only "world N ..." rows are indexed, "worldsize" is part of the header
+			TextScanner tokens(line);
+			std::string_view cmd;
+			if (!tokens.token(cmd) || cmd[0] == '#')
+				continue;
+			int n;
+			if (hashToken(cmd) == hashToken("WORLD") && tokens.read(n)) {
+				rowsStarted_ = true;
+				if (n >= 0 && n < sizeY_)
+					rows_[n] = line;
+			} else if (rowsStarted_) {
+				// World::stream() only reads the commands before the first row
+				HFLOGWARN("'%s': '%.*s' after the world rows is ignored when streaming", path_.c_str(), (int)std::min<size_t>(line.size(), 32), line.data());
+			}
+		}
+		return rows_[row];
+	}
+
+	void WorldStreamer::_loadPage(const MappedFile& file, WORLDPAGE& page) {
+		HFPROFILE("WorldStreamer::loadPage");
+		page.chars.assign(WorldTilesX * WorldTilesY, '\0');
+		int x0 = page.px * WorldTilesX;
+		int y0 = page.py * WorldTilesY;
+		for (int j = 0; j < WorldTilesY; j++) {
+			int row = y0 + j;
+			if (row >= sizeY_)
+				break;
+			std::string_view text = _findRow(file, row);
+			if (text.empty())
+				continue;
+
+			// skip the "world" and row number tokens like World::readLine does
+			TextScanner scanner(text);
+			std::string_view cmd;
+			int n;
+			scanner.token(cmd);
+			scanner.read(n);
+			char c;
+			for (int x = 0; x < x0 + WorldTilesX && scanner.read(c); x++) {
+				if (x >= x0)
+					page.chars[j * WorldTilesX + x - x0] = c;
+			}
+		}
+	}
+} // namespace GameLib
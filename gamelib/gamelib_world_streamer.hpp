@@ -0,0 +1,67 @@
+#ifndef GAMELIB_WORLD_STREAMER_HPP
+#define GAMELIB_WORLD_STREAMER_HPP
+
+#include <gamelib_base.hpp>
+#include <gamelib_mapped_file.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string_view>
+
+namespace GameLib {
+	// WORLDPAGE holds the raw tile characters of one page of the world
+	struct WORLDPAGE {
+		int px{ 0 };
+		int py{ 0 };
+		// WorldTilesX * WorldTilesY characters, row major, '\0' if past the end of a row
+		std::vector<char> chars;
+	};
+
+	// WorldStreamer reads pages of a world file on a background I/O thread
+	class WorldStreamer {
+	public:
+		WorldStreamer();
+		~WorldStreamer();
+
+		// starts the I/O thread for the world file at path, the header has already been read
+		bool open(const std::string& path, int sizeX, int sizeY);
+
+		// stops the I/O thread and drops any queued or completed pages
+		void close();
+
+		// returns true if the I/O thread is running
+		bool isOpen() const { return thread_.joinable(); }
+
+		// queues page (px, py) for loading
+		void request(int px, int py);
+
+		// moves completed pages into pages, returns the number of pages moved
+		int poll(std::vector<WORLDPAGE>& pages);
+
+	private:
+		std::string path_;
+		int sizeX_{ 0 };
+		int sizeY_{ 0 };
+
+		std::thread thread_;
+		std::atomic<bool> quit_{ false };
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::deque<std::pair<int, int>> requests_;
+		std::vector<WORLDPAGE> completed_;
+
+		// the text of each "world N" line found so far, empty if the row has not been reached
+		std::vector<std::string_view> rows_;
+		// rows are indexed on demand, the file has been scanned up to this offset
+		size_t scanned_{ 0 };
+		bool rowsStarted_{ false };
+
+		void _run();
+		// scans the file until row is indexed or the end is reached, returns the row or an empty view
+		std::string_view _findRow(const MappedFile& file, int row);
+		void _loadPage(const MappedFile& file, WORLDPAGE& page);
+	};
+} // namespace GameLib
+
+#endif
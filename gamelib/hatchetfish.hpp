@@ -1,7 +1,10 @@
 #ifndef HATCHETFISH_HPP
 #define HATCHETFISH_HPP
 
+#include <hatchetfish_alloc_tracker.hpp>
+#include <hatchetfish_histogram.hpp>
 #include <hatchetfish_log.hpp>
+#include <hatchetfish_profiler.hpp>
 #include <hatchetfish_stopwatch.hpp>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,260 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017-2019 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#include "pch.h"
+#include <hatchetfish_alloc_tracker.hpp>
+#include <hatchetfish_profiler.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define HFALLOC_BACKTRACE 1
+#elif defined(_WIN32)
+#include <windows.h>
+#define HFALLOC_BACKTRACE 1
+#endif
+
+namespace Hf {
+    namespace {
+        // the block size is stored in front of each allocation, this keeps malloc's alignment
+        constexpr size_t HeaderSize = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+        std::atomic<bool> hooked{ false };
+        std::atomic<bool> enabled{ false };
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> frees{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> freedBytes{ 0 };
+        uint64_t enabledAllocations{ 0 };
+
+        // set while the tracker itself runs, so its own allocations are not counted
+        thread_local bool inside = false;
+
+        // zones are found by pointer with linear probing, the last slot collects any overflow
+        constexpr int ZoneSlots = 256;
+        struct ZONESLOT {
+            std::atomic<const char*> name{ nullptr };
+            std::atomic<uint64_t> allocations{ 0 };
+            std::atomic<uint64_t> bytes{ 0 };
+        };
+        ZONESLOT zoneSlots[ZoneSlots];
+        const char* const NoZone = "(no zone)";
+        const char* const OtherZones = "(other zones)";
+
+        constexpr int MaxSamples = 64;
+        constexpr int SampleDepth = 16;
+        struct SAMPLE {
+            size_t size{ 0 };
+            const char* zone{ nullptr };
+            int depth{ 0 };
+            void* frames[SampleDepth];
+        };
+        std::mutex sampleMutex;
+        SAMPLE samples[MaxSamples];
+        int sampleCount{ 0 };
+        int nextSample{ 0 };
+        std::atomic<int> sampleInterval{ 0 };
+        std::atomic<uint64_t> sampleCounter{ 0 };
+
+        AllocTracker::FRAMESTATS lastFrameStats;
+        AllocTracker::FRAMESTATS frameStart;
+        std::vector<AllocTracker::ZONESTATS> lastZones;
+
+        ZONESLOT& zoneSlot(const char* name) {
+            size_t i = (reinterpret_cast<uintptr_t>(name) >> 3) % (ZoneSlots - 1);
+            for (int probe = 0; probe < ZoneSlots - 1; probe++, i = (i + 1) % (ZoneSlots - 1)) {
+                const char* slotName = zoneSlots[i].name.load(std::memory_order_acquire);
+                if (slotName == name)
+                    return zoneSlots[i];
+                if (!slotName) {
+                    const char* expected = nullptr;
+                    if (zoneSlots[i].name.compare_exchange_strong(expected, name) || expected == name)
+                        return zoneSlots[i];
+                }
+            }
+            zoneSlots[ZoneSlots - 1].name = OtherZones;
+            return zoneSlots[ZoneSlots - 1];
+        }
+
+        void sample(size_t size, const char* zone) {
+            SAMPLE s;
+            s.size = size;
+            s.zone = zone;
+#if defined(_WIN32)
+            s.depth = CaptureStackBackTrace(2, SampleDepth, s.frames, nullptr);
+#elif defined(HFALLOC_BACKTRACE)
+            s.depth = backtrace(s.frames, SampleDepth);
+#endif
+            std::lock_guard<std::mutex> lock(sampleMutex);
+            samples[nextSample] = s;
+            nextSample = (nextSample + 1) % MaxSamples;
+            sampleCount = std::min(sampleCount + 1, MaxSamples);
+        }
+
+        void record(size_t size) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(size, std::memory_order_relaxed);
+            const char* zone = FrameProfiler::currentZone();
+            ZONESLOT& slot = zoneSlot(zone ? zone : NoZone);
+            slot.allocations.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_add(size, std::memory_order_relaxed);
+            int interval = sampleInterval.load(std::memory_order_relaxed);
+            if (interval > 0 && sampleCounter.fetch_add(1, std::memory_order_relaxed) % interval == 0)
+                sample(size, zone);
+        }
+    } // namespace
+
+    void* AllocTracker::allocate(std::size_t size, const std::nothrow_t&) noexcept {
+        if (!hooked.load(std::memory_order_relaxed))
+            hooked = true;
+        char* block = (char*)malloc(size + HeaderSize);
+        if (!block)
+            return nullptr;
+        memcpy(block, &size, sizeof(size));
+        if (enabled.load(std::memory_order_relaxed) && !inside) {
+            inside = true;
+            record(size);
+            inside = false;
+        }
+        return block + HeaderSize;
+    }
+
+    void* AllocTracker::allocate(std::size_t size) {
+        void* p = allocate(size, std::nothrow);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void AllocTracker::deallocate(void* p) noexcept {
+        if (!p)
+            return;
+        char* block = (char*)p - HeaderSize;
+        if (enabled.load(std::memory_order_relaxed) && !inside) {
+            size_t size;
+            memcpy(&size, block, sizeof(size));
+            frees.fetch_add(1, std::memory_order_relaxed);
+            freedBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        free(block);
+    }
+
+    bool AllocTracker::hooksInstalled() { return hooked; }
+
+    void AllocTracker::enable() {
+        if (enabled)
+            return;
+        enabledAllocations = allocations;
+        frameStart.allocations = allocations;
+        frameStart.frees = frees;
+        frameStart.bytes = bytes;
+        frameStart.freedBytes = freedBytes;
+        enabled = true;
+    }
+
+    void AllocTracker::disable() { enabled = false; }
+
+    bool AllocTracker::isEnabled() { return enabled; }
+
+    void AllocTracker::frame() {
+        inside = true;
+        FRAMESTATS now;
+        now.allocations = allocations;
+        now.frees = frees;
+        now.bytes = bytes;
+        now.freedBytes = freedBytes;
+        lastFrameStats.frame++;
+        lastFrameStats.allocations = now.allocations - frameStart.allocations;
+        lastFrameStats.frees = now.frees - frameStart.frees;
+        lastFrameStats.bytes = now.bytes - frameStart.bytes;
+        lastFrameStats.freedBytes = now.freedBytes - frameStart.freedBytes;
+        frameStart = now;
+
+        if (lastZones.capacity() < ZoneSlots)
+            lastZones.reserve(ZoneSlots);
+        lastZones.clear();
+        for (auto& slot : zoneSlots) {
+            const char* name = slot.name.load(std::memory_order_acquire);
+            if (!name)
+                continue;
+            ZONESTATS zone;
+            zone.name = name;
+            zone.allocations = slot.allocations.exchange(0, std::memory_order_relaxed);
+            zone.bytes = slot.bytes.exchange(0, std::memory_order_relaxed);
+            if (!zone.allocations)
+                continue;
+            // one name can have several slots when the same text is a different pointer
+            auto it = std::find_if(lastZones.begin(), lastZones.end(), [&](const ZONESTATS& z) { return strcmp(z.name, name) == 0; });
+            if (it != lastZones.end()) {
+                it->allocations += zone.allocations;
+                it->bytes += zone.bytes;
+            } else {
+                lastZones.push_back(zone);
+            }
+        }
+        std::sort(lastZones.begin(), lastZones.end(), [](const ZONESTATS& a, const ZONESTATS& b) { return a.allocations > b.allocations; });
+        inside = false;
+    }
+
+    const AllocTracker::FRAMESTATS& AllocTracker::lastFrame() { return lastFrameStats; }
+
+    const std::vector<AllocTracker::ZONESTATS>& AllocTracker::lastFrameZones() { return lastZones; }
+
+    uint64_t AllocTracker::totalAllocations() { return allocations - enabledAllocations; }
+
+    void AllocTracker::setSampleInterval(int n) { sampleInterval = std::max(n, 0); }
+
+    void AllocTracker::clearSamples() {
+        std::lock_guard<std::mutex> lock(sampleMutex);
+        sampleCount = 0;
+        nextSample = 0;
+    }
+
+    void AllocTracker::report(FILE* fout) {
+        bool wasInside = inside;
+        inside = true;
+        fprintf(fout,
+                "frame %llu: %llu allocations, %llu frees, %llu bytes allocated, %llu bytes freed\n",
+                (unsigned long long)lastFrameStats.frame,
+                (unsigned long long)lastFrameStats.allocations,
+                (unsigned long long)lastFrameStats.frees,
+                (unsigned long long)lastFrameStats.bytes,
+                (unsigned long long)lastFrameStats.freedBytes);
+        for (auto& zone : lastZones)
+            fprintf(fout, "    %-32s %8llu allocations %10llu bytes\n", zone.name, (unsigned long long)zone.allocations, (unsigned long long)zone.bytes);
+
+        std::lock_guard<std::mutex> lock(sampleMutex);
+        for (int i = 0; i < sampleCount; i++) {
+            const SAMPLE& s = samples[(nextSample - sampleCount + i + MaxSamples) % MaxSamples];
+            fprintf(fout, "sample %d: %llu bytes in %s\n", i, (unsigned long long)s.size, s.zone ? s.zone : NoZone);
+            fflush(fout);
+#if defined(HFALLOC_BACKTRACE) && !defined(_WIN32)
+            // backtrace_symbols_fd() writes straight to the file without allocating
+            backtrace_symbols_fd(s.frames, s.depth, fileno(fout));
+#else
+            for (int f = 0; f < s.depth; f++)
+                fprintf(fout, "    %p\n", s.frames[f]);
+#endif
+        }
+        fflush(fout);
+        inside = wasInside;
+    }
+}
@@ -0,0 +1,94 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#ifndef HATCHETFISH_ALLOC_TRACKER_HPP
+#define HATCHETFISH_ALLOC_TRACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <vector>
+
+// Defines the global operator new and delete so they report to Hf::AllocTracker. Use it once, at
+// file scope in one source file of the program, to opt in to allocation tracking
+#define HFALLOC_TRACKER_HOOKS()                                                                                                                                \
+    void* operator new(std::size_t size) { return Hf::AllocTracker::allocate(size); }                                                                          \
+    void* operator new[](std::size_t size) { return Hf::AllocTracker::allocate(size); }                                                                        \
+    void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Hf::AllocTracker::allocate(size, std::nothrow); }                          \
+    void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Hf::AllocTracker::allocate(size, std::nothrow); }                        \
+    void operator delete(void* p) noexcept { Hf::AllocTracker::deallocate(p); }                                                                               \
+    void operator delete[](void* p) noexcept { Hf::AllocTracker::deallocate(p); }                                                                             \
+    void operator delete(void* p, std::size_t) noexcept { Hf::AllocTracker::deallocate(p); }                                                                  \
+    void operator delete[](void* p, std::size_t) noexcept { Hf::AllocTracker::deallocate(p); }                                                                \
+    void operator delete(void* p, const std::nothrow_t&) noexcept { Hf::AllocTracker::deallocate(p); }                                                        \
+    void operator delete[](void* p, const std::nothrow_t&) noexcept { Hf::AllocTracker::deallocate(p); }
+
+namespace Hf {
+    // AllocTracker counts heap allocations made through operator new once HFALLOC_TRACKER_HOOKS() is
+    // linked in and enable() is called. Counts are kept per frame and per Hf::Profiler zone (the
+    // innermost zone open on the allocating thread), and every Nth allocation can record its call
+    // stack. Allocations made with an alignment larger than the default are not counted
+    class AllocTracker {
+    public:
+        struct FRAMESTATS {
+            uint64_t frame{ 0 };
+            uint64_t allocations{ 0 };
+            uint64_t frees{ 0 };
+            uint64_t bytes{ 0 };
+            uint64_t freedBytes{ 0 };
+        };
+
+        struct ZONESTATS {
+            // the profiler zone, or "(no zone)"
+            const char* name{ nullptr };
+            uint64_t allocations{ 0 };
+            uint64_t bytes{ 0 };
+        };
+
+        // returns true if HFALLOC_TRACKER_HOOKS() is in the program and has seen an allocation
+        static bool hooksInstalled();
+
+        static void enable();
+        static void disable();
+        static bool isEnabled();
+
+        // ends the frame, collecting the counts since the last call
+        static void frame();
+        // returns the counts of the last frame
+        static const FRAMESTATS& lastFrame();
+        // returns the zones that allocated in the last frame, most allocations first
+        static const std::vector<ZONESTATS>& lastFrameZones();
+        // returns the allocations counted since enable()
+        static uint64_t totalAllocations();
+
+        // records the call stack of every nth allocation, 0 stops sampling
+        static void setSampleInterval(int n);
+        // writes the last frame, its zones and the sampled call stacks
+        static void report(FILE* fout);
+        // forgets the sampled call stacks
+        static void clearSamples();
+
+        // used by HFALLOC_TRACKER_HOOKS()
+        static void* allocate(std::size_t size);
+        static void* allocate(std::size_t size, const std::nothrow_t&) noexcept;
+        static void deallocate(void* p) noexcept;
+    };
+}
+
+#endif
@@ -0,0 +1,117 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017-2019 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#include "pch.h"
+#include <hatchetfish_histogram.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace Hf {
+    namespace {
+        int highestBit(uint64_t x) {
+            int bit = 0;
+            while (x >>= 1)
+                bit++;
+            return bit;
+        }
+    } // namespace
+
+    Histogram::Histogram()
+        : buckets_(new std::atomic<uint64_t>[BucketCount]) {
+        reset();
+    }
+
+    int Histogram::_index(uint64_t units) {
+        if (units < SubBucketCount)
+            return (int)units;
+        int bit = std::min(highestBit(units), MaxValueBits - 1);
+        int shift = bit - SubBucketBits + 1;
+        int sub = (int)std::min<uint64_t>(units >> shift, SubBucketCount - 1);
+        return SubBucketCount + (shift - 1) * HalfSubBucketCount + (sub - HalfSubBucketCount);
+    }
+
+    uint64_t Histogram::_highest(int index) {
+        if (index < SubBucketCount)
+            return index;
+        int shift = (index - SubBucketCount) / HalfSubBucketCount + 1;
+        uint64_t sub = (index - SubBucketCount) % HalfSubBucketCount + HalfSubBucketCount;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void Histogram::record(double value) {
+        uint64_t units = value > 0.0 ? (uint64_t)std::llround(std::min(value * Scale, 9.0e18)) : 0;
+        buckets_[_index(units)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(units, std::memory_order_relaxed);
+        uint64_t m = min_.load(std::memory_order_relaxed);
+        while (units < m && !min_.compare_exchange_weak(m, units, std::memory_order_relaxed)) {
+        }
+        m = max_.load(std::memory_order_relaxed);
+        while (units > m && !max_.compare_exchange_weak(m, units, std::memory_order_relaxed)) {
+        }
+    }
+
+    void Histogram::reset() {
+        for (int i = 0; i < BucketCount; i++)
+            buckets_[i].store(0, std::memory_order_relaxed);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    double Histogram::min() const { return count() ? min_.load(std::memory_order_relaxed) / Scale : 0.0; }
+
+    double Histogram::max() const { return max_.load(std::memory_order_relaxed) / Scale; }
+
+    double Histogram::mean() const {
+        uint64_t n = count();
+        return n ? sum_.load(std::memory_order_relaxed) / Scale / n : 0.0;
+    }
+
+    double Histogram::percentile(double percent) const {
+        // buckets may change while they are read, so the total is summed from the buckets themselves
+        uint64_t total = 0;
+        for (int i = 0; i < BucketCount; i++)
+            total += buckets_[i].load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0.0;
+        percent = std::max(0.0, std::min(percent, 100.0));
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(percent / 100.0 * total));
+        uint64_t seen = 0;
+        uint64_t highest = max_.load(std::memory_order_relaxed);
+        for (int i = 0; i < BucketCount; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(_highest(i), highest) / Scale;
+        }
+        return highest / Scale;
+    }
+
+    Histogram::SUMMARY Histogram::summary() const {
+        SUMMARY s;
+        s.count = count();
+        s.mean = mean();
+        s.min = min();
+        s.p50 = percentile(50.0);
+        s.p95 = percentile(95.0);
+        s.p99 = percentile(99.0);
+        s.max = max();
+        return s;
+    }
+}
@@ -0,0 +1,82 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#ifndef HATCHETFISH_HISTOGRAM_HPP
+#define HATCHETFISH_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace Hf {
+    // Histogram counts values in fixed memory for percentiles such as p50, p95 and p99. Buckets are
+    // log-linear like an HDR histogram: exact below 128 units, then 64 buckets per power of two, so
+    // a percentile is within 1.6% of the recorded value. Values are stored in millionths, up to
+    // about 1.1 million, and record() is lock free so any thread may call it
+    class Histogram {
+    public:
+        // values are recorded in units of 1 / Scale
+        static constexpr double Scale = 1.0e6;
+
+        struct SUMMARY {
+            uint64_t count{ 0 };
+            double mean{ 0.0 };
+            double min{ 0.0 };
+            double p50{ 0.0 };
+            double p95{ 0.0 };
+            double p99{ 0.0 };
+            double max{ 0.0 };
+        };
+
+        Histogram();
+
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+        // records value, negative values count as 0
+        void record(double value);
+        void reset();
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+        double min() const;
+        double max() const;
+        double mean() const;
+        // returns the value below which percent of the recorded values fall
+        double percentile(double percent) const;
+        SUMMARY summary() const;
+
+    private:
+        static constexpr int SubBucketBits = 7;
+        static constexpr int SubBucketCount = 1 << SubBucketBits;
+        static constexpr int HalfSubBucketCount = SubBucketCount / 2;
+        static constexpr int MaxValueBits = 40;
+        static constexpr int BucketCount = SubBucketCount + (MaxValueBits - SubBucketBits) * HalfSubBucketCount;
+
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<uint64_t> sum_{ 0 };
+        std::atomic<uint64_t> min_{ UINT64_MAX };
+        std::atomic<uint64_t> max_{ 0 };
+
+        static int _index(uint64_t units);
+        // returns the largest value counted in bucket index
+        static uint64_t _highest(int index);
+    };
+}
+
+#endif
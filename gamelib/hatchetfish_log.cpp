@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <condition_variable>
+#include <thread>
 
 #ifdef __APPLE__
 #define __unix__ 1
@@ -54,9 +56,515 @@ namespace Hf {
         const char* debug = "DEBUG";
     }
 
+    // Messages are queued as the format pointer, a timestamp, and the arguments packed in the order the
+    // format reads them. The background thread walks the format again to unpack and print them.
+    // The queue is a bounded multiple producer queue with a sequence number in each slot.
+    struct HatchetfishLog::AsyncLog {
+        static constexpr size_t SlotCount = 8192;
+        static constexpr size_t ArgBytes = 200;
+
+        struct SLOT {
+            std::atomic<uint64_t> sequence{ 0 };
+            std::chrono::steady_clock::time_point time;
+            char category[24];
+            const char* color{ nullptr };
+            const char* fn{ nullptr };
+            const char* msg{ nullptr };
+            size_t size{ 0 };
+            unsigned char args[ArgBytes];
+        };
+
+        std::vector<SLOT> slots{ SlotCount };
+        std::atomic<uint64_t> enqueuePos{ 0 };
+        std::atomic<uint64_t> dequeuePos{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+
+        std::thread thread;
+        std::atomic<bool> quit{ false };
+        // producers between checking asyncEnabled and committing their slot, disableAsync() waits for them
+        std::atomic<int> producers{ 0 };
+        // set while the background thread waits on cv, so producers only notify when it is needed
+        std::atomic<bool> sleeping{ false };
+        std::mutex mutex;
+        std::condition_variable cv;
+        // notified by the background thread when the queue is empty, for flush()
+        std::condition_variable flushed;
+
+        // wall clock time at steady clock startSteady, timestamps are converted on the background thread
+        std::chrono::system_clock::time_point startSystem{ std::chrono::system_clock::now() };
+        std::chrono::steady_clock::time_point startSteady{ std::chrono::steady_clock::now() };
+
+        AsyncLog() {
+            for (size_t i = 0; i < SlotCount; i++)
+                slots[i].sequence = i;
+        }
+
+        SLOT* reserve() {
+            uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+            for (;;) {
+                SLOT& slot = slots[pos % SlotCount];
+                uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence == pos) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        return &slot;
+                } else if (sequence < pos) {
+                    return nullptr;
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void commit(SLOT* slot) {
+            uint64_t pos = slot->sequence.load(std::memory_order_relaxed);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        }
+
+        // returns the next committed slot, call release() when done with it
+        SLOT* front() {
+            uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+            SLOT& slot = slots[pos % SlotCount];
+            if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+                return nullptr;
+            return &slot;
+        }
+
+        void release(SLOT* slot) {
+            uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+            slot->sequence.store(pos + SlotCount, std::memory_order_release);
+            dequeuePos.store(pos + 1, std::memory_order_release);
+        }
+    };
+
+    namespace {
+        enum ArgType { ARG_NONE, ARG_INT, ARG_UINT, ARG_CHAR, ARG_DOUBLE, ARG_STRING, ARG_POINTER, ARG_SKIP, ARG_BAD };
+
+        // the length modifier of an integer conversion, each is read with its own type because
+        // long, size_t and ptrdiff_t differ in size on LLP64 and hh/h narrow the value like printf
+        enum ArgLength { LEN_INT, LEN_CHAR, LEN_SHORT, LEN_LONG, LEN_LONGLONG, LEN_INTMAX, LEN_SIZE, LEN_PTRDIFF };
+
+        // one printf conversion, the printf format is rebuilt with a fixed length modifier
+        struct SPEC {
+            const char* start{ nullptr };
+            const char* end{ nullptr };
+            int stars{ 0 };
+            ArgLength length{ LEN_INT };
+            ArgType type{ ARG_NONE };
+            char spec[32];
+        };
+
+        // parses the conversion starting at the '%' in p, returns false for "%%"
+        bool parseSpec(const char* p, SPEC& spec) {
+            spec.start = p++;
+            if (*p == '%') {
+                spec.end = p + 1;
+                return false;
+            }
+            char* out = spec.spec;
+            char* last = spec.spec + sizeof(spec.spec) - 4;
+            *out++ = '%';
+            spec.stars = 0;
+            while (*p && strchr("-+ #0'", *p) && out < last)
+                *out++ = *p++;
+            for (int part = 0; part < 2; part++) {
+                if (part == 1) {
+                    if (*p != '.')
+                        break;
+                    *out++ = *p++;
+                }
+                if (*p == '*') {
+                    spec.stars++;
+                    *out++ = *p++;
+                } else {
+                    while (*p >= '0' && *p <= '9' && out < last)
+                        *out++ = *p++;
+                }
+            }
+            bool isLong = false;
+            bool isLongDouble = false;
+            spec.length = LEN_INT;
+            while (*p && strchr("hljztL", *p)) {
+                switch (*p) {
+                case 'h': spec.length = spec.length == LEN_SHORT ? LEN_CHAR : LEN_SHORT; break;
+                case 'l': spec.length = spec.length == LEN_LONG ? LEN_LONGLONG : LEN_LONG; break;
+                case 'j': spec.length = LEN_INTMAX; break;
+                case 'z': spec.length = LEN_SIZE; break;
+                case 't': spec.length = LEN_PTRDIFF; break;
+                case 'L': isLongDouble = true; break;
+                }
+                isLong |= *p == 'l';
+                p++;
+            }
+            char c = *p;
+            spec.end = c ? p + 1 : p;
+            switch (c) {
+            case 'd':
+            case 'i':
+                spec.type = ARG_INT;
+                *out++ = 'l';
+                *out++ = 'l';
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                spec.type = ARG_UINT;
+                *out++ = 'l';
+                *out++ = 'l';
+                break;
+            case 'c':
+                spec.type = ARG_CHAR;
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec.type = isLongDouble ? ARG_BAD : ARG_DOUBLE;
+                break;
+            case 's':
+                spec.type = isLong ? ARG_BAD : ARG_STRING;
+                break;
+            case 'p':
+                spec.type = ARG_POINTER;
+                break;
+            case 'n':
+                spec.type = ARG_SKIP;
+                break;
+            default:
+                spec.type = ARG_BAD;
+                break;
+            }
+            *out++ = c;
+            *out = 0;
+            return true;
+        }
+
+        struct Packer {
+            unsigned char* p;
+            unsigned char* end;
+            bool full{ false };
+
+            template <typename T>
+            void put(T value) {
+                if (p + sizeof(T) > end) {
+                    full = true;
+                    return;
+                }
+                memcpy(p, &value, sizeof(T));
+                p += sizeof(T);
+            }
+
+            void putString(const char* s) {
+                if (!s)
+                    s = "(null)";
+                size_t length = strlen(s);
+                size_t room = end - p > (ptrdiff_t)sizeof(uint16_t) ? end - p - sizeof(uint16_t) : 0;
+                if (length > room) {
+                    length = room;
+                    full = true;
+                }
+                put((uint16_t)length);
+                if (p + length <= end) {
+                    memcpy(p, s, length);
+                    p += length;
+                }
+            }
+        };
+
+        struct Unpacker {
+            const unsigned char* p;
+            const unsigned char* end;
+
+            template <typename T>
+            bool get(T& value) {
+                if (p + sizeof(T) > end)
+                    return false;
+                memcpy(&value, p, sizeof(T));
+                p += sizeof(T);
+                return true;
+            }
+        };
+
+        // packs the arguments of msg, returns the bytes used. A full buffer ends the message early
+        size_t packArgs(unsigned char* buffer, size_t size, const char* msg, va_list args) {
+            Packer packer{ buffer, buffer + size };
+            SPEC spec;
+            for (const char* p = msg; *p && !packer.full; p++) {
+                if (*p != '%')
+                    continue;
+                if (!parseSpec(p, spec)) {
+                    p = spec.end - 1;
+                    continue;
+                }
+                p = spec.end - 1;
+                for (int i = 0; i < spec.stars; i++)
+                    packer.put((int64_t)va_arg(args, int));
+                switch (spec.type) {
+                case ARG_INT: {
+                    int64_t value;
+                    switch (spec.length) {
+                    case LEN_CHAR: value = (signed char)va_arg(args, int); break;
+                    case LEN_SHORT: value = (short)va_arg(args, int); break;
+                    case LEN_LONG: value = va_arg(args, long); break;
+                    case LEN_LONGLONG: value = va_arg(args, long long); break;
+                    case LEN_INTMAX: value = va_arg(args, intmax_t); break;
+                    case LEN_SIZE: value = va_arg(args, std::make_signed_t<size_t>); break;
+                    case LEN_PTRDIFF: value = va_arg(args, ptrdiff_t); break;
+                    default: value = va_arg(args, int); break;
+                    }
+                    packer.put(value);
+                    break;
+                }
+                case ARG_UINT: {
+                    uint64_t value;
+                    switch (spec.length) {
+                    case LEN_CHAR: value = (unsigned char)va_arg(args, unsigned int); break;
+                    case LEN_SHORT: value = (unsigned short)va_arg(args, unsigned int); break;
+                    case LEN_LONG: value = va_arg(args, unsigned long); break;
+                    case LEN_LONGLONG: value = va_arg(args, unsigned long long); break;
+                    case LEN_INTMAX: value = va_arg(args, uintmax_t); break;
+                    case LEN_SIZE: value = va_arg(args, size_t); break;
+                    case LEN_PTRDIFF: value = va_arg(args, std::make_unsigned_t<ptrdiff_t>); break;
+                    default: value = va_arg(args, unsigned int); break;
+                    }
+                    packer.put(value);
+                    break;
+                }
+                case ARG_CHAR: packer.put((int64_t)va_arg(args, int)); break;
+                case ARG_DOUBLE: packer.put(va_arg(args, double)); break;
+                case ARG_STRING: packer.putString(va_arg(args, const char*)); break;
+                case ARG_POINTER: packer.put(va_arg(args, void*)); break;
+                case ARG_SKIP: va_arg(args, void*); break;
+                default: return packer.p - buffer;
+                }
+            }
+            return packer.p - buffer;
+        }
+
+        template <typename T>
+        void formatArg(std::string& out, const char* spec, const int64_t* stars, int starCount, T value) {
+            char buffer[512];
+            int n = 0;
+            if (starCount == 0)
+                n = snprintf(buffer, sizeof(buffer), spec, value);
+            else if (starCount == 1)
+                n = snprintf(buffer, sizeof(buffer), spec, (int)stars[0], value);
+            else
+                n = snprintf(buffer, sizeof(buffer), spec, (int)stars[0], (int)stars[1], value);
+            if (n > 0)
+                out.append(buffer, std::min<size_t>(n, sizeof(buffer) - 1));
+        }
+
+        // the inverse of packArgs, formats msg with the packed arguments
+        void unpackArgs(std::string& out, const char* msg, const unsigned char* buffer, size_t size) {
+            Unpacker unpacker{ buffer, buffer + size };
+            SPEC spec;
+            const char* literal = msg;
+            for (const char* p = msg; *p; p++) {
+                if (*p != '%')
+                    continue;
+                out.append(literal, p);
+                bool isSpec = parseSpec(p, spec);
+                p = spec.end - 1;
+                literal = spec.end;
+                if (!isSpec) {
+                    out += '%';
+                    continue;
+                }
+                int64_t stars[2]{};
+                bool ok = true;
+                for (int i = 0; i < spec.stars; i++)
+                    ok = ok && unpacker.get(stars[i]);
+                int64_t i64;
+                uint64_t u64;
+                double d;
+                void* ptr;
+                uint16_t length;
+                switch (spec.type) {
+                case ARG_INT:
+                    ok = ok && unpacker.get(i64);
+                    if (ok)
+                        formatArg(out, spec.spec, stars, spec.stars, (long long)i64);
+                    break;
+                case ARG_CHAR:
+                    ok = ok && unpacker.get(i64);
+                    if (ok)
+                        formatArg(out, spec.spec, stars, spec.stars, (int)i64);
+                    break;
+                case ARG_UINT:
+                    ok = ok && unpacker.get(u64);
+                    if (ok)
+                        formatArg(out, spec.spec, stars, spec.stars, (unsigned long long)u64);
+                    break;
+                case ARG_DOUBLE:
+                    ok = ok && unpacker.get(d);
+                    if (ok)
+                        formatArg(out, spec.spec, stars, spec.stars, d);
+                    break;
+                case ARG_STRING: {
+                    ok = ok && unpacker.get(length) && unpacker.p + length <= unpacker.end;
+                    if (ok) {
+                        std::string s((const char*)unpacker.p, length);
+                        unpacker.p += length;
+                        formatArg(out, spec.spec, stars, spec.stars, s.c_str());
+                    }
+                    break;
+                }
+                case ARG_POINTER:
+                    ok = ok && unpacker.get(ptr);
+                    if (ok)
+                        formatArg(out, spec.spec, stars, spec.stars, ptr);
+                    break;
+                case ARG_SKIP: break;
+                default: ok = false; break;
+                }
+                if (!ok) {
+                    // the arguments did not fit in the slot
+                    out += "...";
+                    return;
+                }
+            }
+            out.append(literal);
+        }
+    } // namespace
+
     HatchetfishLog::HatchetfishLog() { fout = stdout; }
 
-    HatchetfishLog::~HatchetfishLog() { setOutputFile(); }
+    HatchetfishLog::~HatchetfishLog() {
+        disableAsync();
+        setOutputFile();
+    }
+
+    void HatchetfishLog::enableAsync() {
+        if (asyncEnabled)
+            return;
+        if (!async)
+            async = std::make_unique<AsyncLog>();
+        async->quit = false;
+        async->thread = std::thread([this] {
+            AsyncLog& q = *async;
+            for (;;) {
+                if (_writeQueued())
+                    continue;
+                std::unique_lock<std::mutex> lock(q.mutex);
+                q.flushed.notify_all();
+                q.sleeping = true;
+                // pairs with the fence in _queue(), so either this sees the slot or the producer sees sleeping
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                q.cv.wait(lock, [&q] { return q.quit || q.front(); });
+                q.sleeping = false;
+                if (!q.front())
+                    break;
+            }
+            fflush(fout);
+        });
+        asyncEnabled = true;
+    }
+
+    size_t HatchetfishLog::_writeQueued() {
+        AsyncLog& q = *async;
+        std::string line;
+        char stamp[16];
+        size_t count = 0;
+        while (AsyncLog::SLOT* slot = q.front()) {
+            auto wall = q.startSystem + std::chrono::duration_cast<std::chrono::system_clock::duration>(slot->time - q.startSteady);
+            time_t t = std::chrono::system_clock::to_time_t(wall);
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+#ifdef _WIN32
+            localtime_s(&tm, &t);
+#else
+            localtime_r(&t, &tm);
+#endif
+            strftime(stamp, sizeof(stamp), "%T", &tm);
+
+            line.clear();
+            line += '[';
+            line += stamp;
+            line += ':';
+            line += slot->category;
+            line += "] ";
+            if (slot->fn) {
+                line += slot->fn;
+                line += "(): ";
+            }
+            unpackArgs(line, slot->msg, slot->args, slot->size);
+            const char* color = slot->color;
+            q.release(slot);
+
+            _addHistory(line);
+            _write(color, line);
+            count++;
+        }
+        return count;
+    }
+
+    void HatchetfishLog::disableAsync() {
+        if (!asyncEnabled)
+            return;
+        asyncEnabled = false;
+        // a producer that saw asyncEnabled before it was cleared still commits its slot
+        while (async->producers.load())
+            std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(async->mutex);
+            async->quit = true;
+        }
+        async->cv.notify_all();
+        async->thread.join();
+        // the thread stops at an empty queue, so this only catches up with anything committed since
+        if (_writeQueued())
+            fflush(fout);
+        uint64_t dropped = async->dropped.exchange(0);
+        if (dropped)
+            warning("%llu log messages were dropped because the queue was full", (unsigned long long)dropped);
+    }
+
+    uint64_t HatchetfishLog::getDroppedMessages() const { return async ? async->dropped.load() : 0; }
+
+    bool HatchetfishLog::_queue(const char* category, const char* color, const char* fn, const char* msg, va_list args) {
+        if (!asyncEnabled)
+            return false;
+        // producers is raised before asyncEnabled is read again, so disableAsync() either stops this
+        // call or waits for its slot to be committed
+        async->producers++;
+        if (!asyncEnabled) {
+            async->producers--;
+            return false;
+        }
+        AsyncLog::SLOT* slot = async->reserve();
+        if (!slot) {
+            async->dropped++;
+            async->producers--;
+            return true;
+        }
+        slot->time = std::chrono::steady_clock::now();
+        snprintf(slot->category, sizeof(slot->category), "%s", category);
+        slot->color = color;
+        slot->fn = fn;
+        slot->msg = msg;
+        slot->size = packArgs(slot->args, AsyncLog::ArgBytes, msg, args);
+        async->commit(slot);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (async->sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(async->mutex);
+            async->cv.notify_one();
+        }
+        async->producers--;
+        return true;
+    }
+
+    void HatchetfishLog::_write(const char* color, const std::string& line) {
+        if (logEnabled && colorEnabled) {
+            fprintf(fout, "%s%s%s\n", color, line.c_str(), ansi::normal);
+        } else if (logEnabled) {
+            fprintf(fout, "%s\n", line.c_str());
+        }
+    }
 
     std::string& HatchetfishLog::makeDTG() {
         char msg[50];
@@ -125,20 +633,31 @@ namespace Hf {
         return lastMessage;
     }
 
+    std::vector<std::string> HatchetfishLog::getHistory() const {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        return history;
+    }
+
+    int HatchetfishLog::getHistoryItemsSize() const {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        return (int)history_cstr.size();
+    }
+
     void HatchetfishLog::_addHistory(const std::string& line) {
+        std::lock_guard<std::mutex> lock(historyMutex);
         _trimHistory();
         history.push_back(line);
-        history_cstr.push_back(history.back().c_str());
+        // growing history moves short strings, so every pointer is taken again
+        history_cstr.clear();
+        for (auto& h : history) {
+            history_cstr.push_back(h.c_str());
+        }
     }
 
     void HatchetfishLog::_trimHistory() {
         if (maxHistoryLines == 0 || history.size() < maxHistoryLines)
             return;
         history.erase(history.begin(), history.end() - maxHistoryLines + 1);
-        history_cstr.clear();
-        for (auto& h : history) {
-            history_cstr.push_back(h.c_str());
-        }
     }
 
     const std::string& HatchetfishLog::makeMessagefn(const char* category, const char* fn, const char* msg, va_list args) {
@@ -163,13 +682,7 @@ namespace Hf {
         return lastMessage;
     }
 
-    void HatchetfishLog::print(const char* color) {
-        if (logEnabled && colorEnabled) {
-            fprintf(fout, "%s%s%s\n", color, lastMessage.c_str(), ansi::normal);
-        } else if (logEnabled) {
-            fprintf(fout, "%s\n", lastMessage.c_str());
-        }
-    }
+    void HatchetfishLog::print(const char* color) { _write(color, lastMessage); }
 
     void HatchetfishLog::str(std::string& output, const char* msg, ...) {
         va_list args;
@@ -185,90 +698,164 @@ namespace Hf {
     }
 
     void HatchetfishLog::log(const char* category, const char* msg, ...) {
+        if (!logEnabled)
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(category, ansi::normal, nullptr, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessage(category, msg, args);
         va_end(args);
         print(ansi::normal);
     }
 
     void HatchetfishLog::logfn(const char* category, const char* fn, const char* msg, ...) {
+        if (!logEnabled)
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(category, ansi::normal, fn, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessagefn(category, fn, msg, args);
         va_end(args);
         print(ansi::normal);
     }
 
     void HatchetfishLog::info(const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_INFO))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::info, ansi::cyan, nullptr, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessage(hf::info, msg, args);
         va_end(args);
         print(ansi::cyan);
     }
 
     void HatchetfishLog::infofn(const char* fn, const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_INFO))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::info, ansi::cyan, fn, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessagefn(hf::info, fn, msg, args);
         va_end(args);
         print(ansi::cyan);
     }
 
     void HatchetfishLog::warning(const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_WARN))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::warning, ansi::yellow, nullptr, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessage(hf::warning, msg, args);
         va_end(args);
         print(ansi::yellow);
     }
 
     void HatchetfishLog::warningfn(const char* fn, const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_WARN))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::warning, ansi::yellow, fn, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessagefn(hf::warning, fn, msg, args);
         va_end(args);
         print(ansi::yellow);
     }
 
     void HatchetfishLog::error(const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_ERROR))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::error, ansi::red, nullptr, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessage(hf::error, msg, args);
         va_end(args);
         print(ansi::red);
     }
 
     void HatchetfishLog::errorfn(const char* fn, const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_ERROR))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::error, ansi::red, fn, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessagefn(hf::error, fn, msg, args);
         va_end(args);
         print(ansi::red);
     }
 
     void HatchetfishLog::debug(const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_DEBUG))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::debug, ansi::magenta, nullptr, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessage(hf::debug, msg, args);
         va_end(args);
         print(ansi::magenta);
     }
 
     void HatchetfishLog::debugfn(const char* fn, const char* msg, ...) {
+        if (!isLevelEnabled(HFLOG_LEVEL_DEBUG))
+            return;
         va_list args;
         va_start(args, msg);
+        if (_queue(hf::debug, ansi::magenta, fn, msg, args)) {
+            va_end(args);
+            return;
+        }
         makeMessagefn(hf::debug, fn, msg, args);
         va_end(args);
         print(ansi::magenta);
     }
 
-    void HatchetfishLog::flush() { fflush(fout); }
+    void HatchetfishLog::flush() {
+        if (asyncEnabled) {
+            // wait for the background thread to write everything queued so far
+            uint64_t target = async->enqueuePos.load();
+            std::unique_lock<std::mutex> lock(async->mutex);
+            // the timeout covers a slot that is reserved but not committed yet, which stops the thread short
+            while (async->dequeuePos.load() < target) {
+                async->flushed.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+        fflush(fout);
+    }
 
     void HatchetfishLog::setOutputFile(FILE* fileStream) {
         if (fileStream == stdin)
             return;
+        // the background thread must not write while the file changes
+        bool wasAsync = asyncEnabled;
+        disableAsync();
         if (fout != NULL && fout != stderr && fout != stdout) {
             fclose(fout);
         }
@@ -276,6 +863,8 @@ namespace Hf {
             fout = stdout;
         else
             fout = fileStream;
+        if (wasAsync)
+            enableAsync();
     }
 
     double HatchetfishLog::getSecondsElapsed() { return getMicrosecondsElapsed() / 1.0e6; }
@@ -290,6 +879,8 @@ namespace Hf {
     void HatchetfishLog::resetClock() { t0 = t1 = std::chrono::high_resolution_clock::now(); }
 
     void HatchetfishLog::saveStats(const std::string& filenameprefix) {
+        savePercentiles(filenameprefix + "percentiles.csv");
+        std::lock_guard<std::mutex> lock(statsMutex);
         for (auto& stat : stats) {
             computeStat(stat.first);
             std::ofstream fout_(filenameprefix + stat.first + ".csv", std::ios::app);
@@ -312,29 +903,75 @@ namespace Hf {
 
     void HatchetfishLog::takeStat(const std::string& name) {
         double elapsedTime = getSecondsElapsed();
+        std::lock_guard<std::mutex> lock(statsMutex);
         auto& X = stats[name].X;
         double deltaTime = 0.0;
         double r = 0.0;
         if (!X.empty()) {
             deltaTime = elapsedTime - X.back().timeMeasured;
             r = deltaTime - X.back().x;
+            // the first sample has no previous time to measure from
+            auto& histogram = histograms[name];
+            if (!histogram)
+                histogram = std::make_unique<Histogram>();
+            histogram->record(deltaTime);
         }
 
+        if (X.size() >= 2 * maxStatSamples)
+            X.erase(X.begin(), X.begin() + maxStatSamples);
         X.push_back({ elapsedTime, deltaTime, r });
     }
 
     void HatchetfishLog::takeStat(const std::string& name, double xval) {
         double elapsedTime = getSecondsElapsed();
+        std::lock_guard<std::mutex> lock(statsMutex);
         auto& X = stats[name].X;
         double r = 0.0;
         if (!X.empty()) {
             r = xval - X.back().x;
         }
+        auto& histogram = histograms[name];
+        if (!histogram)
+            histogram = std::make_unique<Histogram>();
+        histogram->record(xval);
 
+        if (X.size() >= 2 * maxStatSamples)
+            X.erase(X.begin(), X.begin() + maxStatSamples);
         X.push_back({ elapsedTime, xval, r });
     }
 
+    void HatchetfishLog::recordStat(const std::string& name, double xval) { getHistogram(name).record(xval); }
+
+    Histogram& HatchetfishLog::getHistogram(const std::string& name) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        auto& histogram = histograms[name];
+        if (!histogram)
+            histogram = std::make_unique<Histogram>();
+        return *histogram;
+    }
+
+    Histogram::SUMMARY HatchetfishLog::getPercentiles(const std::string& name) { return getHistogram(name).summary(); }
+
+    bool HatchetfishLog::savePercentiles(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (histograms.empty())
+            return true;
+        std::ofstream fout_(filename);
+        if (!fout_)
+            return false;
+        fout_ << "stat,count,mean,min,p50,p95,p99,max" << std::endl;
+        fout_ << std::setprecision(6);
+        for (auto& [name, histogram] : histograms) {
+            Histogram::SUMMARY s = histogram->summary();
+            fout_ << name << "," << s.count << "," << s.mean << "," << s.min << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.max << std::endl;
+        }
+        return (bool)fout_;
+    }
+
     void HatchetfishLog::resetStat(const std::string& name) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (auto it = histograms.find(name); it != histograms.end())
+            it->second->reset();
         auto& stat = stats[name];
         stat.lcl = 0.0;
         stat.ucl = 0.0;
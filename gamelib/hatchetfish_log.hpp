@@ -25,12 +25,54 @@
 #include <chrono>
 #include <string>
 #include <cmath>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <hatchetfish_histogram.hpp>
+
+// Message levels. Macros for levels below HFLOG_MIN_LEVEL compile to nothing, so their arguments
+// are not evaluated. The default keeps debug messages out of release (NDEBUG) builds
+#define HFLOG_LEVEL_DEBUG 0
+#define HFLOG_LEVEL_INFO 1
+#define HFLOG_LEVEL_WARN 2
+#define HFLOG_LEVEL_ERROR 3
+#define HFLOG_LEVEL_NONE 4
+#ifndef HFLOG_MIN_LEVEL
+#ifdef NDEBUG
+#define HFLOG_MIN_LEVEL HFLOG_LEVEL_INFO
+#else
+#define HFLOG_MIN_LEVEL HFLOG_LEVEL_DEBUG
+#endif
+#endif
+
+// checks the runtime level before the arguments are evaluated or formatted
+#define HFLOG_IF_LEVEL(level, call)                                                                                                                            \
+    do {                                                                                                                                                       \
+        if (Hf::Log.isLevelEnabled(level))                                                                                                                     \
+            call;                                                                                                                                              \
+    } while (0)
 
 #define HFLOGSTR(ostr, ...) Hf::Log.str(ostr, __VA_ARGS__);
-#define HFLOGINFO(...) Hf::Log.infofn(__FUNCTION__, __VA_ARGS__);
-#define HFLOGWARN(...) Hf::Log.warningfn(__FUNCTION__, __VA_ARGS__);
-#define HFLOGERROR(...) Hf::Log.errorfn(__FUNCTION__, __VA_ARGS__);
-#define HFLOGDEBUG(...) Hf::Log.debugfn(__FUNCTION__, __VA_ARGS__);
+#if HFLOG_MIN_LEVEL <= HFLOG_LEVEL_INFO
+#define HFLOGINFO(...) HFLOG_IF_LEVEL(HFLOG_LEVEL_INFO, Hf::Log.infofn(__FUNCTION__, __VA_ARGS__));
+#else
+#define HFLOGINFO(...) ;
+#endif
+#if HFLOG_MIN_LEVEL <= HFLOG_LEVEL_WARN
+#define HFLOGWARN(...) HFLOG_IF_LEVEL(HFLOG_LEVEL_WARN, Hf::Log.warningfn(__FUNCTION__, __VA_ARGS__));
+#else
+#define HFLOGWARN(...) ;
+#endif
+#if HFLOG_MIN_LEVEL <= HFLOG_LEVEL_ERROR
+#define HFLOGERROR(...) HFLOG_IF_LEVEL(HFLOG_LEVEL_ERROR, Hf::Log.errorfn(__FUNCTION__, __VA_ARGS__));
+#else
+#define HFLOGERROR(...) ;
+#endif
+#if HFLOG_MIN_LEVEL <= HFLOG_LEVEL_DEBUG
+#define HFLOGDEBUG(...) HFLOG_IF_LEVEL(HFLOG_LEVEL_DEBUG, Hf::Log.debugfn(__FUNCTION__, __VA_ARGS__));
+#else
+#define HFLOGDEBUG(...) ;
+#endif
 #define HFLOG(...) Hf::Log.logfn(__FUNCTION__, __VA_ARGS);
 #ifndef HFLOGDEBUGFIRSTRUN_COUNT
 #define HFLOGDEBUGFIRSTRUN_COUNT 1
@@ -62,16 +104,16 @@
         Hf::Log.logfn(__FUNCTION__, "Condition is false (%s)", #condition);
 #define HFLOGCHECKINFO(condition)                                                                                                                              \
     if (condition)                                                                                                                                             \
-        Hf::Log.infofn(__FUNCTION__, "Condition is false (%s)", #condition);
+        HFLOGINFO("Condition is false (%s)", #condition)
 #define HFLOGCHECKWARN(condition)                                                                                                                              \
     if (condition)                                                                                                                                             \
-        Hf::Log.warningfn(__FUNCTION__, "Condition is false (%s)", #condition);
+        HFLOGWARN("Condition is false (%s)", #condition)
 #define HFLOGCHECKDEBUG(condition)                                                                                                                             \
     if (condition)                                                                                                                                             \
-        Hf::Log.debugfn(__FUNCTION__, "Condition is false (%s)", #condition);
+        HFLOGDEBUG("Condition is false (%s)", #condition)
 #define HFLOGCHECKERROR(condition)                                                                                                                             \
     if (condition)                                                                                                                                             \
-        Hf::Log.errorfn(__FUNCTION__, "Condition is false (%s)", #condition);
+        HFLOGERROR("Condition is false (%s)", #condition)
 
 #define HFLOG_MS_ELAPSED() (Hf::Log.getMillisecondsElapsed())
 #define HFLOG_SECS_ELAPSED() (Hf::Log.getSecondsElapsed())
@@ -97,6 +139,7 @@ namespace Hf {
         bool logWarningEnabled = true;
         bool logErrorEnabled = true;
         bool logDebugEnabled = true;
+        int minLevel = HFLOG_MIN_LEVEL;
 
         const std::string& makeMessage(const char* category, const char* msg, va_list args);
         const std::string& makeMessagefn(const char* category, const char* fn, const char* msg, va_list args);
@@ -106,11 +149,23 @@ namespace Hf {
 
         std::vector<std::string> history;
         std::vector<const char*> history_cstr;
+        mutable std::mutex historyMutex;
 
         void _addHistory(const std::string& line);
         void _trimHistory();
         size_t maxHistoryLines = 10;
 
+        // formats queued messages on a background thread, see enableAsync()
+        struct AsyncLog;
+        std::unique_ptr<AsyncLog> async;
+        std::atomic<bool> asyncEnabled{ false };
+
+        // queues a message for the background thread, returns false if async logging is off
+        bool _queue(const char* category, const char* color, const char* fn, const char* msg, va_list args);
+        // writes the committed messages at the front of the queue, returns the number written
+        size_t _writeQueued();
+        void _write(const char* color, const std::string& line);
+
     public:
         struct TimeDataPoint {
             double timeMeasured = 0.0;
@@ -151,6 +206,10 @@ namespace Hf {
 
     private:
         std::map<std::string, TimeDataPoints> stats;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+        std::mutex statsMutex;
+        // takeStat() keeps at most this many recent samples per stat for the control chart
+        size_t maxStatSamples = 1000;
 
     public:
         HatchetfishLog();
@@ -168,17 +227,47 @@ namespace Hf {
         void errorfn(const char* fn, const char* msg, ...);
         void debug(const char* msg, ...);
         void debugfn(const char* fn, const char* msg, ...);
+        // writes queued messages and flushes the output file
         void flush();
 
+        // formats and writes messages on a background thread. Logging calls then only copy the format
+        // pointer, arguments and a timestamp into a lock free queue, so they are cheap and safe from any
+        // thread. Formats must be string literals. Call flush() before reading the history
+        void enableAsync();
+        // writes the queued messages and goes back to logging on the calling thread
+        void disableAsync();
+        bool isAsyncEnabled() const { return asyncEnabled; }
+        // returns the number of messages dropped because the queue was full
+        uint64_t getDroppedMessages() const;
+
         std::string& makeTimeStamp();
         std::string& makeDTG();
-        const std::vector<std::string>& getHistory() const { return history; }
-        const char** getHistoryItems() const { return (const char**)&history_cstr[0]; }
-        int getHistoryItemsSize() const { return (int)history_cstr.size(); }
+        // returns a copy of the recent lines, the async thread may be adding lines meanwhile
+        std::vector<std::string> getHistory() const;
+        // returns pointers into the history, they are only valid until the next line is logged, so
+        // call flush() or disableAsync() first and do not log from other threads while using them
+        const char** getHistoryItems() const { return (const char**)history_cstr.data(); }
+        int getHistoryItemsSize() const;
         void setMaxHistory(size_t lines) { maxHistoryLines = lines > 100 ? 100 : lines; }
 
         void setOutputFile(FILE* fileStream = NULL);
 
+        // returns true if messages at an HFLOG_LEVEL_* level are written. This is checked before formatting
+        bool isLevelEnabled(int level) const {
+            if (!logEnabled || level < minLevel)
+                return false;
+            switch (level) {
+            case HFLOG_LEVEL_DEBUG: return logDebugEnabled;
+            case HFLOG_LEVEL_INFO: return logInfoEnabled;
+            case HFLOG_LEVEL_WARN: return logWarningEnabled;
+            case HFLOG_LEVEL_ERROR: return logErrorEnabled;
+            default: return false;
+            }
+        }
+        // messages below level are skipped at runtime, levels below HFLOG_MIN_LEVEL are never compiled in
+        void setLevel(int level) { minLevel = level; }
+        int getLevel() const { return minLevel; }
+
         void enableLog() { logEnabled = true; }
         void disableLog() { logEnabled = false; }
         void toggleLog() { logEnabled = !logEnabled; }
@@ -214,9 +303,21 @@ namespace Hf {
         double getMicrosecondsElapsed();
         void resetClock();
 
+        // writes the control chart of each stat to filenameprefix + name + ".csv", and the percentiles
+        // of every histogram to filenameprefix + "percentiles.csv"
         void saveStats(const std::string& filenameprefix);
+        // records the seconds since the last takeStat(name)
         void takeStat(const std::string& name);
         void takeStat(const std::string& name, double xval);
+        // records xval in the histogram of name only, a lock is taken to find the histogram
+        void recordStat(const std::string& name, double xval);
+        // returns the histogram behind a stat, it stays valid for the life of the log and may be
+        // recorded into from any thread without locking
+        Histogram& getHistogram(const std::string& name);
+        // returns the count, mean and p50/p95/p99/max of a stat
+        Histogram::SUMMARY getPercentiles(const std::string& name);
+        // writes the percentiles of every stat as CSV
+        bool savePercentiles(const std::string& filename);
         void resetStat(const std::string& name);
         void computeStat(const std::string& name, bool filter = true);
         const TimeDataPoints& getStat(const std::string& name);
@@ -0,0 +1,213 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017-2019 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#include "pch.h"
+#include <hatchetfish_profiler.hpp>
+#include <algorithm>
+#include <string.h>
+
+namespace Hf {
+    FrameProfiler Profiler;
+
+    namespace {
+        thread_local void* threadBuffer = nullptr;
+
+        void writeJsonString(FILE* fout, const char* s) {
+            fputc('"', fout);
+            for (; *s; s++) {
+                if (*s == '"' || *s == '\\')
+                    fputc('\\', fout);
+                if ((unsigned char)*s >= 0x20)
+                    fputc(*s, fout);
+            }
+            fputc('"', fout);
+        }
+    } // namespace
+
+    FrameProfiler::FrameProfiler() { frameStart_ = now(); }
+
+    FrameProfiler::~FrameProfiler() {}
+
+    void FrameProfiler::enable() {
+        if (!enabled_)
+            frameStart_ = now();
+        enabled_ = true;
+    }
+
+    void FrameProfiler::disable() { enabled_ = false; }
+
+    FrameProfiler::THREADBUFFER* FrameProfiler::_buffer() {
+        if (threadBuffer)
+            return (THREADBUFFER*)threadBuffer;
+        // buffers are kept after their thread exits so frame() never reads freed memory
+        std::lock_guard<std::mutex> lock(threadsMutex_);
+        threads_.push_back(std::make_unique<THREADBUFFER>());
+        THREADBUFFER* buffer = threads_.back().get();
+        buffer->id = (int)threads_.size();
+        buffer->name = "Thread " + std::to_string(buffer->id);
+        buffer->stack.reserve(32);
+        threadBuffer = buffer;
+        return buffer;
+    }
+
+    void FrameProfiler::beginZone(const char* name) {
+        THREADBUFFER* buffer = _buffer();
+        EVENT e;
+        e.name = name;
+        e.depth = (int)buffer->stack.size();
+        e.thread = buffer->id;
+        buffer->stack.push_back(e);
+        buffer->stack.back().begin = now();
+    }
+
+    void FrameProfiler::endZone() {
+        int64_t t = now();
+        THREADBUFFER* buffer = _buffer();
+        if (buffer->stack.empty())
+            return;
+        EVENT e = buffer->stack.back();
+        buffer->stack.pop_back();
+        e.end = t;
+        if (!buffer->stack.empty())
+            buffer->stack.back().child += e.end - e.begin;
+
+        uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        if (head - buffer->tail.load(std::memory_order_acquire) >= MaxThreadEvents) {
+            dropped_++;
+            return;
+        }
+        buffer->events[head % MaxThreadEvents] = e;
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    const char* FrameProfiler::currentZone() {
+        THREADBUFFER* buffer = (THREADBUFFER*)threadBuffer;
+        if (!buffer || buffer->stack.empty())
+            return nullptr;
+        return buffer->stack.back().name;
+    }
+
+    void FrameProfiler::setThreadName(const char* name) {
+        THREADBUFFER* buffer = _buffer();
+        std::lock_guard<std::mutex> lock(threadsMutex_);
+        buffer->name = name;
+        buffer->named = true;
+    }
+
+    void FrameProfiler::frame() {
+        int64_t t = now();
+        THREADBUFFER* mainBuffer = _buffer();
+        collected_.clear();
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex_);
+            if (!mainBuffer->named) {
+                mainBuffer->name = "Main";
+                mainBuffer->named = true;
+            }
+            for (auto& buffer : threads_) {
+                uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+                uint64_t head = buffer->head.load(std::memory_order_acquire);
+                for (; tail != head; tail++)
+                    collected_.push_back(buffer->events[tail % MaxThreadEvents]);
+                buffer->tail.store(tail, std::memory_order_release);
+            }
+        }
+
+        lastFrame_.frame = frameIndex_++;
+        lastFrame_.ms = (t - frameStart_) * 1.0e-6;
+        lastFrame_.zones.clear();
+        for (const EVENT& e : collected_) {
+            ZONESTATS* zone = nullptr;
+            for (auto& z : lastFrame_.zones) {
+                if (z.name == e.name || strcmp(z.name, e.name) == 0) {
+                    zone = &z;
+                    break;
+                }
+            }
+            if (!zone) {
+                lastFrame_.zones.emplace_back();
+                zone = &lastFrame_.zones.back();
+                zone->name = e.name;
+                zone->depth = e.depth;
+            }
+            zone->calls++;
+            zone->totalMs += (e.end - e.begin) * 1.0e-6;
+            zone->selfMs += (e.end - e.begin - e.child) * 1.0e-6;
+        }
+        std::sort(lastFrame_.zones.begin(), lastFrame_.zones.end(), [](const ZONESTATS& a, const ZONESTATS& b) { return a.totalMs > b.totalMs; });
+
+        if (capturing_) {
+            EVENT f;
+            f.name = "Frame";
+            f.begin = frameStart_;
+            f.end = t;
+            f.thread = mainBuffer->id;
+            size_t room = maxCaptureEvents_ - std::min(maxCaptureEvents_, captured_.size());
+            if (room > 0)
+                captured_.push_back(f);
+            if (room > 1)
+                captured_.insert(captured_.end(), collected_.begin(), collected_.begin() + std::min(room - 1, collected_.size()));
+        }
+        frameStart_ = t;
+    }
+
+    void FrameProfiler::beginCapture(size_t maxEvents) {
+        captured_.clear();
+        captured_.reserve(std::min<size_t>(maxEvents, 65536));
+        maxCaptureEvents_ = maxEvents;
+        captureStart_ = frameStart_;
+        capturing_ = true;
+    }
+
+    bool FrameProfiler::endCapture(const std::string& path) {
+        capturing_ = false;
+        FILE* fout = fopen(path.c_str(), "w");
+        if (!fout) {
+            captured_.clear();
+            return false;
+        }
+
+        fprintf(fout, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex_);
+            for (auto& buffer : threads_) {
+                fprintf(fout, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->id);
+                writeJsonString(fout, buffer->name.c_str());
+                fprintf(fout, "}}");
+                first = false;
+            }
+        }
+        for (const EVENT& e : captured_) {
+            fprintf(fout, "%s{\"name\":", first ? "" : ",\n");
+            writeJsonString(fout, e.name);
+            fprintf(fout,
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.thread,
+                    (e.begin - captureStart_) * 1.0e-3,
+                    (e.end - e.begin) * 1.0e-3);
+            first = false;
+        }
+        fprintf(fout, "\n]}\n");
+        bool ok = ferror(fout) == 0;
+        fclose(fout);
+        captured_.clear();
+        captured_.shrink_to_fit();
+        return ok;
+    }
+}
@@ -0,0 +1,164 @@
+// SSPHH/Fluxions/Unicornfish/Viperfish/Hatchetfish/Sunfish/Damselfish/GLUT Extensions
+// Copyright (C) 2017 Jonathan Metzgar
+// All rights reserved.
+//
+// This program is free software : you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.If not, see <https://www.gnu.org/licenses/>.
+//
+// For any other type of licensing, please contact me at jmetzgar@outlook.com
+#ifndef HATCHETFISH_PROFILER_HPP
+#define HATCHETFISH_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// HFPROFILE("name") times the enclosing scope when Hf::Profiler is enabled. Names must be string
+// literals. Define HFPROFILE_ENABLED to 0 to compile the zones out
+#ifndef HFPROFILE_ENABLED
+#define HFPROFILE_ENABLED 1
+#endif
+#define HFPROFILE_CONCAT2(a, b) a##b
+#define HFPROFILE_CONCAT(a, b) HFPROFILE_CONCAT2(a, b)
+#if HFPROFILE_ENABLED
+#define HFPROFILE(name) Hf::ProfileZone HFPROFILE_CONCAT(hfProfileZone, __LINE__)(name)
+#else
+#define HFPROFILE(name)
+#endif
+
+namespace Hf {
+    // FrameProfiler records nested zones on every thread into per thread buffers. frame() collects
+    // them once per frame into per zone totals, and a capture writes every zone as Chrome trace
+    // events that Perfetto (ui.perfetto.dev) or chrome://tracing can show on a timeline
+    class FrameProfiler {
+    public:
+        struct ZONESTATS {
+            const char* name{ nullptr };
+            int depth{ 0 };       // nesting depth of the first call
+            int calls{ 0 };       // times entered this frame
+            double totalMs{ 0.0 }; // time inside the zone
+            double selfMs{ 0.0 };  // time inside the zone but not in a nested zone
+        };
+
+        struct FRAMESTATS {
+            uint64_t frame{ 0 };
+            double ms{ 0.0 };
+            // sorted by total time, largest first
+            std::vector<ZONESTATS> zones;
+        };
+
+        FrameProfiler();
+        ~FrameProfiler();
+
+        void enable();
+        void disable();
+        bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        // returns steady clock nanoseconds
+        static int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void beginZone(const char* name);
+        void endZone();
+
+        // names the calling thread in captures
+        void setThreadName(const char* name);
+
+        // returns the innermost open zone on the calling thread or nullptr, this never allocates
+        static const char* currentZone();
+
+        // ends the frame, collecting the zones finished on every thread since the last call
+        void frame();
+        // returns the zones of the last frame
+        const FRAMESTATS& lastFrame() const { return lastFrame_; }
+
+        // records every zone until endCapture(), up to maxEvents
+        void beginCapture(size_t maxEvents = 1000000);
+        // writes the captured zones as Chrome trace event JSON
+        bool endCapture(const std::string& path);
+        bool capturing() const { return capturing_; }
+
+        // zones dropped because a thread recorded too many between frames
+        uint64_t droppedZones() const { return dropped_; }
+
+    private:
+        // zones a thread may finish between calls to frame(), a power of two
+        static constexpr size_t MaxThreadEvents = 8192;
+
+        struct EVENT {
+            const char* name{ nullptr };
+            int64_t begin{ 0 };
+            int64_t end{ 0 };
+            int64_t child{ 0 }; // time spent in nested zones
+            int depth{ 0 };
+            int thread{ 0 };
+        };
+
+        // the owning thread writes finished zones at head and frame() reads them from tail
+        struct THREADBUFFER {
+            int id{ 0 };
+            bool named{ false };
+            std::string name;
+            std::vector<EVENT> stack;
+            std::unique_ptr<EVENT[]> events{ new EVENT[MaxThreadEvents] };
+            std::atomic<uint64_t> head{ 0 };
+            std::atomic<uint64_t> tail{ 0 };
+        };
+
+        std::atomic<bool> enabled_{ false };
+        std::mutex threadsMutex_;
+        std::vector<std::unique_ptr<THREADBUFFER>> threads_;
+
+        uint64_t frameIndex_{ 0 };
+        int64_t frameStart_{ 0 };
+        FRAMESTATS lastFrame_;
+        std::vector<EVENT> collected_;
+
+        bool capturing_{ false };
+        size_t maxCaptureEvents_{ 0 };
+        int64_t captureStart_{ 0 };
+        std::vector<EVENT> captured_;
+        std::atomic<uint64_t> dropped_{ 0 };
+
+        THREADBUFFER* _buffer();
+    };
+
+    extern FrameProfiler Profiler;
+
+    // times its scope as a zone, see HFPROFILE()
+    class ProfileZone {
+    public:
+        ProfileZone(const char* name)
+            : active_(Profiler.isEnabled()) {
+            if (active_)
+                Profiler.beginZone(name);
+        }
+        ~ProfileZone() {
+            if (active_)
+                Profiler.endZone();
+        }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+
+    private:
+        bool active_;
+    };
+}
+
+#endif
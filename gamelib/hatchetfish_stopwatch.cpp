@@ -20,13 +20,13 @@
 #include <hatchetfish_stopwatch.hpp>
 
 namespace Hf {
-    StopWatch::StopWatch() { start_timepoint = std::chrono::system_clock::now(); }
+    StopWatch::StopWatch() { start_timepoint = std::chrono::steady_clock::now(); }
 
     StopWatch::~StopWatch() {}
 
-    void StopWatch::start() { start_timepoint = std::chrono::system_clock::now(); }
+    void StopWatch::start() { start_timepoint = std::chrono::steady_clock::now(); }
 
-    void StopWatch::stop() { end_timepoint = std::chrono::system_clock::now(); }
+    void StopWatch::stop() { end_timepoint = std::chrono::steady_clock::now(); }
 
     double StopWatch::getSecondsElapsed() {
         auto diff = end_timepoint - start_timepoint;
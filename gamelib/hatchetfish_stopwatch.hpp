@@ -74,8 +74,8 @@ namespace Hf {
         double getSecondsElapsed();
 
     private:
-        std::chrono::time_point<std::chrono::system_clock> start_timepoint;
-        std::chrono::time_point<std::chrono::system_clock> end_timepoint;
+        std::chrono::time_point<std::chrono::steady_clock> start_timepoint;
+        std::chrono::time_point<std::chrono::steady_clock> end_timepoint;
     };
 }
 
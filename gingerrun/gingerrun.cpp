@@ -116,21 +116,18 @@ int main(int argc, char** argv) {
 	SDL_Texture* testPNG = context.loadImage("godzilla.png");
 	SDL_Texture* testJPG = context.loadImage("parrot.jpg");
 	graphics.setTileSize({ 32, 32 });
-	int spriteCount = context.loadTileset(0, 32, 32, "GingerRun.png");
-	if (!spriteCount) {
-		HFLOGWARN("Tileset not found");
-	}
-	spriteCount = context.loadTileset(1, 32, 32, "GingerRun.png");
-
-	context.loadAudioClip(0, "starbattle-bad.wav");
-	context.loadAudioClip(1, "starbattle-dead.wav");
-	context.loadAudioClip(2, "starbattle-endo.wav");
-	context.loadAudioClip(3, "starbattle-exo.wav");
-	context.loadAudioClip(4, "starbattle-ok.wav");
-	context.loadAudioClip(5, "starbattle-pdead.wav");
-	context.loadMusicClip(1, "starbattlemusic1.mp3");
-	context.loadMusicClip(0, "GingerRun.mp3");
-	context.loadMusicClip(2, "distoro2.mid");
+	auto tileset = context.loadTilesetAsync(0, 32, 32, "GingerRun.png");
+	context.loadTilesetAsync(1, 32, 32, "GingerRun.png");
+
+	context.loadAudioClipAsync(0, "starbattle-bad.wav");
+	context.loadAudioClipAsync(1, "starbattle-dead.wav");
+	context.loadAudioClipAsync(2, "starbattle-endo.wav");
+	context.loadAudioClipAsync(3, "starbattle-exo.wav");
+	context.loadAudioClipAsync(4, "starbattle-ok.wav");
+	context.loadAudioClipAsync(5, "starbattle-pdead.wav");
+	context.loadMusicClipAsync(1, "starbattlemusic1.mp3");
+	context.loadMusicClipAsync(0, "GingerRun.mp3");
+	context.loadMusicClipAsync(2, "distoro2.mid");
 
 	GameLib::Font gothicfont(&context);
 	GameLib::Font minchofont(&context);
@@ -146,6 +143,11 @@ int main(int argc, char** argv) {
 		HFLOGWARN("world.txt not found");
 	}
 
+	context.waitForLoads();
+	if (!tileset.get()) {
+		HFLOGWARN("Tileset not found");
+	}
+
 	Hf::StopWatch stopwatch;
 	double spritesDrawn = 0;
 	double frames = 0;
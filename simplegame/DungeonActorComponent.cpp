@@ -378,7 +378,7 @@ namespace GameLib {
 		b.position.x = 1 + random.positive() * (Locator::getWorld()->worldSizeX - 2);
 		b.position.y = 1 + random.positive() * (Locator::getWorld()->worldSizeY - 2);
         
-        Locator::getAudio()->playAudio(1, true);
+        Locator::getAudio()->playAudio(1, 0, glm::vec2(a.position));
 	}
 
 
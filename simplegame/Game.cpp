@@ -6,6 +6,18 @@
 constexpr int SOUND_BLIP = 6;
 
 void Game::init() {
+	Hf::Log.enableAsync();
+	if (!profilePath.empty()) {
+		Hf::Profiler.enable();
+		Hf::Profiler.beginCapture();
+	}
+	if (!replayPath.empty() && player.open(replayPath)) {
+		GameLib::random.seed(player.seed());
+	} else if (!recordPath.empty()) {
+		uint32_t seed = GameLib::random.rd();
+		GameLib::random.seed(seed);
+		recorder.open(recordPath, seed);
+	}
 	GameLib::Locator::provide(&context);
 	if (context.audioInitialized())
 		GameLib::Locator::provide(&audio);
@@ -17,6 +29,8 @@ void Game::init() {
 	box2d.init();
 
 	audio.setVolume(0.2f);
+	// the trigger sound restarts instead of stacking, as playAudio(1, true) used to
+	audio.setClipLimit(1, 1);
 
 	PlaySoundCommand play0(0, false);
 	PlaySoundCommand play1(1, false);
@@ -41,20 +55,62 @@ void Game::init() {
 
 
 void Game::kill() {
-	double totalTime = stopwatch.stop_s();
+	// the HFLOGDEBUG lines are compiled out of release builds
+	[[maybe_unused]] double totalTime = stopwatch.stop_s();
 	HFLOGDEBUG("Sprites/sec = %5.1f", spritesDrawn / totalTime);
 	HFLOGDEBUG("Frames/sec = %5.1f", frames / totalTime);
+	for (const char* name : { "frame ms", "tick ms", "asset load ms" }) {
+		[[maybe_unused]] Hf::Histogram::SUMMARY s = Hf::Log.getPercentiles(name);
+		HFLOGINFO("%s: p50 %.2f p95 %.2f p99 %.2f max %.2f (%llu samples)", name, s.p50, s.p95, s.p99, s.max, (unsigned long long)s.count);
+	}
+
+	// the totals cover every time the overlay was shown
+	if (!GameLib::ComponentProfiler::totals().empty() && GameLib::ComponentProfiler::save("component_stats.csv"))
+		HFLOGINFO("component times written to 'component_stats.csv'");
 
+	recorder.close();
 	actorPool.clear();
+	if (Hf::Profiler.capturing()) {
+		if (Hf::Profiler.endCapture(profilePath))
+			HFLOGINFO("profile written to '%s'", profilePath.c_str());
+	}
+	Hf::Log.flush();
 }
 
 
 void Game::main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--stream")
+			streamWorld = true;
+		if (std::string(argv[i]) == "--watch")
+			watchAssets = true;
+		if (std::string(argv[i]) == "--texture-cache")
+			textureCachePath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "texturecache";
+		if (std::string(argv[i]) == "--texture-budget" && i + 1 < argc)
+			textureBudget = (size_t)atoi(argv[++i]) << 20;
+		if (std::string(argv[i]) == "--mixer")
+			mixerBufferSamples = 1024;
+		if (std::string(argv[i]) == "--stream-music")
+			streamMusic = true;
+		if (std::string(argv[i]) == "--profile")
+			profilePath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "profile.json";
+		if (std::string(argv[i]) == "--record")
+			recordPath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "input.rec";
+		if (std::string(argv[i]) == "--replay")
+			replayPath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "input.rec";
+	}
+	if (!replayPath.empty() && streamWorld) {
+		// streamed pages arrive in whatever order the streamer thread loads them
+		HFLOGWARN("--stream can not be replayed, the world is loaded whole");
+		streamWorld = false;
+	}
 	init();
 	loadData();
 	showIntro();
 	initLevel(1);
-	if (playGame()) {
+	if (player.isOpen()) {
+		replayGame();
+	} else if (playGame()) {
 		showWonEnding();
 	} else {
 		showLostEnding();
@@ -64,38 +120,111 @@ void Game::main(int argc, char** argv) {
 
 
 void Game::loadData() {
+	Hf::StopWatch loadTimer;
 	for (auto sp : searchPaths) {
 		context.addSearchPath(sp);
 	}
+	if (!textureCachePath.empty())
+		context.enableTextureCache(textureCachePath);
+	context.setTextureBudget(textureBudget);
+
+	// assets.pak is built from the assets folder by the assetpack tool, loose files are used
+	// when watching so edits are picked up
+	std::string archivePath = context.findSearchPath("assets.pak");
+	if (!archivePath.empty() && !watchAssets)
+		context.mountArchive(archivePath);
 	graphics.setTileSize({ 32, 32 });
-	int spriteCount = context.loadTileset(0, 32, 32, "Pilot.png");
-	if (!spriteCount) {
-		HFLOGWARN("Tileset not found");
-	}
-	context.loadTileset(GameLib::LIBXOR_TILESET32, 32, 32, "LibXORColors32x32.png");
-
-	context.loadAudioClip(0, "starbattle-bad.wav");
-	context.loadAudioClip(1, "starbattle-dead.wav");
-	context.loadAudioClip(2, "starbattle-endo.wav");
-	context.loadAudioClip(3, "starbattle-exo.wav");
-	context.loadAudioClip(4, "starbattle-ok.wav");
-	context.loadAudioClip(5, "starbattle-pdead.wav");
-	context.loadAudioClip(SOUND_BLIP, "blip.wav");
-	context.loadMusicClip(0, "starbattlemusic1.mp3");
-	context.loadMusicClip(1, "starbattlemusic2.mp3");
-	context.loadMusicClip(2, "distoro2.mid");
+
+	// images and sounds decode on the loader threads while the fonts and world load here
+	auto tileset = context.loadTilesetAsync(0, 32, 32, "Pilot.png");
+	context.loadTilesetAsync(GameLib::LIBXOR_TILESET32, 32, 32, "LibXORColors32x32.png");
+
+	context.loadAudioClipAsync(0, "starbattle-bad.wav");
+	context.loadAudioClipAsync(1, "starbattle-dead.wav");
+	context.loadAudioClipAsync(2, "starbattle-endo.wav");
+	context.loadAudioClipAsync(3, "starbattle-exo.wav");
+	context.loadAudioClipAsync(4, "starbattle-ok.wav");
+	context.loadAudioClipAsync(5, "starbattle-pdead.wav");
+	context.loadAudioClipAsync(SOUND_BLIP, "blip.wav");
+	context.loadMusicClipAsync(0, "starbattlemusic1.mp3");
+	context.loadMusicClipAsync(1, "starbattlemusic2.mp3");
+	context.loadMusicClipAsync(2, "distoro2.mid");
 
 	gothicfont.load("fonts-japanese-gothic.ttf", 36);
 	minchofont.load("fonts-japanese-mincho.ttf", 36);
+	overlayfont.load("fonts-japanese-gothic.ttf", 14);
 
-	worldPath = context.findSearchPath(worldPath);
-	if (!world.load(worldPath)) {
+	// packed worlds are read from the archive by name, loose worlds by the path they were found at
+	// worldPath keeps the name or path that was loaded, so reloads read the same file
+	if (!context.findArchived(worldPath).data())
+		worldPath = context.findSearchPath(worldPath);
+	if (!_loadWorld()) {
 		HFLOGWARN("world.txt not found");
 	}
+
+	context.waitForLoads();
+	if (!tileset.get()) {
+		HFLOGWARN("Tileset not found");
+	}
+	HFLOGINFO("loaded data in %.1f ms", loadTimer.stop_ms());
+
+	if (mixerBufferSamples && mixer.start(&context, mixerBufferSamples)) {
+		for (int clipId : { 0, 1, 2, 3, 4, 5, SOUND_BLIP })
+			mixer.addClip(clipId);
+		audio.setMixer(&mixer);
+	}
+	if (streamMusic && musicStreamer.start(&context)) {
+		musicStreamer.addTrack(0, "starbattlemusic1.mp3");
+		musicStreamer.addTrack(1, "starbattlemusic2.mp3");
+		audio.setMusicStreamer(&musicStreamer);
+	}
+
+	if (watchAssets && context.enableHotReload()) {
+		context.watchFile(worldPath, [this](const std::string&) { _reloadWorld(); });
+	}
+}
+
+
+bool Game::_loadWorld() {
+	bool binary = worldPath.size() > 4 && worldPath.compare(worldPath.size() - 4, 4, ".gwb") == 0;
+	// the streamer maps the file itself, so packed worlds are loaded whole
+	bool packed = context.findArchived(worldPath).data() != nullptr;
+	if (streamWorld && !binary && !packed)
+		return world.stream(worldPath);
+	// the world is parsed on a background thread while the intro plays, initLevel() swaps it in
+	if (worldPath.empty())
+		return false;
+	levelLoader.start(worldPath);
+	return true;
+}
+
+
+void Game::_reloadWorld() {
+	// a streamed world only reads its header here, the pages come from the streamer thread
+	if (world.streaming()) {
+		if (world.reload(worldPath) < 0)
+			HFLOGWARN("world.txt not found");
+		return;
+	}
+	levelLoader.start(worldPath);
+}
+
+
+bool Game::_swapReloadedWorld() {
+	if (!levelLoader.pending() || !levelLoader.ready())
+		return false;
+	if (!levelLoader.swap(world)) {
+		HFLOGWARN("world.txt not found");
+	}
+	return true;
 }
 
 
 void Game::initLevel(int levelNum) {
+	if (levelLoader.pending() && !levelLoader.swap(world)) {
+		HFLOGWARN("world.txt not found");
+	}
+
 	auto NewDungeonActor = []() { return std::make_shared<GameLib::DungeonActorComponent>(); };
 	auto NewInput = []() { return std::make_shared<GameLib::SimpleInputComponent>(); };
 	auto NewRandomInput = []() { return std::make_shared<GameLib::RandomInputComponent>(); };
@@ -151,6 +280,7 @@ void Game::updateTiming() {
 	t1 = stopwatch.stop_sf();
 	dt = t1 - t0;
 	t0 = t1;
+	frameStat.record(dt * 1000.0);
 	GameLib::Context::deltaTime = dt;
 	GameLib::Context::currentTime_s = t1;
 	GameLib::Context::currentTime_ms = t1 * 1000;
@@ -192,15 +322,25 @@ bool Game::playGame() {
 		updateTiming();
 
 		context.getEvents();
+		uint32_t events = _swapReloadedWorld() ? RECORD_WORLDSWAP : 0;
 		input.handle();
-		_debugKeys();
+		events |= _readDebugKeys();
+		_debugKeys(events);
+
+		if (world.streaming())
+			world.updateStreaming(graphics.centerf() / graphics.tileSizef());
 
 		context.clearScreen(backColor);
 		world.drawTiles(graphics);
+		uint32_t ticks = 0;
 		while (lag >= Game::MS_PER_UPDATE) {
 			updateWorld();
 			lag -= Game::MS_PER_UPDATE;
+			ticks++;
 		}
+		GameLib::InputHandler::INPUTSTATE state = input.state();
+		state.buttons |= events;
+		recorder.write({ state, ticks, t1, dt });
 
 		shake();
 		updateCamera();
@@ -209,6 +349,9 @@ bool Game::playGame() {
 
 		context.swapBuffers();
 		frames++;
+		Hf::AllocTracker::frame();
+		GameLib::ComponentProfiler::frame();
+		perfOverlay.update(dt * 1000.0f, &world);
 		std::this_thread::yield();
 	}
 
@@ -216,6 +359,56 @@ bool Game::playGame() {
 }
 
 
+void Game::replayGame() {
+	world.start(0.0f);
+	graphics.setCenter(graphics.origin());
+	Hf::StopWatch replayTimer;
+	uint64_t ticks = 0;
+	GameLib::INPUTFRAME frame;
+	while (!context.quitRequested && player.next(frame)) {
+		// the recorded times stand in for updateTiming() so timed effects repeat
+		t0 = t1;
+		t1 = frame.time;
+		dt = frame.dt;
+		GameLib::Context::deltaTime = dt;
+		GameLib::Context::currentTime_s = t1;
+		GameLib::Context::currentTime_ms = t1 * 1000;
+
+		// loaded and reloaded assets are still installed, but the world is only swapped in on the
+		// frame it was swapped in when recording, waiting for the loader if needed
+		context.getEvents();
+		if (frame.state.buttons & RECORD_WORLDSWAP) {
+			if (!levelLoader.pending())
+				_reloadWorld();
+			if (!levelLoader.swap(world))
+				HFLOGWARN("world.txt not found");
+		}
+		input.handle(frame.state);
+		_debugKeys(frame.state.buttons);
+		if (world.streaming())
+			world.updateStreaming(graphics.centerf() / graphics.tileSizef());
+		for (uint32_t i = 0; i < frame.ticks; i++)
+			updateWorld();
+		ticks += frame.ticks;
+
+		shake();
+		updateCamera();
+		frames++;
+		Hf::AllocTracker::frame();
+		GameLib::ComponentProfiler::frame();
+	}
+
+	[[maybe_unused]] Hf::Histogram::SUMMARY s = tickStat.summary();
+	HFLOGINFO("replayed %.0f frames and %llu ticks in %.1f ms, tick p50 %.3f p95 %.3f p99 %.3f ms",
+		frames,
+		(unsigned long long)ticks,
+		replayTimer.stop_ms(),
+		s.p50,
+		s.p95,
+		s.p99);
+}
+
+
 void Game::updateCamera() {
 	glm::ivec2 xy = world.dynamicActors[0]->pixelCenter(graphics);
 	glm::ivec2 center = graphics.center();
@@ -223,12 +416,15 @@ void Game::updateCamera() {
 	center.y = GameLib::clamp(center.y, xy.y - 100, xy.y + 100);
 	//center.y = std::min(graphics.getCenterY(), center.y);
 	graphics.setCenter(center);
+	audio.setListener(glm::vec2(world.dynamicActors[0]->position));
 }
 
 
 void Game::updateWorld() {
+	Hf::StopWatch tick;
 	world.update(Game::MS_PER_UPDATE);
 	world.physics(Game::MS_PER_UPDATE);
+	tickStat.record(tick.stop_ms());
 }
 
 
@@ -267,22 +463,47 @@ void Game::drawHUD() {
 
 	char fpsstr[64] = { 0 };
 	snprintf(fpsstr, 64, "%3.2f", 1.0f / dt);
-	minchofont.draw(
+	minchofont.drawCached(
 		(int)graphics.getWidth(),
 		(int)graphics.getHeight() - 2,
 		fpsstr,
 		GameLib::Gold,
 		GameLib::Font::HALIGN_RIGHT | GameLib::Font::VALIGN_BOTTOM | GameLib::Font::SHADOWED);
+
+	perfOverlay.draw(0, 48);
 }
 
 
-void Game::_debugKeys() {
-	if (context.keyboard.checkClear(SDL_SCANCODE_F5)) {
-		if (!world.load(worldPath)) {
-			HFLOGWARN("world.txt not found");
+uint32_t Game::_readDebugKeys() {
+	uint32_t keys = 0;
+	if (context.keyboard.checkClear(SDL_SCANCODE_F3))
+		keys |= RECORD_F3;
+	if (context.keyboard.checkClear(SDL_SCANCODE_F5))
+		keys |= RECORD_F5;
+	return keys;
+}
+
+
+void Game::_debugKeys(uint32_t keys) {
+	if (keys & RECORD_F3) {
+		perfOverlay.toggle();
+		if (perfOverlay.visible) {
+			Hf::Profiler.enable();
+			Hf::AllocTracker::enable();
+			GameLib::ComponentProfiler::enable();
+		} else {
+			// a --profile capture keeps the profiler running until exit
+			if (!Hf::Profiler.capturing())
+				Hf::Profiler.disable();
+			Hf::AllocTracker::disable();
+			GameLib::ComponentProfiler::disable();
 		}
 	}
 
+	if (keys & RECORD_F5) {
+		_reloadWorld();
+	}
+
 	if (shakeCommand.checkClear()) {
 		shake(4, 5, 50 * MS_PER_UPDATE);
 	}
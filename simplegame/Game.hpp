@@ -3,11 +3,15 @@
 
 #include "Commands.hpp"
 #include <gamelib.hpp>
+#include <gamelib_component_profiler.hpp>
+#include <gamelib_input_recorder.hpp>
+#include <gamelib_level_loader.hpp>
+#include <gamelib_perf_overlay.hpp>
 #include "Commands.hpp"
 
 class Game {
 public:
-	Game() {}
+	Game(int windowFlags = GameLib::WindowDefault) : context{ 1280, 720, windowFlags } {}
 	~Game() {}
 
 	void init();
@@ -18,6 +22,8 @@ public:
 
 	// return true if game won, false if game lost
 	virtual bool playGame();
+	// plays back a recorded session as fast as possible and logs the tick times
+	virtual void replayGame();
 	virtual void updateCamera();
 	virtual void updateWorld();
 	virtual void drawWorld();
@@ -44,17 +50,48 @@ protected:
 
 	GameLib::Context context{ 1280, 720, GameLib::WindowDefault };
 	GameLib::Audio audio;
+	GameLib::Mixer mixer;
+	GameLib::MusicStreamer musicStreamer;
 	GameLib::InputHandler input;
 	GameLib::Graphics graphics{ &context };
 	GameLib::World world;
+	// loads the next level while a story screen plays, initLevel() swaps it in
+	// reloaded worlds are also parsed here and swapped in by the frame loop
+	GameLib::LevelLoader levelLoader{ &context };
 	GameLib::Box2D box2d;
 	GameLib::Font gothicfont{ &context };
 	GameLib::Font minchofont{ &context };
+	GameLib::Font overlayfont{ &context };
+	// F3 shows frame times, profiler zones and draw counts
+	GameLib::PerfOverlay perfOverlay{ &context, &overlayfont };
 	SDL_Color backColor{ GameLib::Azure };
 
 	std::vector<std::string> searchPaths{ "./assets", "../assets" };
 	std::string worldPath{ "world.txt" };
+	// stream world pages around the camera instead of loading the whole world
+	bool streamWorld{ false };
+	// reload assets and the world when their files change
+	bool watchAssets{ false };
+	// decoded images are cached here so later runs skip decoding them, empty disables the cache
+	// --texture-cache enables it, a cold cache is slower than decoding so it is off by default
+	std::string textureCachePath;
+	// texture memory limit in bytes, 0 for no limit
+	size_t textureBudget{ 0 };
+	// mix positional sound effects with the gamelib mixer using this buffer size, 0 uses SDL_mixer
+	int mixerBufferSamples{ 0 };
+	// decode music ahead on a worker thread instead of in the SDL_mixer callback
+	bool streamMusic{ false };
+	// zones are captured to this Chrome trace file, empty disables the profiler
+	std::string profilePath;
+	// input and the random seed are recorded to this file
+	std::string recordPath;
+	// a recording to play back instead of reading the keyboard, main() makes the context headless for it
+	std::string replayPath;
+	GameLib::InputRecorder recorder;
+	GameLib::InputPlayer player;
 	Hf::StopWatch stopwatch;
+	Hf::Histogram& frameStat{ Hf::Log.getHistogram("frame ms") };
+	Hf::Histogram& tickStat{ Hf::Log.getHistogram("tick ms") };
 	double spritesDrawn{ 0 };
 	double frames{ 0 };
 	float t0{ 0 };
@@ -68,7 +105,20 @@ protected:
 	MovementCommand xaxisCommand;
 	MovementCommand yaxisCommand;
 
-	virtual void _debugKeys();
+	// debug keys and world swaps are recorded with the input so replays repeat them
+	static constexpr uint32_t RECORD_F3 = GameLib::InputHandler::BUTTON_USER << 0;
+	static constexpr uint32_t RECORD_F5 = GameLib::InputHandler::BUTTON_USER << 1;
+	static constexpr uint32_t RECORD_WORLDSWAP = GameLib::InputHandler::BUTTON_USER << 2;
+
+	// returns the RECORD_F3 and RECORD_F5 bits for the debug keys pressed this frame
+	uint32_t _readDebugKeys();
+	virtual void _debugKeys(uint32_t keys);
+	bool _loadWorld();
+	// parses worldPath again on the level loader thread
+	void _reloadWorld();
+	// swaps in a reloaded world once it has been parsed, called at the start of each frame
+	// returns true if a world was swapped in
+	bool _swapReloadedWorld();
 
 	GameLib::ActorPtr _makeActor(float x,
 		float y,
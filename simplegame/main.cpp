@@ -8,6 +8,10 @@
 #pragma comment(lib, "gamelib.lib")
 #endif
 
+#ifdef HFALLOC_TRACKER
+HFALLOC_TRACKER_HOOKS()
+#endif
+
 //////////////////////////////////////////////////////////////////////
 // PROTOTYPES ////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////
@@ -21,7 +25,13 @@ void testSprites(GameLib::Context& context,
 
 
 int main(int argc, char** argv) {
-	Game game;
+	// replays need no window or sound, and the context is made before Game::main() reads the arguments
+	int windowFlags = GameLib::WindowDefault;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--replay")
+			windowFlags = GameLib::WindowHeadless;
+	}
+	Game game(windowFlags);
 	game.main(argc, argv);
 	return 0;
 }
@@ -0,0 +1,87 @@
+// Allocation Benchmark
+// Runs a world of actors and fails if its steady state frames allocate from the heap
+// UAF CS Game Design and Architecture Course
+#include <gamelib.hpp>
+#include <gamelib_actor_component.hpp>
+#include <gamelib_input_component.hpp>
+#include <gamelib_physics_component.hpp>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "gamelib.lib")
+#endif
+
+HFALLOC_TRACKER_HOOKS()
+
+int main(int argc, char** argv) {
+	constexpr float DeltaTime = 1.0f / 60.0f;
+	constexpr int WarmupFrames = 60;
+	int frames = argc > 1 ? std::max(1, atoi(argv[1])) : 600;
+	int actors = argc > 2 ? std::max(1, atoi(argv[2])) : 200;
+
+	GameLib::Box2D box2d;
+	GameLib::World world;
+	GameLib::Locator::provide(&box2d);
+	GameLib::Locator::provide(&world);
+	box2d.init();
+	world.resize(64, 64);
+
+	GameLib::Random random;
+	for (int i = 0; i < actors; i++) {
+		auto actor = GameLib::makeActor("actor",
+			std::make_shared<GameLib::RandomInputComponent>(),
+			std::make_shared<GameLib::RandomActorComponent>(),
+			std::make_shared<GameLib::SimplePhysicsComponent>(),
+			nullptr);
+		actor->position = { 1.0f + random.positive() * 62.0f, 1.0f + random.positive() * 62.0f, 0.0f };
+		actor->speed = 4.0f;
+		world.addDynamicActor(actor);
+	}
+	world.start(0.0f);
+
+	Hf::Histogram& frameStat{ Hf::Log.getHistogram("allocbench frame ms") };
+	Hf::Log.setLevel(HFLOG_LEVEL_INFO);
+	Hf::Profiler.enable();
+	Hf::AllocTracker::enable();
+	if (!Hf::AllocTracker::hooksInstalled()) {
+		HFLOGERROR("allocation hooks are not installed");
+		return 1;
+	}
+
+	// one frame of the work a game does every frame, the debug message is filtered out by level
+	auto runFrame = [&](int frame) {
+		Hf::StopWatch stopwatch;
+		world.update(DeltaTime);
+		world.physics(DeltaTime);
+		HFLOGDEBUG("frame %d", frame);
+		frameStat.record(stopwatch.stop_msf());
+		Hf::Profiler.frame();
+		Hf::AllocTracker::frame();
+	};
+
+	for (int i = 0; i < WarmupFrames; i++)
+		runFrame(i);
+
+	uint64_t allocations{ 0 };
+	uint64_t bytes{ 0 };
+	int allocatingFrames{ 0 };
+	for (int i = 0; i < frames; i++) {
+		runFrame(WarmupFrames + i);
+		const Hf::AllocTracker::FRAMESTATS& stats = Hf::AllocTracker::lastFrame();
+		allocations += stats.allocations;
+		bytes += stats.bytes;
+		if (stats.allocations)
+			allocatingFrames++;
+	}
+
+	Hf::Histogram::SUMMARY summary = frameStat.summary();
+	printf("%d actors, %d frames, p50 %.3f ms, p99 %.3f ms\n", actors, frames, summary.p50, summary.p99);
+	printf("%llu allocations (%llu bytes) in %d frames\n", (unsigned long long)allocations, (unsigned long long)bytes, allocatingFrames);
+	if (!allocations)
+		return 0;
+
+	// run one more frame recording every allocation to show where they come from
+	Hf::AllocTracker::setSampleInterval(1);
+	runFrame(WarmupFrames + frames);
+	Hf::AllocTracker::report(stdout);
+	return 1;
+}
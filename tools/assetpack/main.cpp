@@ -0,0 +1,32 @@
+// Asset Packer
+// Packs a folder of assets into an archive that Context::mountArchive() can mount
+// UAF CS Game Design and Architecture Course
+#include <gamelib.hpp>
+#include <gamelib_asset_archive.hpp>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "gamelib.lib")
+#endif
+
+int main(int argc, char** argv) {
+	if (argc == 3 && std::string(argv[1]) == "--list") {
+		GameLib::AssetArchive archive;
+		if (!archive.open(argv[2]))
+			return 1;
+		for (int i = 0; i < archive.count(); i++) {
+			std::string_view name = archive.name(i);
+			printf("%10zu %.*s\n", archive.find(name).size(), (int)name.size(), name.data());
+		}
+		return 0;
+	}
+	if (argc == 3) {
+		int count = GameLib::AssetArchive::pack(argv[1], argv[2]);
+		if (count < 0)
+			return 1;
+		HFLOGINFO("packed %d files from '%s' into '%s'", count, argv[1], argv[2]);
+		return 0;
+	}
+	printf("usage: assetpack assets/ assets.pak\n");
+	printf("       assetpack --list assets.pak\n");
+	return 1;
+}
@@ -0,0 +1,273 @@
+// GameLib Benchmarks
+// Times gamelib subsystems without a display and writes the results as JSON
+// UAF CS Game Design and Architecture Course
+#include <gamelib.hpp>
+#include <gamelib_actor_component.hpp>
+#include <gamelib_input_component.hpp>
+#include <gamelib_physics_component.hpp>
+#include <filesystem>
+#include <functional>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "gamelib.lib")
+#endif
+
+// keeps results alive so the optimizer cannot remove the work that made them
+volatile int sink{ 0 };
+
+struct SCENARIO {
+	std::string name;
+	// operations timed per repetition, results are reported per operation
+	int ops{ 1 };
+	// runs before each repetition and is not timed
+	std::function<void()> setup;
+	std::function<void()> run;
+};
+
+struct RESULT {
+	std::string name;
+	int ops{ 0 };
+	double medianNs{ 0.0 };
+	double p95Ns{ 0.0 };
+	double minNs{ 0.0 };
+	double meanNs{ 0.0 };
+};
+
+RESULT runScenario(const SCENARIO& scenario, int warmup, int repetitions) {
+	for (int i = 0; i < warmup; i++) {
+		if (scenario.setup)
+			scenario.setup();
+		scenario.run();
+	}
+
+	std::vector<double> samples;
+	for (int i = 0; i < repetitions; i++) {
+		if (scenario.setup)
+			scenario.setup();
+		int64_t t0 = Hf::FrameProfiler::now();
+		scenario.run();
+		samples.push_back((double)(Hf::FrameProfiler::now() - t0) / scenario.ops);
+	}
+	std::sort(samples.begin(), samples.end());
+
+	RESULT result;
+	result.name = scenario.name;
+	result.ops = scenario.ops;
+	result.medianNs = samples[samples.size() / 2];
+	result.p95Ns = samples[std::min(samples.size() - 1, (size_t)std::ceil(samples.size() * 0.95) - 1)];
+	result.minNs = samples.front();
+	for (double sample : samples)
+		result.meanNs += sample / samples.size();
+	return result;
+}
+
+void writeJson(FILE* fout, int warmup, int repetitions, const std::vector<RESULT>& results) {
+	fprintf(fout, "{\n  \"benchmark\": \"gamelib_bench\",\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"unit\": \"ns/op\",\n", warmup, repetitions);
+	fprintf(fout, "  \"results\": [");
+	for (size_t i = 0; i < results.size(); i++) {
+		const RESULT& r = results[i];
+		fprintf(fout,
+			"%s\n    { \"name\": \"%s\", \"ops\": %d, \"median\": %.2f, \"p95\": %.2f, \"min\": %.2f, \"mean\": %.2f }",
+			i ? "," : "",
+			r.name.c_str(),
+			r.ops,
+			r.medianNs,
+			r.p95Ns,
+			r.minNs,
+			r.meanNs);
+	}
+	fprintf(fout, "\n  ]\n}\n");
+}
+
+// a bordered world with scattered blocks, in the text format World::load() reads
+std::string makeWorldText(int sizeX, int sizeY) {
+	std::string text = "define . 2\ndefine # 3\nflags . 0\nworldsize " + std::to_string(sizeX) + " " + std::to_string(sizeY) + "\n";
+	GameLib::Random random;
+	for (int y = 0; y < sizeY; y++) {
+		text += "world " + std::to_string(y) + " ";
+		for (int x = 0; x < sizeX; x++) {
+			bool edge = x == 0 || y == 0 || x == sizeX - 1 || y == sizeY - 1;
+			text += edge || random.positive() < 0.05f ? '#' : '.';
+		}
+		text += "\n";
+	}
+	return text;
+}
+
+void addActors(GameLib::World& world, int count) {
+	GameLib::Random random;
+	for (int i = 0; i < count; i++) {
+		auto actor = GameLib::makeActor("actor",
+			std::make_shared<GameLib::RandomInputComponent>(),
+			std::make_shared<GameLib::RandomActorComponent>(),
+			std::make_shared<GameLib::SimplePhysicsComponent>(),
+			nullptr);
+		actor->position = { 1.0f + random.positive() * (world.worldSizeX - 2), 1.0f + random.positive() * (world.worldSizeY - 2), 0.0f };
+		actor->speed = 4.0f;
+		world.addDynamicActor(actor);
+	}
+	world.start(0.0f);
+}
+
+int main(int argc, char** argv) {
+	int warmup = 3;
+	int repetitions = 30;
+	int actors = 200;
+	std::string filter;
+	std::string outPath;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--warmup" && i + 1 < argc)
+			warmup = std::max(0, atoi(argv[++i]));
+		else if (arg == "--reps" && i + 1 < argc)
+			repetitions = std::max(1, atoi(argv[++i]));
+		else if (arg == "--actors" && i + 1 < argc)
+			actors = std::max(1, atoi(argv[++i]));
+		else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "--out" && i + 1 < argc)
+			outPath = argv[++i];
+		else {
+			fprintf(stderr, "usage: gamelib_bench [--warmup n] [--reps n] [--actors n] [--filter text] [--out file.json]\n");
+			return 1;
+		}
+	}
+
+	// the JSON goes to stdout, so the log goes to stderr
+	Hf::Log.setOutputFile(stderr);
+	Hf::Log.setLevel(HFLOG_LEVEL_WARN);
+
+	// draws go to an offscreen software renderer, so no display or audio device is needed
+	GameLib::Context context(640, 480, GameLib::WindowHeadless);
+	for (const char* path : { "./assets", "../assets", "../../assets", "../../../assets" }) {
+		if (std::filesystem::is_directory(path))
+			context.addSearchPath(path);
+	}
+
+	std::vector<SCENARIO> scenarios;
+	const std::string worldText = makeWorldText(128, 128);
+
+	// each world gets its own Box2D, because loading tiles adds their bodies
+	std::unique_ptr<GameLib::Box2D> loadBox2d;
+	std::unique_ptr<GameLib::World> loadWorld;
+	std::istringstream worldStream;
+	scenarios.push_back({ "world.readCharStream 128x128",
+		1,
+		[&]() {
+			loadWorld.reset();
+			loadBox2d = std::make_unique<GameLib::Box2D>();
+			loadBox2d->init();
+			GameLib::Locator::provide(loadBox2d.get());
+			loadWorld = std::make_unique<GameLib::World>();
+			worldStream.clear();
+			worldStream.str(worldText);
+		},
+		[&]() {
+			while (worldStream.peek() != EOF)
+				loadWorld->readCharStream(worldStream);
+		} });
+
+	GameLib::Box2D box2d;
+	box2d.init();
+	GameLib::World world;
+	GameLib::Locator::provide(&box2d);
+	world.readText(worldText);
+
+	scenarios.push_back({ "world.getTile", 128 * 128, nullptr, [&]() {
+							 int sum = 0;
+							 for (int y = 0; y < 128; y++) {
+								 for (int x = 0; x < 128; x++)
+									 sum += world.getTile(x, y).charDesc;
+							 }
+							 sink = sum;
+						 } });
+	scenarios.push_back({ "world.getCollisionTile", 128 * 128, nullptr, [&]() {
+							 int sum = 0;
+							 for (int y = 0; y < 128; y++) {
+								 for (int x = 0; x < 128; x++)
+									 sum += world.getCollisionTile(x + 0.5f, y + 0.5f);
+							 }
+							 sink = sum;
+						 } });
+
+	// the actor scenarios run in a world of their own so their bodies do not mix with the tiles
+	GameLib::Box2D actorBox2d;
+	actorBox2d.init();
+	GameLib::World actorWorld;
+	GameLib::Locator::provide(&actorBox2d);
+	GameLib::Locator::provide(&actorWorld);
+	actorWorld.resize(64, 64);
+	addActors(actorWorld, actors);
+	std::string n = std::to_string(actors);
+	auto provideActorWorld = [&]() {
+		GameLib::Locator::provide(&actorBox2d);
+		GameLib::Locator::provide(&actorWorld);
+	};
+	scenarios.push_back({ "world.update " + n + " actors", 1, provideActorWorld, [&]() { actorWorld.update(1.0f / 60.0f); } });
+	scenarios.push_back({ "world.physics " + n + " actors", 1, provideActorWorld, [&]() { actorWorld.physics(1.0f / 60.0f); } });
+
+	GameLib::Box2D bodies;
+	bodies.init();
+	bodies.setGravity({ 0.0f, 9.8f });
+	bodies.initBody(b2_staticBody, { 0.0f, 40.0f }, { 100.0f, 1.0f }, 0.0f, 0.3f);
+	for (int i = 0; i < actors; i++)
+		bodies.initBody(b2_dynamicBody, { (float)(i % 40) * 2.0f - 40.0f, (float)(i / 40) * 2.0f }, { 0.5f, 0.5f }, 1.0f, 0.3f);
+	scenarios.push_back({ "box2d.update " + n + " bodies", 1, nullptr, [&]() { bodies.update(1.0f / 60.0f); } });
+
+	scenarios.push_back({ "MakeColor", 100000, nullptr, [&]() {
+							 int sum = 0;
+							 for (int i = 0; i < 100000; i++) {
+								 SDL_Color c = GameLib::MakeColor(i & 15, (i >> 4) & 15, i & 3, (i & 64) != 0);
+								 sum += c.r + c.g + c.b;
+							 }
+							 sink = sum;
+						 } });
+
+	GameLib::Graphics graphics(&context);
+	GameLib::Font font(&context);
+	const char* text = "The quick brown fox jumps over the lazy dog 0123456789";
+	if (!context) {
+		HFLOGWARN("no renderer, skipping the graphics and font scenarios");
+	} else {
+		if (context.loadTileset(0, 32, 32, "LibXORColors32x32.png")) {
+			scenarios.push_back({ "graphics.draw 1000 tiles", 1000, nullptr, [&]() {
+									 for (int i = 0; i < 1000; i++)
+										 graphics.draw(0, i & 31, (i * 37) % 608 - 320, (i * 53) % 448 - 240);
+								 } });
+		}
+		if (font.load("LiberationSans-Bold.ttf", 18)) {
+			scenarios.push_back({ "font.calcWidth", 100, nullptr, [&]() {
+									 int sum = 0;
+									 for (int i = 0; i < 100; i++)
+										 sum += font.calcWidth(text);
+									 sink = sum;
+								 } });
+			scenarios.push_back({ "font.draw", 100, nullptr, [&]() {
+									 for (int i = 0; i < 100; i++)
+										 font.draw(0, i * 4, text, GameLib::White, GameLib::Font::SHADOWED);
+								 } });
+			scenarios.push_back({ "font.drawCached", 100, nullptr, [&]() {
+									 for (int i = 0; i < 100; i++)
+										 font.drawCached(0, i * 4, text, GameLib::White, GameLib::Font::SHADOWED);
+								 } });
+		}
+	}
+
+	std::vector<RESULT> results;
+	for (auto& scenario : scenarios) {
+		if (!filter.empty() && scenario.name.find(filter) == std::string::npos)
+			continue;
+		results.push_back(runScenario(scenario, warmup, repetitions));
+		fprintf(stderr, "%-32s median %12.1f ns/op  p95 %12.1f ns/op\n", results.back().name.c_str(), results.back().medianNs, results.back().p95Ns);
+	}
+
+	FILE* fout = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+	if (!fout) {
+		fprintf(stderr, "could not write '%s'\n", outPath.c_str());
+		return 1;
+	}
+	writeJson(fout, warmup, repetitions, results);
+	if (fout != stdout)
+		fclose(fout);
+	return 0;
+}
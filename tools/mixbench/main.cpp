@@ -0,0 +1,52 @@
+// Mixer Benchmark
+// Measures how many voices the gamelib Mixer mixes per millisecond
+// UAF CS Game Design and Architecture Course
+#include <gamelib.hpp>
+#include <gamelib_mixer.hpp>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "gamelib.lib")
+#endif
+
+int main(int argc, char** argv) {
+	constexpr int Frequency = 48000;
+	int blocks = argc > 1 ? std::max(1, atoi(argv[1])) : 2000;
+
+	// a two second tone stands in for a sound effect
+	std::vector<float> samples(Frequency * 2);
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = 0.25f * std::sin(i * 440.0f * 2.0f * 3.14159265f / Frequency);
+	}
+
+	GameLib::Mixer mixer;
+	mixer.addClip(0, samples);
+	std::vector<float> out(GameLib::Mixer::BlockFrames * 2);
+	GameLib::Random random;
+	std::vector<int> handles;
+
+	printf("%8s %14s %16s %18s\n", "voices", "ms per block", "voices per ms", "realtime voices");
+	for (int voices : { 1, 8, 32, GameLib::Mixer::MaxVoices }) {
+		GameLib::Mixer::MIXSTATS before = mixer.stats();
+		Hf::StopWatch stopwatch;
+		for (int b = 0; b < blocks; b++) {
+			// keep the pool at the requested size as voices finish
+			for (int v = mixer.stats().playing; v < voices; v++) {
+				glm::vec2 position{ random.normal() * 10.0f, random.normal() * 10.0f };
+				handles.push_back(mixer.play(0, position));
+			}
+			mixer.mix(out.data(), GameLib::Mixer::BlockFrames);
+		}
+		double ms = stopwatch.stop_ms();
+		GameLib::Mixer::MIXSTATS after = mixer.stats();
+
+		// one voice mixed is one voice for one block of BlockFrames frames
+		double voiceBlocks = (double)(after.voiceFrames - before.voiceFrames) / GameLib::Mixer::BlockFrames;
+		double blockSeconds = (double)GameLib::Mixer::BlockFrames / Frequency;
+		printf("%8d %14.4f %16.1f %18.0f\n", voices, ms / blocks, voiceBlocks / ms, voiceBlocks * blockSeconds / (ms * 0.001));
+		for (int handle : handles)
+			mixer.stopVoice(handle);
+		handles.clear();
+		mixer.mix(out.data(), GameLib::Mixer::BlockFrames);
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+// World Converter
+// Converts world.txt style worlds to the binary world format
+// UAF CS Game Design and Architecture Course
+#include <gamelib.hpp>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "gamelib.lib")
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// PROTOTYPES ////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+int convert(const std::string& input, const std::string& output);
+int bench(const std::string& input);
+void makeScaledWorld(GameLib::World& src, GameLib::World& dst, int scale);
+
+int main(int argc, char** argv) {
+	if (argc == 3 && std::string(argv[1]) == "--bench") {
+		return bench(argv[2]);
+	}
+	if (argc == 3) {
+		return convert(argv[1], argv[2]);
+	}
+	printf("usage: worldconv input.txt output.gwb\n");
+	printf("       worldconv --bench input.txt\n");
+	return 1;
+}
+
+int convert(const std::string& input, const std::string& output) {
+	GameLib::World world;
+	if (!world.load(input)) {
+		HFLOGERROR("'%s' not found", input.c_str());
+		return 1;
+	}
+	if (!world.writeBinary(output)) {
+		HFLOGERROR("'%s' could not be written", output.c_str());
+		return 1;
+	}
+	HFLOGINFO("wrote '%s' (%dx%d)", output.c_str(), world.worldSizeX, world.worldSizeY);
+	return 0;
+}
+
+// repeats src horizontally scale times
+void makeScaledWorld(GameLib::World& src, GameLib::World& dst, int scale) {
+	dst.resize(src.worldSizeX * scale, src.worldSizeY);
+	dst.copyDefines(src);
+	for (int y = 0; y < src.worldSizeY; y++) {
+		for (int x = 0; x < dst.worldSizeX; x++) {
+			dst.setTile(x, y, src.getTile(x % src.worldSizeX, y));
+			dst.getTile(x, y).box2dId = -1;
+		}
+	}
+}
+
+int bench(const std::string& input) {
+	constexpr int Repetitions = 5;
+	GameLib::World world;
+	if (!world.load(input)) {
+		HFLOGERROR("'%s' not found", input.c_str());
+		return 1;
+	}
+
+	for (int scale : { 1, 10, 100 }) {
+		GameLib::World scaled;
+		makeScaledWorld(world, scaled, scale);
+		std::string textPath = "worldconv_bench_" + std::to_string(scale) + "x.txt";
+		std::string binPath = "worldconv_bench_" + std::to_string(scale) + "x.gwb";
+		scaled.write(textPath);
+		scaled.writeBinary(binPath);
+
+		double textMs = 0.0;
+		double binMs = 0.0;
+		for (int i = 0; i < Repetitions; i++) {
+			GameLib::World w;
+			GameLib::Box2D box2d;
+			GameLib::Locator::provide(&box2d);
+			Hf::StopWatch sw;
+			w.load(textPath);
+			textMs += sw.stop_ms();
+		}
+		for (int i = 0; i < Repetitions; i++) {
+			GameLib::World w;
+			GameLib::Box2D box2d;
+			GameLib::Locator::provide(&box2d);
+			Hf::StopWatch sw;
+			w.loadBinary(binPath);
+			binMs += sw.stop_ms();
+		}
+		GameLib::Locator::provide((GameLib::Box2D*)nullptr);
+
+		HFLOGINFO("%3dx (%dx%d): text %8.3f ms, binary %8.3f ms, %5.1fx faster",
+			scale,
+			scaled.worldSizeX,
+			scaled.worldSizeY,
+			textMs / Repetitions,
+			binMs / Repetitions,
+			textMs / std::max(binMs, 0.001));
+		std::remove(textPath.c_str());
+		std::remove(binPath.c_str());
+	}
+	return 0;
+}